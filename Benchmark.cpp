@@ -0,0 +1,1449 @@
+#include "Benchmark.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "CornerBitsets.h"
+#include "CpuFeatures.h"
+#include "MappedFile.h"
+#include "ScrambleSearcher.h"
+#include "SearchCriteria.h"
+#include "SolutionDedupe.h"
+#include "SolutionSink.h"
+#include "SolutionStream.h"
+#include "Symmetry.h"
+
+// Probes are recorded from the edge search below random prefixes this many edges deep.
+const int PROBE_PREFIX_EDGES = 8;
+// Stop recording once there are at least this many probes.
+const size_t PROBE_TARGET = 200000;
+
+const int CACHE_LINE_SIZE = 64;
+
+// The bitset benchmark searches below this many random prefixes this many edges deep.
+const int BITSET_PREFIX_EDGES = 4;
+const int BITSET_PREFIXES = 40;
+
+// The connectedness benchmark scores this many random cubes, each this many times.
+const int CONNECTEDNESS_CUBES = 100000;
+const int CONNECTEDNESS_REPEATS = 20;
+// Each random cube gets up to this many steps of improvement, so there are cubes of every connectedness.
+const int CONNECTEDNESS_STEPS = 400;
+
+// Fixed edge prefixes for the subtree and record benchmarks, with what the search below each one finds. If a change to
+// the search changes these, either the change is wrong or these need updating.
+typedef struct {
+    const char* prefix;
+    unsigned long int edge_arrangements;
+    unsigned long int solutions;
+} SubtreeBenchmark;
+
+const SubtreeBenchmark subtree_benchmarks[] = {
+    { "5_3_9-4-",  7761,  3245 },
+    { "2_5-B-7-",  9697,  3532 },
+    { "2_9_6_7-", 12625,  6859 },
+    { "5-A-2-B-", 11396,  4355 },
+    { "0-A-9-1_",  7311,  2272 },
+    { "2_3_8_6_", 10620,  1290 },
+    { "0-A_6_7-", 15636, 12781 },
+};
+const int SUBTREE_BENCHMARKS = sizeof(subtree_benchmarks) / sizeof(subtree_benchmarks[0]);
+
+// None of the subtree prefixes has _Perfect solutions below it, so the criteria benchmark also searches below this one, which
+// does. These are the edge arrangements and the solutions in each _Perfect solution file the default criteria find below it.
+typedef struct {
+    const char* prefix;
+    unsigned long int edge_arrangements;
+    unsigned long long perfect_solutions[SOLUTION_CLASSES / 2];
+} PerfectBenchmark;
+
+const PerfectBenchmark perfect_benchmark = { "0-1-2-3-", 13510, { 0, 36, 56, 64, 0, 0 } };
+
+// The record benchmark writes solution files with this in front of their names, and deletes them afterwards.
+const char* BENCHMARK_SOLUTION_PREFIX = "Benchmark_";
+
+// The dedupe benchmark writes every cube symmetric to this many random cubes, and dedupes them this many at a time in memory,
+// so that the runs have to be merged.
+const int DEDUPE_CUBES = 20000;
+const int DEDUPE_RUN_BENCHMARK_SOLUTIONS = 1 << 16;
+
+// The record benchmark runs each solution format this many times and keeps the quickest run.
+const int RECORD_REPEATS = 5;
+
+// A simple, repeatable random number generator, so every run records the same probes.
+unsigned int benchmark_random_state = 12345;
+unsigned int BenchmarkRandom(unsigned int limit)
+{
+    benchmark_random_state = benchmark_random_state * 1103515245 + 12345;
+    return (benchmark_random_state >> 16) % limit;
+}
+
+
+// Pick a random task that starts edge_count edges deep. Most prefixes won't survive ApplyEdgePrefix(), so just keep trying.
+void RandomEdgeTask(int edge_count, EdgeTask* task)
+{
+    const char ids[] = "0123456789AB";
+    char prefix[2 * CUBE_EDGES + 1];
+    do {
+        bool used[CUBE_EDGES] = { false, false, false, false, false, false, false, false, false, false, false, false };
+        for (int edge_num = 0; edge_num < edge_count; ++edge_num) {
+            unsigned int piece;
+            do {
+                piece = BenchmarkRandom(CUBE_EDGES);
+            } while (used[piece]);
+            used[piece] = true;
+            prefix[2 * edge_num] = ids[piece];
+            prefix[2 * edge_num + 1] = BenchmarkRandom(2) ? '-' : '_';
+        }
+        prefix[2 * edge_count] = '\0';
+        InitEdgeTask(task);
+    } while (!ApplyEdgePrefix(task, prefix));
+}
+
+
+// Run the edge search below random prefixes and record the corner joins it makes.
+void RecordJoinProbes(std::vector<JoinProbe>* probes)
+{
+    EdgeSearchState state;
+    InitEdgeSearchState(&state);
+    state.join_probes = probes;
+    state.record_solutions = false;
+
+    while (probes->size() < PROBE_TARGET) {
+        EdgeTask task;
+        RandomEdgeTask(PROBE_PREFIX_EDGES, &task);
+        RunEdgeTask(&state, task);
+    }
+}
+
+
+//
+// The corner arrangement layout from before the keys were split from the arrangements, for comparison.
+//
+
+typedef struct {
+    unsigned char arrangement[CUBE_SURFACES];
+    unsigned int faceIds[CUBE_FACES];
+    unsigned int nextIndex[CUBE_FACES];
+} CombinedCornerArrangement;
+
+
+CombinedCornerArrangement* CombineCornerArrangements(const CornerArrangementTable* table)
+{
+    CombinedCornerArrangement* combined = new CombinedCornerArrangement[table->count];
+    for (int i = 0; i < table->count; ++i) {
+        memcpy(combined[i].arrangement, table->arrangements[i], CUBE_SURFACES);
+        for (int face = 0; face < CUBE_FACES; ++face) {
+            combined[i].faceIds[face] = corner_face_ids[table->keys[i].faceIds[face]];
+            combined[i].nextIndex[face] = table->keys[i].nextIndex[face];
+        }
+    }
+    return combined;
+}
+
+
+// GetCornerArrangementsIndex() as it was for the combined layout.
+int GetCombinedCornerArrangementsIndex(int index, const CombinedCornerArrangement* corner_arrangements, const unsigned short* edge_face_codes, int face_id_count, int max_index)
+{
+    if ((index > max_index) || (index == -1)) {
+        return -1;
+    }
+
+    for (int face_num = 0; face_num < face_id_count; ) {
+        int face_idx = corner_arrangements[index].faceIds[face_num] + edge_face_ids[edge_face_codes[face_num]];
+        if (IsPerfectFace(face_idx)) {
+            ++face_num;
+        }
+        else {
+            index = corner_arrangements[index].nextIndex[face_num];
+            if (index == -1) {
+                break;
+            }
+            face_num = 0;
+        }
+    }
+
+    return index;
+}
+
+
+// GetCornerArrangementsIndex() as it was before it used corner_face_matches[]: step through the keys with nextIndex.
+int ScanCornerArrangementsIndex(int index, const CornerArrangementTable* table, const unsigned short* edge_face_codes, int face_id_count)
+{
+    if ((index >= table->count) || (index == -1)) {
+        return -1;
+    }
+
+    const CornerArrangementKey* keys = table->keys;
+    for (int face_num = 0; face_num < face_id_count; ) {
+        int face_idx = corner_face_ids[keys[index].faceIds[face_num]] + edge_face_ids[edge_face_codes[face_num]];
+
+        if (IsPerfectFace(face_idx)) {
+            ++face_num;
+        }
+        else {
+            index = keys[index].nextIndex[face_num];
+            if (index == -1) {
+                break;
+            }
+            face_num = 0;
+        }
+    }
+
+    return index;
+}
+
+
+// Counts the distinct cache lines a probe reads.
+typedef struct {
+    std::vector<size_t> lines;
+} LineCounter;
+
+void TouchLines(LineCounter* counter, const void* address, size_t size)
+{
+    size_t first = (size_t)address / CACHE_LINE_SIZE;
+    size_t last = ((size_t)address + size - 1) / CACHE_LINE_SIZE;
+    for (size_t line = first; line <= last; ++line) {
+        counter->lines.push_back(line);
+    }
+}
+
+size_t CountLines(LineCounter* counter)
+{
+    std::sort(counter->lines.begin(), counter->lines.end());
+    return std::unique(counter->lines.begin(), counter->lines.end()) - counter->lines.begin();
+}
+
+
+// Replay a probe against the combined layout, counting the cache lines it reads from the corner arrangements.
+size_t CombinedProbeLines(const JoinProbe& probe, const CombinedCornerArrangement* corner_arrangements, int max_index)
+{
+    LineCounter counter;
+    int index = probe.index;
+    if ((index > max_index) || (index == -1)) {
+        return 0;
+    }
+
+    for (int face_num = 0; face_num < probe.face_id_count; ) {
+        TouchLines(&counter, &corner_arrangements[index].faceIds[face_num], sizeof(unsigned int));
+        if (IsPerfectFace(corner_arrangements[index].faceIds[face_num] + edge_face_ids[probe.edge_face_codes[face_num]])) {
+            ++face_num;
+        }
+        else {
+            TouchLines(&counter, &corner_arrangements[index].nextIndex[face_num], sizeof(unsigned int));
+            index = corner_arrangements[index].nextIndex[face_num];
+            if (index == -1) {
+                break;
+            }
+            face_num = 0;
+        }
+    }
+
+    return CountLines(&counter);
+}
+
+
+// Replay a probe against the split layout, counting the cache lines it reads from the keys.
+size_t SplitProbeLines(const JoinProbe& probe, const CornerArrangementTable* table)
+{
+    LineCounter counter;
+    int index = probe.index;
+    if ((index >= table->count) || (index == -1)) {
+        return 0;
+    }
+
+    for (int face_num = 0; face_num < probe.face_id_count; ) {
+        TouchLines(&counter, &table->keys[index].faceIds[face_num], sizeof(unsigned short));
+        if (IsPerfectFace(corner_face_ids[table->keys[index].faceIds[face_num]] + edge_face_ids[probe.edge_face_codes[face_num]])) {
+            ++face_num;
+        }
+        else {
+            TouchLines(&counter, &table->keys[index].nextIndex[face_num], sizeof(unsigned int));
+            index = table->keys[index].nextIndex[face_num];
+            if (index == -1) {
+                break;
+            }
+            face_num = 0;
+        }
+    }
+
+    return CountLines(&counter);
+}
+
+
+// Replay a probe with the guided join, counting the cache lines it reads from the keys. Follows GetCornerArrangementsIndex().
+size_t GuidedProbeLines(const JoinProbe& probe, const CornerArrangementTable* table)
+{
+    LineCounter counter;
+    int index = probe.index;
+    if ((index >= table->count) || (index == -1)) {
+        return 0;
+    }
+
+    const CornerArrangementKey* keys = table->keys;
+    for (int face_num = 0; face_num < probe.face_id_count; ) {
+        const unsigned long long* matches = corner_face_matches[probe.edge_face_codes[face_num]];
+        TouchLines(&counter, &keys[index].faceIds[face_num], sizeof(unsigned short));
+        int code = keys[index].faceIds[face_num];
+        if ((matches[code / 64] & (1ULL << (code % 64))) != 0) {
+            ++face_num;
+            continue;
+        }
+
+        int next_code = code + 1;
+        while ((next_code < CORNER_FACE_CODES) && ((matches[next_code / 64] & (1ULL << (next_code % 64))) == 0)) {
+            ++next_code;
+        }
+
+        if (face_num == 0) {
+            index = table->first_indexes[next_code];
+        }
+        else {
+            TouchLines(&counter, &keys[index].nextIndex[face_num - 1], sizeof(unsigned int));
+            int last = (int)keys[index].nextIndex[face_num - 1];
+            if (last == -1) {
+                last = table->count;
+            }
+
+            int low = index + 1;
+            int high = low;
+            if (next_code == CORNER_FACE_CODES) {
+                low = high = last;
+            }
+            for (int step = 1; high < last; step *= 2) {
+                TouchLines(&counter, &keys[high].faceIds[face_num], sizeof(unsigned short));
+                if (keys[high].faceIds[face_num] >= next_code) {
+                    break;
+                }
+                low = high + 1;
+                high = low + step;
+            }
+            if (high > last) {
+                high = last;
+            }
+            while (low < high) {
+                int middle = low + (high - low) / 2;
+                TouchLines(&counter, &keys[middle].faceIds[face_num], sizeof(unsigned short));
+                if (keys[middle].faceIds[face_num] < next_code) {
+                    low = middle + 1;
+                }
+                else {
+                    high = middle;
+                }
+            }
+
+            index = low;
+            if (index == last) {
+                face_num = 0;
+            }
+        }
+
+        if (index >= table->count) {
+            break;
+        }
+    }
+
+    return CountLines(&counter);
+}
+
+
+// Compare ways of joining corner arrangements on probes recorded from the edge search: stepping through the keys with
+// nextIndex in the combined and split layouts, and the guided join the search uses.
+void JoinBenchmark()
+{
+    std::vector<JoinProbe> probes;
+    RecordJoinProbes(&probes);
+
+    CombinedCornerArrangement* combined[2] = { CombineCornerArrangements(&ep_corner_table), CombineCornerArrangements(&op_corner_table) };
+    const CornerArrangementTable* tables[2] = { &ep_corner_table, &op_corner_table };
+
+    const int JOINS = 3;
+    const int REPEATS = 3;
+    double best_seconds[JOINS] = { 1e30, 1e30, 1e30 };
+    long long results[JOINS] = { 0, 0, 0 };
+
+    for (int repeat = 0; repeat < REPEATS; ++repeat) {
+        for (int join = 0; join < JOINS; ++join) {
+            long long result = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < probes.size(); ++i) {
+                const JoinProbe& probe = probes[i];
+                if (join == 0) {
+                    result += GetCombinedCornerArrangementsIndex(probe.index, combined[probe.swap_parity], probe.edge_face_codes, probe.face_id_count, tables[probe.swap_parity]->count - 1);
+                }
+                else if (join == 1) {
+                    result += ScanCornerArrangementsIndex(probe.index, tables[probe.swap_parity], probe.edge_face_codes, probe.face_id_count);
+                }
+                else {
+                    result += GetCornerArrangementsIndex(probe.index, tables[probe.swap_parity], probe.edge_face_codes, probe.face_id_count, NULL);
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds < best_seconds[join]) {
+                best_seconds[join] = seconds;
+            }
+            results[join] = result;
+        }
+    }
+
+    bool consistent = (results[0] == results[1]) && (results[0] == results[2]);
+    if (!consistent) {
+        fprintf(stderr, "The corner joins disagree on the join results.\n");
+    }
+
+    double lines[JOINS] = { 0, 0, 0 };
+    for (size_t i = 0; i < probes.size(); ++i) {
+        lines[0] += (double)CombinedProbeLines(probes[i], combined[probes[i].swap_parity], tables[probes[i].swap_parity]->count - 1);
+        lines[1] += (double)SplitProbeLines(probes[i], tables[probes[i].swap_parity]);
+        lines[2] += (double)GuidedProbeLines(probes[i], tables[probes[i].swap_parity]);
+    }
+
+    const char* layout_names[JOINS] = { "combined", "split", "split" };
+    const char* join_names[JOINS] = { "scan", "scan", "guided" };
+    size_t record_sizes[JOINS] = { sizeof(CombinedCornerArrangement), sizeof(CornerArrangementKey), sizeof(CornerArrangementKey) };
+    for (int join = 0; join < JOINS; ++join) {
+        printf("{\"benchmark\": \"join\", \"layout\": \"%s\", \"join\": \"%s\", \"record_bytes\": %zu, \"probes\": %zu, \"ns_per_probe\": %.2f, \"corner_lines_per_probe\": %.2f, \"consistent\": %s}\n",
+            layout_names[join], join_names[join], record_sizes[join], probes.size(), best_seconds[join] * 1e9 / probes.size(), lines[join] / probes.size(),
+            consistent ? "true" : "false");
+    }
+
+    delete[] combined[0];
+    delete[] combined[1];
+}
+
+
+// Time building the perfect face patterns, building the full face table, and reading it back from FaceTable.dat.
+// The search only checks a face's edges against its center and each other (with the edge lanes), and its corners against
+// its center and each other (corner_count_checks), until the face is complete. That is all it can check on one face if every
+// filling of the edges that passes those checks makes a perfect face with some filling of the corners that passes theirs,
+// and the other way round. A partial face that passes can always be filled out to one that passes, so it can't be dead
+// either. Returns the number of fillings that don't have a match.
+int CountDeadFaceFillings()
+{
+    const int digit_places[9] = { 1679616, 279936, 46656, 7776, 1296, 216, 36, 6, 1 };
+    int dead = 0;
+
+    for (int center = 0; center < CUBE_COLORS; ++center) {
+        // The fillings of positions 1, 3, 5, 7 and of 0, 2, 6, 8 that pass, as their part of the face index.
+        std::vector<int> edge_fillings;
+        std::vector<int> corner_fillings;
+        for (int code = 0; code < CUBE_COLORS * CUBE_COLORS * CUBE_COLORS * CUBE_COLORS; ++code) {
+            int c[4] = { code / 216, (code / 36) % CUBE_COLORS, (code / CUBE_COLORS) % CUBE_COLORS, code % CUBE_COLORS };
+            bool clash = (c[0] == center) || (c[1] == center) || (c[2] == center) || (c[3] == center);
+
+            if (!clash && (c[0] != c[1]) && (c[0] != c[2]) && (c[1] != c[3]) && (c[2] != c[3])) {
+                edge_fillings.push_back(c[0] * digit_places[1] + c[1] * digit_places[3] + c[2] * digit_places[5] + c[3] * digit_places[7]);
+            }
+
+            int counts[CUBE_COLORS] = { 0, 0, 0, 0, 0, 0 };
+            bool three_same_color = false;
+            for (int i = 0; i < 4; ++i) {
+                three_same_color = three_same_color || (++counts[c[i]] > 2);
+            }
+            if (!clash && !three_same_color) {
+                corner_fillings.push_back(c[0] * digit_places[0] + c[1] * digit_places[2] + c[2] * digit_places[6] + c[3] * digit_places[8]);
+            }
+        }
+
+        std::vector<bool> corner_matched(corner_fillings.size(), false);
+        for (size_t e = 0; e < edge_fillings.size(); ++e) {
+            bool matched = false;
+            for (size_t c = 0; c < corner_fillings.size(); ++c) {
+                if (IsPerfectFace(center * digit_places[4] + edge_fillings[e] + corner_fillings[c])) {
+                    matched = true;
+                    corner_matched[c] = true;
+                }
+            }
+            dead += matched ? 0 : 1;
+        }
+        for (size_t c = 0; c < corner_fillings.size(); ++c) {
+            dead += corner_matched[c] ? 0 : 1;
+        }
+    }
+
+    return dead;
+}
+
+
+void FacesBenchmark(int thread_count)
+{
+    auto start = std::chrono::steady_clock::now();
+    BuildPerfectFaces(SEARCH_CRITERIA_DEFAULT);
+    double perfect_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    BuildFaceTable(thread_count);
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Anything BuildFaceTable() and BuildPerfectFaces() disagree on.
+    int mismatches = 0;
+    int pattern_count = 0;
+    int perfect_faces = 0;
+    for (int i = 0; i < FACE_ARRANGEMENTS; ++i) {
+        int perfect_id = -1;
+        if (IsPerfectFace(i)) {
+            perfect_id = PerfectPatternId(i);
+            ++perfect_faces;
+        }
+        if ((face_table[i] < PERFECT_PATTERNS) ? (perfect_id != face_table[i]) : (perfect_id != -1)) {
+            ++mismatches;
+        }
+        if (face_table[i] >= pattern_count) {
+            pattern_count = face_table[i] + 1;
+        }
+    }
+
+    std::vector<__int16> built(face_table, face_table + FACE_ARRANGEMENTS);
+    bool written = WriteFaceTable();
+    start = std::chrono::steady_clock::now();
+    bool read = written && ReadFaceTable();
+    double read_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bool read_matches = read && (memcmp(built.data(), face_table, sizeof(face_table)) == 0);
+
+    printf("{\"benchmark\": \"faces\", \"step\": \"perfect\", \"seconds\": %.4f, \"perfect_faces\": %i, \"consistent\": %s}\n",
+        perfect_seconds, perfect_faces, (mismatches == 0) ? "true" : "false");
+    printf("{\"benchmark\": \"faces\", \"step\": \"build\", \"threads\": %i, \"seconds\": %.4f, \"patterns\": %i, \"consistent\": %s}\n",
+        thread_count, build_seconds, pattern_count, (mismatches == 0) ? "true" : "false");
+    printf("{\"benchmark\": \"faces\", \"step\": \"read\", \"seconds\": %.4f, \"consistent\": %s}\n",
+        read_seconds, read_matches ? "true" : "false");
+
+    start = std::chrono::steady_clock::now();
+    int dead_fillings = CountDeadFaceFillings();
+    double partial_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("{\"benchmark\": \"faces\", \"step\": \"partial\", \"seconds\": %.4f, \"dead_fillings\": %i, \"consistent\": %s}\n",
+        partial_seconds, dead_fillings, (dead_fillings == 0) ? "true" : "false");
+}
+
+
+// Search below random prefixes with the walk, then with the bitset join on each set of instructions the CPU has.
+void BitsetBenchmark(int thread_count)
+{
+    // Other benchmarks may have built the bitsets already, so build them again to time it.
+    FreeCornerBitsets();
+    auto start = std::chrono::steady_clock::now();
+    if (!BuildCornerBitsets(thread_count)) {
+        return;
+    }
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("{\"benchmark\": \"bitset\", \"step\": \"build\", \"threads\": %i, \"seconds\": %.4f}\n", thread_count, build_seconds);
+
+    std::vector<EdgeTask> tasks(BITSET_PREFIXES);
+    for (int i = 0; i < BITSET_PREFIXES; ++i) {
+        RandomEdgeTask(BITSET_PREFIX_EDGES, &tasks[i]);
+    }
+
+    const char* best_instructions = GetCornerBitsetInstructions();
+    const char* join_names[4] = { "walk", "bitset", "bitset", "bitset" };
+    const char* instruction_names[4] = { "scalar", "scalar", "avx2", "avx512" };
+    unsigned long int walk_solutions = 0;
+    double walk_seconds = 0;
+    CornerBitsetState corner_bitsets;
+
+    for (int join = 0; join < 4; ++join) {
+        if ((join > 0) && !SetCornerBitsetInstructions(instruction_names[join])) {
+            continue;
+        }
+
+        EdgeSearchState state;
+        InitEdgeSearchState(&state);
+        state.record_solutions = false;
+        state.corner_bitsets = (join > 0) ? &corner_bitsets : NULL;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BITSET_PREFIXES; ++i) {
+            RunEdgeTask(&state, tasks[i]);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (join == 0) {
+            walk_solutions = state.solutions;
+            walk_seconds = seconds;
+        }
+        bool consistent = state.solutions == walk_solutions;
+        if (!consistent) {
+            fprintf(stderr, "The %s bitset join finds %lu solutions, the walk finds %lu.\n", instruction_names[join], state.solutions, walk_solutions);
+        }
+        printf("{\"benchmark\": \"bitset\", \"join\": \"%s\", \"instructions\": \"%s\", \"prefixes\": %i, \"seconds\": %.4f, \"speedup\": %.2f, \"edge_arrangements\": %lu, \"solutions\": %lu, \"consistent\": %s}\n",
+            join_names[join], (join > 0) ? instruction_names[join] : "", BITSET_PREFIXES, seconds, walk_seconds / seconds, state.edge_arrangements, state.solutions,
+            consistent ? "true" : "false");
+    }
+
+    SetCornerBitsetInstructions(best_instructions);
+}
+
+
+// How many pairs of surfaces on the same face are the same color and touch, on a side or at a corner.
+int CountFaceTouching(const unsigned char cube[CUBE_SURFACES])
+{
+    int touching = 0;
+    for (int face = 0; face < CUBE_FACES; ++face) {
+        for (int a = 0; a < 9; ++a) {
+            for (int b = a + 1; b < 9; ++b) {
+                bool neighbors = (abs(a / 3 - b / 3) <= 1) && (abs(a % 3 - b % 3) <= 1);
+                if (neighbors && (cube[face * 9 + a] / 9 == cube[face * 9 + b] / 9)) {
+                    ++touching;
+                }
+            }
+        }
+    }
+    return touching;
+}
+
+
+// A random cube with the centers in place. Swapping surfaces doesn't make a cube that can be reached by turning it, but
+// GetColorConnectedness() doesn't care. Random cubes almost always have sides touching, so keep swaps that don't make
+// more surfaces touch on the same face for a random number of steps.
+void RandomConnectednessCube(unsigned char cube[CUBE_SURFACES])
+{
+    for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+        cube[surface] = (unsigned char)surface;
+    }
+    for (int surface = CUBE_SURFACES - 1; surface > 0; --surface) {
+        int other = (int)BenchmarkRandom(surface + 1);
+        if ((surface % 9 != 4) && (other % 9 != 4)) {
+            SWAP(cube[surface], cube[other]);
+        }
+    }
+
+    int touching = CountFaceTouching(cube);
+    int steps = (int)BenchmarkRandom(CONNECTEDNESS_STEPS);
+    for (int step = 0; (step < steps) && (touching != 0); ++step) {
+        int a = (int)BenchmarkRandom(CUBE_SURFACES);
+        int b = (int)BenchmarkRandom(CUBE_SURFACES);
+        if ((a % 9 == 4) || (b % 9 == 4)) {
+            continue;
+        }
+
+        SWAP(cube[a], cube[b]);
+        int next = CountFaceTouching(cube);
+        if (next > touching) {
+            SWAP(cube[a], cube[b]);
+        }
+        else {
+            touching = next;
+        }
+    }
+}
+
+
+// Score random cubes one at a time and in batches, with each set of instructions the CPU has, and check every result
+// against the scalar version.
+void ConnectednessBenchmark()
+{
+    const char* best_instructions = GetConnectednessInstructions();
+    SetConnectednessInstructions("scalar");
+
+    std::vector<unsigned char> cubes((size_t)CONNECTEDNESS_CUBES * CUBE_SURFACES);
+    const unsigned char (*cube_array)[CUBE_SURFACES] = (const unsigned char (*)[CUBE_SURFACES])cubes.data();
+    std::vector<int> expected(CONNECTEDNESS_CUBES);
+    int class_counts[4] = { 0, 0, 0, 0 };
+    for (int i = 0; i < CONNECTEDNESS_CUBES; ++i) {
+        RandomConnectednessCube(&cubes[(size_t)i * CUBE_SURFACES]);
+        expected[i] = GetColorConnectedness(&cubes[(size_t)i * CUBE_SURFACES]);
+        ++class_counts[expected[i]];
+    }
+
+    const char* instruction_names[2] = { "scalar", "avx512" };
+    std::vector<int> results(CONNECTEDNESS_CUBES);
+    for (int set = 0; set < 2; ++set) {
+        if (!SetConnectednessInstructions(instruction_names[set])) {
+            continue;
+        }
+
+        for (int batch = 0; batch < 2; ++batch) {
+            int mismatches = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int repeat = 0; repeat < CONNECTEDNESS_REPEATS; ++repeat) {
+                if (batch) {
+                    GetColorConnectednessBatch(cube_array, CONNECTEDNESS_CUBES, results.data());
+                }
+                else {
+                    for (int i = 0; i < CONNECTEDNESS_CUBES; ++i) {
+                        results[i] = GetColorConnectedness(&cubes[(size_t)i * CUBE_SURFACES]);
+                    }
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            for (int i = 0; i < CONNECTEDNESS_CUBES; ++i) {
+                mismatches += (results[i] != expected[i]) ? 1 : 0;
+            }
+            if (mismatches != 0) {
+                fprintf(stderr, "The %s connectedness%s disagrees with the scalar version on %i cubes.\n", instruction_names[set], batch ? " batch" : "", mismatches);
+            }
+            printf("{\"benchmark\": \"connectedness\", \"instructions\": \"%s\", \"batch\": %s, \"cubes\": %i, \"ns_per_cube\": %.2f, "
+                "\"sides\": %i, \"corners\": %i, \"adjacent_faces\": %i, \"nothing\": %i, \"consistent\": %s}\n",
+                instruction_names[set], batch ? "true" : "false", CONNECTEDNESS_CUBES, seconds * 1e9 / ((double)CONNECTEDNESS_CUBES * CONNECTEDNESS_REPEATS),
+                class_counts[SIDES_TOUCHING], class_counts[CORNERS_TOUCHING], class_counts[ADJACENT_FACES_TOUCHING], class_counts[NOTHING_TOUCHING],
+                (mismatches == 0) ? "true" : "false");
+        }
+    }
+
+    SetConnectednessInstructions(best_instructions);
+}
+
+
+// Time creating the corner arrangements from scratch, and check they come out the same as the ones already loaded.
+void CornersBenchmark(int thread_count)
+{
+    unsigned long long checksums[2];
+    const CornerArrangementTable* tables[2] = { &ep_corner_table, &op_corner_table };
+    for (int pass = 0; pass < 2; ++pass) {
+        double seconds = 0;
+        if (pass == 1) {
+            auto start = std::chrono::steady_clock::now();
+            CreateCornerArrangements(thread_count, false);
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        unsigned long long checksum = CHECKSUM_SEED;
+        for (int parity = 0; parity < 2; ++parity) {
+            checksum = Checksum(tables[parity]->keys, (size_t)tables[parity]->count * sizeof(CornerArrangementKey), checksum);
+            checksum = Checksum(tables[parity]->arrangements, (size_t)tables[parity]->count * CUBE_SURFACES, checksum);
+        }
+        checksums[pass] = checksum;
+
+        if (pass == 1) {
+            if (checksums[0] != checksums[1]) {
+                fprintf(stderr, "The created corner arrangements don't match the ones that were loaded.\n");
+            }
+            printf("{\"benchmark\": \"corners\", \"threads\": %i, \"seconds\": %.4f, \"even_arrangements\": %i, \"odd_arrangements\": %i, \"consistent\": %s}\n",
+                thread_count, seconds, ep_corner_table.count, op_corner_table.count, (checksums[0] == checksums[1]) ? "true" : "false");
+        }
+    }
+}
+
+
+// Search below one of the subtree prefixes on this thread. Returns false if the prefix is bad.
+bool RunSubtree(EdgeSearchState* state, const SubtreeBenchmark& subtree)
+{
+    EdgeTask task;
+    InitEdgeTask(&task);
+    if (!ApplyEdgePrefix(&task, subtree.prefix)) {
+        fprintf(stderr, "Bad benchmark prefix: %s\n", subtree.prefix);
+        return false;
+    }
+
+    RunEdgeTask(state, task);
+    return true;
+}
+
+
+// Search below each fixed prefix, with the walk and with the bitset join, and check the counts.
+void SubtreesBenchmark(int thread_count)
+{
+    if (!BuildCornerBitsets(thread_count)) {
+        return;
+    }
+    CornerBitsetState corner_bitsets;
+
+    for (int join = CORNER_JOIN_WALK; join <= CORNER_JOIN_BITSET; ++join) {
+        for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+            EdgeSearchState state;
+            InitEdgeSearchState(&state);
+            state.record_solutions = false;
+            state.corner_bitsets = (join == CORNER_JOIN_BITSET) ? &corner_bitsets : NULL;
+
+            auto start = std::chrono::steady_clock::now();
+            if (!RunSubtree(&state, subtree_benchmarks[i])) {
+                continue;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            bool consistent = (state.edge_arrangements == subtree_benchmarks[i].edge_arrangements) && (state.solutions == subtree_benchmarks[i].solutions);
+            if (!consistent) {
+                fprintf(stderr, "Below %s the search found %lu edge arrangements and %lu solutions, not %lu and %lu.\n", subtree_benchmarks[i].prefix,
+                    state.edge_arrangements, state.solutions, subtree_benchmarks[i].edge_arrangements, subtree_benchmarks[i].solutions);
+            }
+            printf("{\"benchmark\": \"subtrees\", \"prefix\": \"%s\", \"join\": \"%s\", \"seconds\": %.4f, \"edge_arrangements\": %lu, \"solutions\": %lu, \"consistent\": %s}\n",
+                subtree_benchmarks[i].prefix, (join == CORNER_JOIN_BITSET) ? "bitset" : "walk", seconds, state.edge_arrangements, state.solutions,
+                consistent ? "true" : "false");
+        }
+    }
+}
+
+
+// Build the second halves, then search below each fixed prefix with each edge engine and corner join, and check the counts.
+void HalvesBenchmark(int thread_count)
+{
+    auto start = std::chrono::steady_clock::now();
+    BuildEdgeHalves();
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("{\"benchmark\": \"halves\", \"step\": \"build\", \"seconds\": %.4f, \"halves\": %i, \"megabytes\": %.1f}\n", build_seconds,
+        (int)edge_half_table.halves.size(), edge_half_table.halves.size() * sizeof(EdgeHalf) / 1e6);
+
+    if (!BuildCornerBitsets(thread_count)) {
+        return;
+    }
+    CornerBitsetState corner_bitsets;
+
+    for (int join = CORNER_JOIN_WALK; join <= CORNER_JOIN_BITSET; ++join) {
+        double recursive_seconds = 0;
+        for (int engine = EDGE_ENGINE_RECURSIVE; engine <= EDGE_ENGINE_HALVES; ++engine) {
+            double seconds = 0;
+            bool consistent = true;
+            unsigned long int solutions = 0;
+            for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+                EdgeSearchState state;
+                InitEdgeSearchState(&state);
+                state.record_solutions = false;
+                state.corner_bitsets = (join == CORNER_JOIN_BITSET) ? &corner_bitsets : NULL;
+                state.edge_halves = (engine == EDGE_ENGINE_HALVES) ? &edge_half_table : NULL;
+
+                start = std::chrono::steady_clock::now();
+                if (!RunSubtree(&state, subtree_benchmarks[i])) {
+                    consistent = false;
+                    continue;
+                }
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                if ((state.edge_arrangements != subtree_benchmarks[i].edge_arrangements) || (state.solutions != subtree_benchmarks[i].solutions)) {
+                    fprintf(stderr, "Below %s the %s engine found %lu edge arrangements and %lu solutions, not %lu and %lu.\n", subtree_benchmarks[i].prefix,
+                        (engine == EDGE_ENGINE_HALVES) ? "halves" : "recursive", state.edge_arrangements, state.solutions,
+                        subtree_benchmarks[i].edge_arrangements, subtree_benchmarks[i].solutions);
+                    consistent = false;
+                }
+                solutions += state.solutions;
+            }
+
+            if (engine == EDGE_ENGINE_RECURSIVE) {
+                recursive_seconds = seconds;
+            }
+            printf("{\"benchmark\": \"halves\", \"engine\": \"%s\", \"join\": \"%s\", \"prefixes\": %i, \"seconds\": %.4f, \"speedup\": %.2f, \"solutions\": %lu, \"consistent\": %s}\n",
+                (engine == EDGE_ENGINE_HALVES) ? "halves" : "recursive", (join == CORNER_JOIN_BITSET) ? "bitset" : "walk", SUBTREE_BENCHMARKS, seconds,
+                recursive_seconds / seconds, solutions, consistent ? "true" : "false");
+        }
+    }
+}
+
+
+// Add a solution's cube to a hash of the solutions a stream gives, in the order it gives them.
+unsigned long long HashStreamSolution(unsigned long long hash, const StreamSolution& solution)
+{
+    for (int i = 0; i < CUBE_SURFACES; ++i) {
+        hash = (hash ^ solution.cube[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// Stream the solutions below each fixed prefix, and check the stream gives as many as the search finds. Then stop a stream
+// halfway, carry on from its position in a new stream, and check the two halves give the same solutions as the whole. Last,
+// pull from a stream for every prefix in turn, and check none of them gets in the others' way.
+void StreamBenchmark()
+{
+    const unsigned long long HASH_START = 14695981039346656037ULL;
+    unsigned long long hashes[SUBTREE_BENCHMARKS];
+    EdgeTask tasks[SUBTREE_BENCHMARKS];
+    double search_seconds = 0;
+    double stream_seconds = 0;
+    unsigned long long solutions = 0;
+    bool consistent = true;
+
+    for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+        InitEdgeTask(&tasks[i]);
+        if (!ApplyEdgePrefix(&tasks[i], subtree_benchmarks[i].prefix)) {
+            fprintf(stderr, "Bad benchmark prefix: %s\n", subtree_benchmarks[i].prefix);
+            return;
+        }
+
+        EdgeSearchState state;
+        InitEdgeSearchState(&state);
+        state.record_solutions = false;
+        auto start = std::chrono::steady_clock::now();
+        RunEdgeTask(&state, tasks[i]);
+        search_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        SolutionStream stream(tasks[i], SYMMETRY_NONE);
+        StreamSolution solution;
+        hashes[i] = HASH_START;
+        start = std::chrono::steady_clock::now();
+        while (stream.Next(&solution)) {
+            hashes[i] = HashStreamSolution(hashes[i], solution);
+        }
+        stream_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        solutions += stream.Count();
+
+        // Every solution the search finds with the default criteria meets the rest of them, so the stream gives them all.
+        if ((stream.Count() != subtree_benchmarks[i].solutions) || (state.solutions != subtree_benchmarks[i].solutions)) {
+            fprintf(stderr, "Below %s the stream gave %llu solutions and the search found %lu, not %lu.\n", subtree_benchmarks[i].prefix, stream.Count(),
+                state.solutions, subtree_benchmarks[i].solutions);
+            consistent = false;
+        }
+    }
+    printf("{\"benchmark\": \"stream\", \"step\": \"whole\", \"prefixes\": %i, \"seconds\": %.4f, \"search_seconds\": %.4f, \"solutions\": %llu, \"consistent\": %s}\n",
+        SUBTREE_BENCHMARKS, stream_seconds, search_seconds, solutions, consistent ? "true" : "false");
+
+    bool resumed = true;
+    for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+        SolutionStream first(tasks[i], SYMMETRY_NONE);
+        StreamSolution solution;
+        unsigned long long hash = HASH_START;
+        while ((first.Count() < subtree_benchmarks[i].solutions / 2) && first.Next(&solution)) {
+            hash = HashStreamSolution(hash, solution);
+        }
+        SolutionStreamPosition position;
+        first.GetPosition(&position);
+
+        SolutionStream second(tasks[i], SYMMETRY_NONE);
+        if (!second.SetPosition(position)) {
+            fprintf(stderr, "A stream below %s couldn't carry on from where another one stopped.\n", subtree_benchmarks[i].prefix);
+            resumed = false;
+            continue;
+        }
+        while (second.Next(&solution)) {
+            hash = HashStreamSolution(hash, solution);
+        }
+        if ((hash != hashes[i]) || (second.Count() != subtree_benchmarks[i].solutions)) {
+            fprintf(stderr, "Below %s the stream gave different solutions once it was carried on from a position.\n", subtree_benchmarks[i].prefix);
+            resumed = false;
+        }
+    }
+    printf("{\"benchmark\": \"stream\", \"step\": \"resume\", \"prefixes\": %i, \"position_bytes\": %i, \"consistent\": %s}\n", SUBTREE_BENCHMARKS,
+        (int)sizeof(SolutionStreamPosition), resumed ? "true" : "false");
+
+    std::vector<SolutionStream*> streams;
+    unsigned long long interleaved[SUBTREE_BENCHMARKS];
+    for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+        streams.push_back(new SolutionStream(tasks[i], SYMMETRY_NONE));
+        interleaved[i] = HASH_START;
+    }
+    for (int left = SUBTREE_BENCHMARKS; left > 0;) {
+        left = 0;
+        for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+            StreamSolution solution;
+            if (streams[i]->Next(&solution)) {
+                interleaved[i] = HashStreamSolution(interleaved[i], solution);
+                ++left;
+            }
+        }
+    }
+    bool independent = true;
+    for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+        if (interleaved[i] != hashes[i]) {
+            fprintf(stderr, "Below %s the stream gave different solutions when pulled in turn with the others.\n", subtree_benchmarks[i].prefix);
+            independent = false;
+        }
+        delete streams[i];
+    }
+    printf("{\"benchmark\": \"stream\", \"step\": \"interleave\", \"streams\": %i, \"stream_bytes\": %i, \"consistent\": %s}\n", SUBTREE_BENCHMARKS,
+        (int)sizeof(SolutionStream), independent ? "true" : "false");
+}
+
+
+// What a solution file holds: lines in a text file, records in a binary one. Sets bytes to its size. A file that doesn't exist
+// holds nothing.
+unsigned long long CountFileSolutions(const char* filename, int format, unsigned long long* bytes)
+{
+    unsigned long long count = 0;
+    *bytes = 0;
+    MappedFile file;
+    if (MapFile(filename, &file)) {
+        *bytes = file.size;
+        if (format == SOLUTION_FORMAT_TEXT) {
+            count = std::count((const char*)file.data, (const char*)file.data + file.size, '\n');
+        }
+        else if (file.size >= SOLUTION_HEADER_SIZE) {
+            count = (file.size - SOLUTION_HEADER_SIZE) / SOLUTION_RECORD_SIZE;
+        }
+        UnmapFile(&file);
+    }
+    return count;
+}
+
+
+// Write the solutions below the first fixed prefix with a checkpoint, then resume from it. The checkpoint has to give the
+// size each solution file has on disk, and resuming mustn't cut anything off. On Windows, where text mode writes each \n as
+// \r\n, a text file size counted in memory would be short, and resuming would cut the last solutions off.
+bool ResumeRoundTrip(int format, CornerBitsetState* corner_bitsets, unsigned long long* solutions)
+{
+    char checkpoint_filename[100];
+    SinkCheckpointFileName(checkpoint_filename);
+    OpenSolutionSink(format, NULL, false);
+    CloseSolutionSink();
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        char filename[100];
+        SolutionFileName(i, filename);
+        remove(filename);
+    }
+    remove(checkpoint_filename);
+
+    EdgeSearchState state;
+    InitEdgeSearchState(&state);
+    state.record_solutions = true;
+    state.print_progress = false;
+    state.corner_bitsets = corner_bitsets;
+
+    SearchCheckpoint checkpoint;
+    InitSearchCheckpoint(&checkpoint, format, SYMMETRY_NONE);
+    bool consistent = OpenSolutionSink(format, &checkpoint, false);
+    if (consistent) {
+        RunSubtree(&state, subtree_benchmarks[0]);
+        consistent = CloseSolutionSink();
+    }
+
+    unsigned long long written[SOLUTION_CLASSES];
+    unsigned long long written_bytes[SOLUTION_CLASSES];
+    *solutions = 0;
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        char filename[100];
+        SolutionFileName(i, filename);
+        written[i] = CountFileSolutions(filename, format, &written_bytes[i]);
+        *solutions += written[i];
+    }
+    consistent = consistent && (*solutions == state.solutions) && ReadCheckpoint(checkpoint_filename, &checkpoint);
+    for (int i = 0; (i < SOLUTION_CLASSES) && consistent; ++i) {
+        unsigned long long size = (format == SOLUTION_FORMAT_TEXT) ? written_bytes[i] : written[i];
+        if (checkpoint.file_sizes[i] != size) {
+            fprintf(stderr, "The checkpoint says solution file %i has size %llu, but it has size %llu.\n", i, checkpoint.file_sizes[i], size);
+            consistent = false;
+        }
+    }
+
+    if (consistent && OpenSolutionSink(format, &checkpoint, true)) {
+        consistent = CloseSolutionSink();
+    }
+    else {
+        consistent = false;
+    }
+
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        char filename[100];
+        SolutionFileName(i, filename);
+        unsigned long long bytes;
+        if (consistent && ((CountFileSolutions(filename, format, &bytes) != written[i]) || (bytes != written_bytes[i]))) {
+            fprintf(stderr, "Resuming from the checkpoint cut solutions off %s.\n", filename);
+            consistent = false;
+        }
+        remove(filename);
+    }
+    remove(checkpoint_filename);
+    return consistent;
+}
+
+
+// One run of the record benchmark: search below the fixed prefixes with the bitset join, and record every solution in format,
+// or with format -1 only find them. Returns the seconds taken, including waiting for the writer to get everything onto disk.
+// Sets bytes to the size of the solution files and lines to the lines in each text file, then deletes the files.
+double RecordRun(int format, CornerBitsetState* corner_bitsets, EdgeSearchState* state, bool* written, unsigned long long* bytes,
+                 unsigned long long lines[SOLUTION_CLASSES])
+{
+    InitEdgeSearchState(state);
+    state->record_solutions = (format == SOLUTION_FORMAT_TEXT) || (format == SOLUTION_FORMAT_BINARY);
+    state->count_only = format == SOLUTION_FORMAT_COUNT;
+    state->print_progress = false;
+    state->corner_bitsets = corner_bitsets;
+
+    if (state->record_solutions) {
+        // Clear out anything left over from before, then write the files from scratch.
+        OpenSolutionSink(format, NULL, false);
+        CloseSolutionSink();
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            char filename[100];
+            SolutionFileName(i, filename);
+            remove(filename);
+        }
+        OpenSolutionSink(format, NULL, false);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+        RunSubtree(state, subtree_benchmarks[i]);
+    }
+    *written = !state->record_solutions || CloseSolutionSink();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    *bytes = 0;
+    for (int i = 0; (i < SOLUTION_CLASSES) && state->record_solutions; ++i) {
+        char filename[100];
+        SolutionFileName(i, filename);
+        unsigned long long file_bytes;
+        unsigned long long count = CountFileSolutions(filename, format, &file_bytes);
+        *bytes += file_bytes;
+        if (format == SOLUTION_FORMAT_TEXT) {
+            lines[i] = count;
+        }
+        remove(filename);
+    }
+    return seconds;
+}
+
+
+// Search below the fixed prefixes with the bitset join and write every solution, in each solution format, to find what
+// RecordSolution() and the solution sink cost on top of finding the solutions. Then count them with CountSolution() instead,
+// and check the count for each solution class against the lines written to its text file. After one untimed run to warm up,
+// every format runs RECORD_REPEATS times, in alternating order, and the quickest run of each is compared with the quickest
+// that only finds the solutions. Last, check that a search resumed from a checkpoint keeps every solution written before it,
+// in each format.
+void RecordBenchmark(int thread_count)
+{
+    if (!BuildCornerBitsets(thread_count)) {
+        return;
+    }
+    CornerBitsetState corner_bitsets;
+
+    // 0 finds the solutions without recording them, then each format records them.
+    const char* format_names[4] = { "none", "text", "binary", "count" };
+    const int formats[4] = { -1, SOLUTION_FORMAT_TEXT, SOLUTION_FORMAT_BINARY, SOLUTION_FORMAT_COUNT };
+    double best_seconds[4] = { 1e30, 1e30, 1e30, 1e30 };
+    unsigned long int solutions[4] = { 0, 0, 0, 0 };
+    unsigned long long bytes[4] = { 0, 0, 0, 0 };
+    bool consistent[4] = { true, true, true, true };
+    unsigned long long text_lines[SOLUTION_CLASSES] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    SearchTotals counts;
+    InitSearchTotals(&counts);
+    SetSolutionFilePrefix(BENCHMARK_SOLUTION_PREFIX);
+
+    unsigned long int expected = 0;
+    for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+        expected += subtree_benchmarks[i].solutions;
+    }
+
+    // Warm up first, so the baseline isn't the run that pays for cold caches.
+    EdgeSearchState state;
+    bool written;
+    RecordRun(-1, &corner_bitsets, &state, &written, &bytes[0], text_lines);
+
+    for (int repeat = 0; repeat < RECORD_REPEATS; ++repeat) {
+        for (int step = 0; step < 4; ++step) {
+            // The order flips every time, so no format always runs straight after another.
+            int format = ((repeat % 2) == 0) ? step : 3 - step;
+            double seconds = RecordRun(formats[format], &corner_bitsets, &state, &written, &bytes[format], text_lines);
+            best_seconds[format] = std::min(best_seconds[format], seconds);
+            solutions[format] = state.solutions;
+            consistent[format] = consistent[format] && (state.solutions == expected) && written;
+            if (state.count_only) {
+                counts = state.counts;
+            }
+        }
+    }
+
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        if (counts.solution_counts[i] != text_lines[i]) {
+            fprintf(stderr, "Counted %llu solutions in class %i, but %llu were written to its text file.\n", counts.solution_counts[i], i, text_lines[i]);
+            consistent[3] = false;
+        }
+    }
+
+    for (int format = 0; format < 4; ++format) {
+        // A format can't cost less than finding the solutions, whatever the noise says.
+        double extra_seconds = std::max(0.0, best_seconds[format] - best_seconds[0]);
+        printf("{\"benchmark\": \"record\", \"format\": \"%s\", \"repeats\": %i, \"seconds\": %.4f, \"solutions\": %lu, \"bytes\": %llu, \"ns_per_solution\": %.2f, \"consistent\": %s}\n",
+            format_names[format], RECORD_REPEATS, best_seconds[format], solutions[format], bytes[format],
+            (solutions[format] > 0) ? extra_seconds * 1e9 / solutions[format] : 0.0, consistent[format] ? "true" : "false");
+    }
+
+    for (int format = SOLUTION_FORMAT_TEXT; format <= SOLUTION_FORMAT_BINARY; ++format) {
+        unsigned long long solutions;
+        bool consistent = ResumeRoundTrip(format, &corner_bitsets, &solutions);
+        printf("{\"benchmark\": \"record\", \"step\": \"resume\", \"format\": \"%s\", \"solutions\": %llu, \"consistent\": %s}\n",
+            format_names[format + 1], solutions, consistent ? "true" : "false");
+    }
+
+    SetSolutionFilePrefix("");
+}
+
+
+// Count the solutions below the perfect prefix with the criteria already set, with each corner join, and check the _Perfect
+// solutions against the known counts. Perfect mustn't find any others, or more edge arrangements than the default.
+void PerfectPrefixBenchmark(int criteria, int thread_count)
+{
+    // The bitsets are built from the criteria's perfect faces.
+    FreeCornerBitsets();
+    if (!BuildCornerBitsets(thread_count)) {
+        return;
+    }
+    CornerBitsetState corner_bitsets;
+
+    for (int join = CORNER_JOIN_WALK; join <= CORNER_JOIN_BITSET; ++join) {
+        EdgeSearchState state;
+        InitEdgeSearchState(&state);
+        state.count_only = true;
+        state.print_progress = false;
+        state.corner_bitsets = (join == CORNER_JOIN_BITSET) ? &corner_bitsets : NULL;
+
+        EdgeTask task;
+        InitEdgeTask(&task);
+        if (!ApplyEdgePrefix(&task, perfect_benchmark.prefix)) {
+            fprintf(stderr, "Bad benchmark prefix: %s\n", perfect_benchmark.prefix);
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        RunEdgeTask(&state, task);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        bool consistent = (criteria == SEARCH_CRITERIA_PERFECT) ? (state.edge_arrangements <= perfect_benchmark.edge_arrangements) :
+                                                                  (state.edge_arrangements == perfect_benchmark.edge_arrangements);
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            if (i >= SOLUTION_CLASSES / 2) {
+                consistent = consistent && (state.counts.solution_counts[i] == perfect_benchmark.perfect_solutions[i - SOLUTION_CLASSES / 2]);
+            }
+            else if (criteria == SEARCH_CRITERIA_PERFECT) {
+                consistent = consistent && (state.counts.solution_counts[i] == 0);
+            }
+        }
+        if (!consistent) {
+            fprintf(stderr, "Below %s the search with the %s criteria and the %s join doesn't find the known _Perfect solutions.\n", perfect_benchmark.prefix,
+                search_criteria_names[criteria], (join == CORNER_JOIN_BITSET) ? "bitset" : "walk");
+        }
+
+        printf("{\"benchmark\": \"criteria\", \"criteria\": \"%s\", \"prefix\": \"%s\", \"join\": \"%s\", \"seconds\": %.4f, \"edge_arrangements\": %lu, \"perfect_solutions\": [",
+            search_criteria_names[criteria], perfect_benchmark.prefix, (join == CORNER_JOIN_BITSET) ? "bitset" : "walk", seconds, state.edge_arrangements);
+        for (int i = SOLUTION_CLASSES / 2; i < SOLUTION_CLASSES; ++i) {
+            printf("%s%llu", (i == SOLUTION_CLASSES / 2) ? "" : ", ", state.counts.solution_counts[i]);
+        }
+        printf("], \"consistent\": %s}\n", consistent ? "true" : "false");
+    }
+}
+
+
+// Count the solutions below the fixed prefixes with each of the built-in search criteria. The default criteria have to find
+// the known counts. Five patterns has to find the same edge arrangements and keep exactly the default's solutions with 5 or
+// 6 patterns. Five colors lets more partial faces through the corner join, so it has to find at least as many of both.
+// Perfect has to find exactly the default's _Perfect solutions, and no more edge arrangements. Both of them also search below
+// the perfect prefix with each corner join, and have to find its known _Perfect solutions.
+void CriteriaBenchmark(int thread_count)
+{
+    SearchTotals default_counts;
+    for (int criteria = 0; criteria < SEARCH_CRITERIA_COUNT; ++criteria) {
+        auto start = std::chrono::steady_clock::now();
+        SetSearchCriteria(criteria);
+        double setup_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        EdgeSearchState state;
+        InitEdgeSearchState(&state);
+        state.count_only = true;
+        state.print_progress = false;
+
+        unsigned long int expected_edge_arrangements = 0;
+        unsigned long int expected_solutions = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < SUBTREE_BENCHMARKS; ++i) {
+            RunSubtree(&state, subtree_benchmarks[i]);
+            expected_edge_arrangements += subtree_benchmarks[i].edge_arrangements;
+            expected_solutions += subtree_benchmarks[i].solutions;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        SearchTotals counts = state.counts;
+        counts.edge_arrangements = state.edge_arrangements;
+        unsigned long long counted = 0;
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            counted += counts.solution_counts[i];
+        }
+
+        bool consistent = (criteria == SEARCH_CRITERIA_FIVE_COLORS) ? (counts.edge_arrangements >= expected_edge_arrangements) :
+                          (criteria == SEARCH_CRITERIA_PERFECT) ? (counts.edge_arrangements <= expected_edge_arrangements) :
+                                                                  (counts.edge_arrangements == expected_edge_arrangements);
+        if (criteria == SEARCH_CRITERIA_DEFAULT) {
+            consistent = consistent && (counted == expected_solutions);
+            default_counts = counts;
+        }
+        for (int i = 0; (i < SOLUTION_CLASSES) && (criteria != SEARCH_CRITERIA_DEFAULT); ++i) {
+            unsigned long long found = counts.solution_counts[i];
+            if (criteria == SEARCH_CRITERIA_FIVE_PATTERNS) {
+                consistent = consistent && (found == (((i % 6) + 1 >= 5) ? default_counts.solution_counts[i] : 0));
+            }
+            else if (criteria == SEARCH_CRITERIA_PERFECT) {
+                consistent = consistent && (found == ((i >= 6) ? default_counts.solution_counts[i] : 0));
+            }
+            else {
+                consistent = consistent && (found >= default_counts.solution_counts[i]);
+            }
+        }
+        if (!consistent) {
+            fprintf(stderr, "The search with the %s criteria doesn't agree with the known counts or the default criteria.\n", search_criteria_names[criteria]);
+        }
+
+        printf("{\"benchmark\": \"criteria\", \"criteria\": \"%s\", \"setup_seconds\": %.4f, \"seconds\": %.4f, \"edge_arrangements\": %llu, \"solutions\": [",
+            search_criteria_names[criteria], setup_seconds, seconds, counts.edge_arrangements);
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            printf("%s%llu", (i == 0) ? "" : ", ", counts.solution_counts[i]);
+        }
+        printf("], \"consistent\": %s}\n", consistent ? "true" : "false");
+
+        if ((criteria == SEARCH_CRITERIA_DEFAULT) || (criteria == SEARCH_CRITERIA_PERFECT)) {
+            PerfectPrefixBenchmark(criteria, thread_count);
+        }
+    }
+
+    // The other benchmarks expect the default criteria, and bitsets built for them.
+    SetSearchCriteria(SEARCH_CRITERIA_DEFAULT);
+    FreeCornerBitsets();
+}
+
+
+// A random cube put together from random pieces, the way a binary solution record describes it.
+void RandomDedupeCube(unsigned char cube[CUBE_SURFACES])
+{
+    unsigned int corner_permutation = BenchmarkRandom(40320);
+    unsigned int corner_orientation = BenchmarkRandom(6561);
+    unsigned int edge_permutation = (BenchmarkRandom(7309) * 65536 + BenchmarkRandom(65536)) % 479001600;
+    unsigned int edge_orientation = BenchmarkRandom(4096);
+    unsigned char record[SOLUTION_RECORD_SIZE] = {
+        (unsigned char)corner_permutation, (unsigned char)(corner_permutation >> 8), (unsigned char)corner_orientation, (unsigned char)(corner_orientation >> 8),
+        (unsigned char)edge_permutation, (unsigned char)(edge_permutation >> 8), (unsigned char)(edge_permutation >> 16), (unsigned char)(edge_permutation >> 24),
+        (unsigned char)edge_orientation, (unsigned char)(edge_orientation >> 8)
+    };
+    UnpackSolution(record, cube);
+}
+
+
+// Write every cube symmetric to some random cubes, and the solved cube, which every symmetry leaves as it is, to a text and a
+// binary file in a random order, and dedupe each. There has to be one canonical solution per random cube, standing for all
+// of its symmetric cubes, and CanonicalizeSolution() has to agree with GetSymmetricCubes() on which cube is the representative.
+void DedupeBenchmark()
+{
+    InitCubeSymmetries();
+
+    bool consistent = true;
+    std::vector<std::string> canonical_records;
+    std::vector<std::string> cubes;
+    for (int i = 0; i <= DEDUPE_CUBES; ++i) {
+        unsigned char cube[CUBE_SURFACES];
+        if (i == DEDUPE_CUBES) {
+            for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+                cube[surface] = (unsigned char)surface;
+            }
+        }
+        else {
+            RandomDedupeCube(cube);
+        }
+
+        unsigned char canonical[CUBE_SURFACES];
+        unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES];
+        int represented = CanonicalizeSolution(cube, canonical);
+        int count = GetSymmetricCubes(canonical, orbit);
+        if (count != represented) {
+            fprintf(stderr, "CanonicalizeSolution() says %i cubes are symmetric to random cube %i, GetSymmetricCubes() says %i.\n", represented, i, count);
+            consistent = false;
+        }
+
+        unsigned char record[SOLUTION_RECORD_SIZE];
+        PackSolution(canonical, record);
+        canonical_records.push_back(std::string((const char*)record, SOLUTION_RECORD_SIZE));
+        for (int j = 0; j < count; ++j) {
+            cubes.push_back(std::string((const char*)orbit[j], CUBE_SURFACES));
+        }
+    }
+    std::sort(canonical_records.begin(), canonical_records.end());
+    unsigned long long expected_canonical = std::unique(canonical_records.begin(), canonical_records.end()) - canonical_records.begin();
+    for (size_t i = cubes.size() - 1; i > 0; --i) {
+        std::swap(cubes[i], cubes[BenchmarkRandom((unsigned int)i + 1)]);
+    }
+
+    const char* format_names[2] = { "text", "binary" };
+    const char* filenames[2] = { "Benchmark_Dedupe.txt", "Benchmark_Dedupe.bin" };
+    const char* out_filenames[2] = { "Benchmark_Dedupe_Canonical.txt", "Benchmark_Dedupe_Canonical.bin" };
+    for (int format = 0; format < 2; ++format) {
+        FILE* fp = NULL;
+        if ((fopen_s(&fp, filenames[format], "wb") != 0) || (fp == NULL)) {
+            fprintf(stderr, "Unable to open %s.\n", filenames[format]);
+            return;
+        }
+        if (format == 1) {
+            SolutionFileHeader header;
+            InitSolutionFileHeader(&header, 6, true, SEARCH_CRITERIA_DEFAULT);
+            header.count = cubes.size();
+            WriteSolutionFileHeader(fp, header);
+        }
+        for (size_t i = 0; i < cubes.size(); ++i) {
+            const unsigned char* cube = (const unsigned char*)cubes[i].data();
+            if (format == 0) {
+                char line[CUBE_SURFACES * 3];
+                fwrite(line, 1, FormatSolution(line, cube), fp);
+            }
+            else {
+                unsigned char record[SOLUTION_RECORD_SIZE];
+                PackSolution(cube, record);
+                fwrite(record, SOLUTION_RECORD_SIZE, 1, fp);
+            }
+        }
+        fclose(fp);
+
+        DedupeTotals totals;
+        auto start = std::chrono::steady_clock::now();
+        bool deduped = DedupeSolutionFile(filenames[format], out_filenames[format], DEDUPE_RUN_BENCHMARK_SOLUTIONS, &totals);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t bytes[2] = { 0, 0 };
+        for (int i = 0; i < 2; ++i) {
+            const char* filename = (i == 0) ? filenames[format] : out_filenames[format];
+            MappedFile file;
+            if (MapFile(filename, &file)) {
+                bytes[i] = file.size;
+                UnmapFile(&file);
+            }
+            remove(filename);
+        }
+
+        bool format_consistent = consistent && deduped && (totals.solutions == cubes.size()) && (totals.canonical_solutions == expected_canonical) &&
+                                 (totals.represented_solutions == cubes.size());
+        printf("{\"benchmark\": \"dedupe\", \"format\": \"%s\", \"seconds\": %.4f, \"solutions\": %llu, \"canonical_solutions\": %llu, \"bytes\": %llu, \"canonical_bytes\": %llu, \"ns_per_solution\": %.2f, \"consistent\": %s}\n",
+            format_names[format], seconds, totals.solutions, totals.canonical_solutions, (unsigned long long)bytes[0], (unsigned long long)bytes[1],
+            (totals.solutions > 0) ? seconds * 1e9 / totals.solutions : 0.0, format_consistent ? "true" : "false");
+    }
+}
+
+
+// What the benchmarks ran on, so results from different machines and builds can be told apart.
+void PrintMachine(int thread_count)
+{
+#if defined(_MSC_VER)
+    int compiler_version = _MSC_VER;
+    const char* compiler = "msvc";
+#elif defined(__clang__)
+    int compiler_version = __clang_major__;
+    const char* compiler = "clang";
+#else
+    int compiler_version = __GNUC__;
+    const char* compiler = "gcc";
+#endif
+
+    printf("{\"benchmark\": \"machine\", \"hardware_threads\": %u, \"threads\": %i, \"avx2\": %s, \"avx512\": %s, \"avx512_vbmi\": %s, \"compiler\": \"%s\", \"compiler_version\": %i}\n",
+        std::thread::hardware_concurrency(), thread_count, CpuHasAvx2() ? "true" : "false", CpuHasAvx512() ? "true" : "false",
+        CpuHasAvx512Vbmi() ? "true" : "false", compiler, compiler_version);
+}
+
+
+bool RunBenchmark(const char* name, int thread_count)
+{
+    // Benchmarks in the order "all" runs them.
+    const char* names[] = { "faces", "corners", "join", "connectedness", "subtrees", "record", "bitset", "criteria", "dedupe", "halves", "stream" };
+    const int BENCHMARKS = sizeof(names) / sizeof(names[0]);
+
+    bool all = strcmp(name, "all") == 0;
+    bool found = all;
+    for (int i = 0; i < BENCHMARKS; ++i) {
+        found = found || (strcmp(name, names[i]) == 0);
+    }
+    if (!found) {
+        return false;
+    }
+
+    PrintMachine(thread_count);
+    for (int i = 0; i < BENCHMARKS; ++i) {
+        if (!all && (strcmp(name, names[i]) != 0)) {
+            continue;
+        }
+
+        switch (i) {
+        case 0: FacesBenchmark(thread_count); break;
+        case 1: CornersBenchmark(thread_count); break;
+        case 2: JoinBenchmark(); break;
+        case 3: ConnectednessBenchmark(); break;
+        case 4: SubtreesBenchmark(thread_count); break;
+        case 5: RecordBenchmark(thread_count); break;
+        case 6: BitsetBenchmark(thread_count); break;
+        case 7: CriteriaBenchmark(thread_count); break;
+        case 8: DedupeBenchmark(); break;
+        case 9: HalvesBenchmark(thread_count); break;
+        default: StreamBenchmark(); break;
+        }
+        fflush(stdout);
+    }
+    return true;
+}
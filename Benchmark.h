@@ -0,0 +1,7 @@
+#pragma once
+
+// Benchmarks. Each one prints its results to stdout as one JSON object per line, so results can be
+// collected and compared across builds and machines. The perfect face patterns and corner tables must be loaded first.
+
+// Run the benchmark with the given name. Returns false if there is no such benchmark.
+bool RunBenchmark(const char* name, int thread_count);
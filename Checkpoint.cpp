@@ -0,0 +1,225 @@
+#include "Checkpoint.h"
+#include <stdio.h>
+#include <string.h>
+#include "PlacementOrder.h"
+#include "SearchCriteria.h"
+#include "Symmetry.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+const char* CHECKPOINT_FILE = "Checkpoint.txt";
+const int CHECKPOINT_VERSION = 1;
+
+// How each solution format and symmetry mode is written in a checkpoint, by format and mode.
+const char* solution_format_names[3] = { "text", "binary", "count" };
+const char* symmetry_mode_names[3] = { "none", "reduce", "expand" };
+
+
+void InitSearchTotals(SearchTotals* totals)
+{
+    memset(totals, 0, sizeof(SearchTotals));
+}
+
+
+void AddSearchTotals(SearchTotals* totals, const SearchTotals& more)
+{
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        totals->solution_counts[i] += more.solution_counts[i];
+        totals->all_solution_counts[i] += more.all_solution_counts[i];
+    }
+    totals->edge_arrangements += more.edge_arrangements;
+    totals->even_edge_arrangements += more.even_edge_arrangements;
+    totals->odd_edge_arrangements += more.odd_edge_arrangements;
+}
+
+
+void InitSearchCheckpoint(SearchCheckpoint* checkpoint, int solution_format, int symmetry_mode)
+{
+    checkpoint->solution_format = solution_format;
+    checkpoint->symmetry_mode = symmetry_mode;
+    memcpy(checkpoint->edge_order, default_edge_order, sizeof(checkpoint->edge_order));
+    checkpoint->criteria = SEARCH_CRITERIA_DEFAULT;
+    checkpoint->shard = 1;
+    checkpoint->shard_count = 1;
+    checkpoint->shard_units = 0;
+    checkpoint->total_units = 0;
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        checkpoint->file_sizes[i] = 0;
+    }
+    InitSearchTotals(&checkpoint->totals);
+    checkpoint->finished.clear();
+}
+
+
+bool SyncFile(FILE* fp)
+{
+    if (fflush(fp) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+
+// A checkpoint looks like this:
+//     PerfectScramble checkpoint 1
+//     format text                          (text, binary, or count for a count-only search)
+//     symmetry none
+//     edge_order 0123456789AB
+//     criteria default
+//     shard 2/4 5664 22658                 (the shard, its units and the units in all shards; 1/1 0 0 if not sharded)
+//     files 1234 0 0 ...                   (one size per solution class)
+//     solutions 10 0 0 ...                 (one count per solution class)
+//     all_solutions 10 0 0 ...             (one count per solution class)
+//     edge_arrangements 123456 61728 61728 (all, even, odd)
+//     finished 0_1_2_3_
+//     finished 0_1_2_3-
+//     ...
+// Read the next word in a checkpoint and check that it's the one expected.
+bool ReadCheckpointWord(FILE* fp, const char* expected)
+{
+    char word[32];
+    return (fscanf(fp, " %31s", word) == 1) && (strcmp(word, expected) == 0);
+}
+
+
+bool ReadCheckpoint(const char* filename, SearchCheckpoint* checkpoint)
+{
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, filename, "r");
+    if ((result != 0) || (fp == NULL)) {
+        fprintf(stderr, "Unable to open checkpoint file: %s\n", filename);
+        return false;
+    }
+
+    int version = 0;
+    char format[16];
+    char symmetry[16];
+    bool valid = ReadCheckpointWord(fp, "PerfectScramble") && ReadCheckpointWord(fp, "checkpoint") &&
+                 (fscanf(fp, " %d", &version) == 1) && (version == CHECKPOINT_VERSION) &&
+                 ReadCheckpointWord(fp, "format") && (fscanf(fp, " %15s", format) == 1) &&
+                 ReadCheckpointWord(fp, "symmetry") && (fscanf(fp, " %15s", symmetry) == 1);
+
+    int solution_format = SOLUTION_FORMAT_TEXT;
+    while (valid && (strcmp(format, solution_format_names[solution_format]) != 0)) {
+        valid = ++solution_format <= SOLUTION_FORMAT_COUNT;
+    }
+    int symmetry_mode = SYMMETRY_NONE;
+    while (valid && (strcmp(symmetry, symmetry_mode_names[symmetry_mode]) != 0)) {
+        valid = ++symmetry_mode <= SYMMETRY_EXPAND;
+    }
+
+    if (valid) {
+        InitSearchCheckpoint(checkpoint, solution_format, symmetry_mode);
+        char order[16];
+        char criteria[32];
+        valid = ReadCheckpointWord(fp, "edge_order") && (fscanf(fp, " %15s", order) == 1) &&
+                ParsePlacementOrder(order, CUBE_EDGES, checkpoint->edge_order) &&
+                ReadCheckpointWord(fp, "criteria") && (fscanf(fp, " %31s", criteria) == 1) &&
+                ParseSearchCriteria(criteria, &checkpoint->criteria) &&
+                ReadCheckpointWord(fp, "shard") &&
+                (fscanf(fp, " %d/%d %u %u", &checkpoint->shard, &checkpoint->shard_count, &checkpoint->shard_units, &checkpoint->total_units) == 4) &&
+                (checkpoint->shard >= 1) && (checkpoint->shard <= checkpoint->shard_count) &&
+                ReadCheckpointWord(fp, "files");
+        for (int i = 0; (i < SOLUTION_CLASSES) && valid; ++i) {
+            valid = fscanf(fp, " %llu", &checkpoint->file_sizes[i]) == 1;
+        }
+        valid = valid && ReadCheckpointWord(fp, "solutions");
+        for (int i = 0; (i < SOLUTION_CLASSES) && valid; ++i) {
+            valid = fscanf(fp, " %llu", &checkpoint->totals.solution_counts[i]) == 1;
+        }
+        valid = valid && ReadCheckpointWord(fp, "all_solutions");
+        for (int i = 0; (i < SOLUTION_CLASSES) && valid; ++i) {
+            valid = fscanf(fp, " %llu", &checkpoint->totals.all_solution_counts[i]) == 1;
+        }
+        valid = valid && ReadCheckpointWord(fp, "edge_arrangements") &&
+                (fscanf(fp, " %llu %llu %llu", &checkpoint->totals.edge_arrangements,
+                        &checkpoint->totals.even_edge_arrangements, &checkpoint->totals.odd_edge_arrangements) == 3);
+    }
+
+    // The rest is one line per finished unit.
+    char word[32];
+    while (valid && (fscanf(fp, " %31s", word) == 1)) {
+        valid = (strcmp(word, "finished") == 0) && (fscanf(fp, " %31s", word) == 1) && (strlen(word) == CHECKPOINT_PREFIX_LENGTH);
+        if (valid) {
+            checkpoint->finished.insert(word);
+        }
+    }
+    valid = valid && !ferror(fp);
+
+    fclose(fp);
+
+    if (!valid) {
+        fprintf(stderr, "%s is not a version %i checkpoint file.\n", filename, CHECKPOINT_VERSION);
+    }
+    return valid;
+}
+
+
+bool WriteCheckpoint(const char* filename, const SearchCheckpoint& checkpoint)
+{
+    char temp_filename[256];
+    sprintf_s(temp_filename, "%s.tmp", filename);
+
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, temp_filename, "w");
+    if ((result != 0) || (fp == NULL)) {
+        fprintf(stderr, "Unable to open checkpoint file: %s\n", temp_filename);
+        return false;
+    }
+
+    fprintf(fp, "PerfectScramble checkpoint %i\n", CHECKPOINT_VERSION);
+    fprintf(fp, "format %s\n", solution_format_names[checkpoint.solution_format]);
+    fprintf(fp, "symmetry %s\n", symmetry_mode_names[checkpoint.symmetry_mode]);
+    char order[CUBE_EDGES + 1];
+    FormatPlacementOrder(checkpoint.edge_order, CUBE_EDGES, order);
+    fprintf(fp, "edge_order %s\n", order);
+    fprintf(fp, "criteria %s\n", search_criteria_names[checkpoint.criteria]);
+    fprintf(fp, "shard %i/%i %u %u\n", checkpoint.shard, checkpoint.shard_count, checkpoint.shard_units, checkpoint.total_units);
+    fprintf(fp, "files");
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        fprintf(fp, " %llu", checkpoint.file_sizes[i]);
+    }
+    fprintf(fp, "\nsolutions");
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        fprintf(fp, " %llu", checkpoint.totals.solution_counts[i]);
+    }
+    fprintf(fp, "\nall_solutions");
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        fprintf(fp, " %llu", checkpoint.totals.all_solution_counts[i]);
+    }
+    fprintf(fp, "\nedge_arrangements %llu %llu %llu\n", checkpoint.totals.edge_arrangements,
+            checkpoint.totals.even_edge_arrangements, checkpoint.totals.odd_edge_arrangements);
+    for (std::set<std::string>::const_iterator it = checkpoint.finished.begin(); it != checkpoint.finished.end(); ++it) {
+        fprintf(fp, "finished %s\n", it->c_str());
+    }
+
+    bool written = !ferror(fp) && SyncFile(fp);
+    fclose(fp);
+    if (!written) {
+        fprintf(stderr, "Writing %s failed.\n", temp_filename);
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows, and removing the old one first would leave no checkpoint at all
+    // if the process died in between. MoveFileEx() replaces it in one step.
+    if (!MoveFileExA(temp_filename, filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+#else
+    if (rename(temp_filename, filename) != 0) {
+#endif
+        fprintf(stderr, "Unable to rename %s to %s.\n", temp_filename, filename);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include "SolutionFormat.h"
+
+// The edge search is checkpointed in units: one unit is everything below a prefix of CHECKPOINT_DEPTH placed edges,
+// written the same way as the progress string, e.g. "3_0-A_8-". A unit's solutions are only written out once the whole
+// unit is finished, so a checkpoint can say exactly which units are in the solution files.
+constexpr auto CHECKPOINT_DEPTH = 4;
+constexpr auto CHECKPOINT_PREFIX_LENGTH = 2 * CHECKPOINT_DEPTH;
+
+// The checkpoint is rewritten this often while searching, and once more when the search is done.
+constexpr auto CHECKPOINT_INTERVAL_SECONDS = 60;
+
+extern const char* CHECKPOINT_FILE;
+
+// Totals for a set of finished units.
+typedef struct {
+    unsigned long long solution_counts[SOLUTION_CLASSES];     // Solutions written to each solution file.
+    unsigned long long all_solution_counts[SOLUTION_CLASSES]; // Solutions found, counting the symmetric ones a reduced search doesn't write.
+    unsigned long long edge_arrangements;
+    unsigned long long even_edge_arrangements;
+    unsigned long long odd_edge_arrangements;
+} SearchTotals;
+
+// Everything needed to pick up a search where it left off.
+typedef struct {
+    int solution_format;                             // SOLUTION_FORMAT_TEXT, SOLUTION_FORMAT_BINARY or SOLUTION_FORMAT_COUNT.
+    int symmetry_mode;                               // SYMMETRY_NONE, SYMMETRY_REDUCE or SYMMETRY_EXPAND.
+    unsigned char edge_order[CUBE_EDGES];            // The edge order the units' prefixes follow.
+    int criteria;                                    // The SEARCH_CRITERIA_* policy the search runs with.
+    int shard;                                       // This search is shard number shard, counting from 1, of shard_count.
+    int shard_count;                                 // 1 of 1 if the search isn't sharded.
+    unsigned int shard_units;                        // The units in this shard, and in all the shards together. 0 if the
+    unsigned int total_units;                        // search isn't sharded.
+    unsigned long long file_sizes[SOLUTION_CLASSES]; // The size of each solution file: bytes on disk for text files, solutions for binary files.
+    SearchTotals totals;                             // Totals for the finished units.
+    std::set<std::string> finished;                  // The prefixes of the finished units.
+} SearchCheckpoint;
+
+void InitSearchTotals(SearchTotals* totals);
+void AddSearchTotals(SearchTotals* totals, const SearchTotals& more);
+// Starts out with the default edge order and criteria.
+void InitSearchCheckpoint(SearchCheckpoint* checkpoint, int solution_format, int symmetry_mode);
+
+// The checkpoint is a small text file. It is written to a temporary file first and then renamed over the old one,
+// so there is always a complete checkpoint on disk.
+bool ReadCheckpoint(const char* filename, SearchCheckpoint* checkpoint);
+bool WriteCheckpoint(const char* filename, const SearchCheckpoint& checkpoint);
+
+// Make sure everything written to a file so far is on disk, not just handed to the OS.
+bool SyncFile(FILE* fp);
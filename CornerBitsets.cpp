@@ -0,0 +1,336 @@
+#include "CornerBitsets.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "CpuFeatures.h"
+
+// Only edge face codes that match some corner face code get bitsets. edge_code_slots[] says which bitset they use, or -1.
+int edge_code_slots[EDGE_FACE_CODES];
+int edge_code_slot_count = 0;
+
+// corner_bitsets[((swap_parity * CUBE_FACES) + face) * edge_code_slot_count + slot] is CORNER_BITSET_WORDS long.
+unsigned long long* corner_bitsets = NULL;
+// Whether each of those has any bits set. Empty bitsets are left out so the search can give up early.
+std::vector<bool> corner_bitset_used;
+
+
+const unsigned long long* GetCornerBitset(int swap_parity, int face, int edge_face_code)
+{
+    int slot = edge_code_slots[edge_face_code];
+    if (slot < 0) {
+        return NULL;
+    }
+
+    size_t bitset = ((size_t)swap_parity * CUBE_FACES + face) * edge_code_slot_count + slot;
+    return corner_bitset_used[bitset] ? &corner_bitsets[bitset * CORNER_BITSET_WORDS] : NULL;
+}
+
+
+// Fill out the bitsets for one swap parity and face.
+void BuildFaceBitsets(int swap_parity, int face)
+{
+    const CornerArrangementTable* table = (swap_parity == 0) ? &ep_corner_table : &op_corner_table;
+
+    // The arrangements with each corner face code on this face.
+    std::vector<std::vector<int>> arrangements(CORNER_FACE_CODES);
+    for (int i = 0; i < table->count; ++i) {
+        arrangements[table->keys[i].faceIds[face]].push_back(i);
+    }
+
+    for (int edge_code = 0; edge_code < EDGE_FACE_CODES; ++edge_code) {
+        int slot = edge_code_slots[edge_code];
+        if (slot < 0) {
+            continue;
+        }
+
+        size_t bitset = ((size_t)swap_parity * CUBE_FACES + face) * edge_code_slot_count + slot;
+        unsigned long long* words = &corner_bitsets[bitset * CORNER_BITSET_WORDS];
+        bool used = false;
+        for (int corner_code = 0; corner_code < CORNER_FACE_CODES; ++corner_code) {
+            if ((corner_face_matches[edge_code][corner_code / 64] & (1ULL << (corner_code % 64))) == 0) {
+                continue;
+            }
+            for (size_t i = 0; i < arrangements[corner_code].size(); ++i) {
+                int index = arrangements[corner_code][i];
+                words[index / 64] |= 1ULL << (index % 64);
+                used = true;
+            }
+        }
+        corner_bitset_used[bitset] = used;
+    }
+}
+
+
+//
+// The ANDs, for each set of instructions. Dense ANDs take two whole bitsets, sparse ANDs take the words of one bitset that
+// aren't 0 and look up the same words in the other.
+//
+
+typedef void (*DenseAnd)(const unsigned long long* a, const unsigned long long* b, CornerBitset* result);
+typedef void (*SparseAnd)(const CornerBitset& a, const unsigned long long* b, CornerBitset* result);
+
+
+void DenseAndScalar(const unsigned long long* a, const unsigned long long* b, CornerBitset* result)
+{
+    int count = 0;
+    for (int i = 0; i < CORNER_BITSET_WORDS; ++i) {
+        unsigned long long word = a[i] & b[i];
+        result->indexes[count] = i;
+        result->words[count] = word;
+        count += (word != 0) ? 1 : 0;
+    }
+    result->count = count;
+}
+
+
+void SparseAndScalar(const CornerBitset& a, const unsigned long long* b, CornerBitset* result)
+{
+    int count = 0;
+    for (int i = 0; i < a.count; ++i) {
+        unsigned long long word = a.words[i] & b[a.indexes[i]];
+        result->indexes[count] = a.indexes[i];
+        result->words[count] = word;
+        count += (word != 0) ? 1 : 0;
+    }
+    result->count = count;
+}
+
+
+TARGET_AVX2 void DenseAndAvx2(const unsigned long long* a, const unsigned long long* b, CornerBitset* result)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= CORNER_BITSET_WORDS; i += 4) {
+        __m256i word = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        int zero = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(word, _mm256_setzero_si256())));
+        if (zero == 0xF) {
+            continue;
+        }
+
+        unsigned long long words[4];
+        _mm256_storeu_si256((__m256i*)words, word);
+        for (int lane = 0; lane < 4; ++lane) {
+            result->indexes[count] = i + lane;
+            result->words[count] = words[lane];
+            count += (words[lane] != 0) ? 1 : 0;
+        }
+    }
+    for (; i < CORNER_BITSET_WORDS; ++i) {
+        unsigned long long word = a[i] & b[i];
+        result->indexes[count] = i;
+        result->words[count] = word;
+        count += (word != 0) ? 1 : 0;
+    }
+    result->count = count;
+}
+
+
+TARGET_AVX2 void SparseAndAvx2(const CornerBitset& a, const unsigned long long* b, CornerBitset* result)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= a.count; i += 4) {
+        __m128i index = _mm_loadu_si128((const __m128i*)(a.indexes + i));
+        __m256i other = _mm256_i32gather_epi64((const long long*)b, index, 8);
+        __m256i word = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(a.words + i)), other);
+
+        unsigned long long words[4];
+        _mm256_storeu_si256((__m256i*)words, word);
+        for (int lane = 0; lane < 4; ++lane) {
+            result->indexes[count] = a.indexes[i + lane];
+            result->words[count] = words[lane];
+            count += (words[lane] != 0) ? 1 : 0;
+        }
+    }
+    for (; i < a.count; ++i) {
+        unsigned long long word = a.words[i] & b[a.indexes[i]];
+        result->indexes[count] = a.indexes[i];
+        result->words[count] = word;
+        count += (word != 0) ? 1 : 0;
+    }
+    result->count = count;
+}
+
+
+TARGET_AVX512 void DenseAndAvx512(const unsigned long long* a, const unsigned long long* b, CornerBitset* result)
+{
+    const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= CORNER_BITSET_WORDS; i += 8) {
+        __m512i word = _mm512_and_si512(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i));
+        __mmask8 nonzero = _mm512_test_epi64_mask(word, word);
+        if (nonzero == 0) {
+            continue;
+        }
+
+        _mm512_mask_compressstoreu_epi64(result->words + count, nonzero, word);
+        _mm512_mask_compressstoreu_epi32(result->indexes + count, (__mmask16)nonzero, _mm512_add_epi32(_mm512_set1_epi32(i), lanes));
+        count += CountBits((unsigned int)nonzero);
+    }
+    for (; i < CORNER_BITSET_WORDS; ++i) {
+        unsigned long long word = a[i] & b[i];
+        result->indexes[count] = i;
+        result->words[count] = word;
+        count += (word != 0) ? 1 : 0;
+    }
+    result->count = count;
+}
+
+
+TARGET_AVX512 void SparseAndAvx512(const CornerBitset& a, const unsigned long long* b, CornerBitset* result)
+{
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= a.count; i += 8) {
+        __m256i index = _mm256_loadu_si256((const __m256i*)(a.indexes + i));
+        __m512i other = _mm512_i32gather_epi64(index, (const void*)b, 8);
+        __m512i word = _mm512_and_si512(_mm512_loadu_si512(a.words + i), other);
+        __mmask8 nonzero = _mm512_test_epi64_mask(word, word);
+
+        _mm512_mask_compressstoreu_epi64(result->words + count, nonzero, word);
+        _mm512_mask_compressstoreu_epi32(result->indexes + count, (__mmask16)nonzero, _mm512_castsi256_si512(index));
+        count += CountBits((unsigned int)nonzero);
+    }
+    for (; i < a.count; ++i) {
+        unsigned long long word = a.words[i] & b[a.indexes[i]];
+        result->indexes[count] = a.indexes[i];
+        result->words[count] = word;
+        count += (word != 0) ? 1 : 0;
+    }
+    result->count = count;
+}
+
+
+typedef struct {
+    const char* name;
+    DenseAnd dense_and;
+    SparseAnd sparse_and;
+} CornerBitsetInstructions;
+
+const CornerBitsetInstructions instruction_sets[3] = { { "scalar", DenseAndScalar, SparseAndScalar },
+                                                       { "avx2", DenseAndAvx2, SparseAndAvx2 },
+                                                       { "avx512", DenseAndAvx512, SparseAndAvx512 } };
+const CornerBitsetInstructions* instructions = &instruction_sets[0];
+
+
+// Can this CPU, and the OS, run the instructions in instruction_sets[set]?
+bool HasInstructions(int set)
+{
+    return (set == 0) || ((set == 1) ? CpuHasAvx2() : CpuHasAvx512());
+}
+
+
+const char* GetCornerBitsetInstructions()
+{
+    return instructions->name;
+}
+
+
+bool SetCornerBitsetInstructions(const char* name)
+{
+    for (int set = 0; set < 3; ++set) {
+        if ((strcmp(name, instruction_sets[set].name) == 0) && HasInstructions(set)) {
+            instructions = &instruction_sets[set];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool BuildCornerBitsets(int thread_count)
+{
+    if (corner_bitsets != NULL) {
+        return true;
+    }
+
+    edge_code_slot_count = 0;
+    for (int edge_code = 0; edge_code < EDGE_FACE_CODES; ++edge_code) {
+        bool matches = false;
+        for (int word = 0; word < CORNER_FACE_MATCH_WORDS; ++word) {
+            matches = matches || (corner_face_matches[edge_code][word] != 0);
+        }
+        edge_code_slots[edge_code] = matches ? edge_code_slot_count++ : -1;
+    }
+
+    size_t bitset_count = 2 * CUBE_FACES * (size_t)edge_code_slot_count;
+    corner_bitsets = (unsigned long long*)calloc(bitset_count * CORNER_BITSET_WORDS, sizeof(unsigned long long));
+    if (corner_bitsets == NULL) {
+        fprintf(stderr, "Out of memory for corner bitsets (%zu MB).\n", bitset_count * CORNER_BITSET_WORDS * sizeof(unsigned long long) >> 20);
+        return false;
+    }
+    corner_bitset_used.assign(bitset_count, false);
+
+    // Each thread takes every thread_count'th face of each parity.
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([=]() {
+            for (int job = i; job < 2 * CUBE_FACES; job += thread_count) {
+                BuildFaceBitsets(job / CUBE_FACES, job % CUBE_FACES);
+            }
+        });
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    for (int set = 2; set >= 0; --set) {
+        if (HasInstructions(set)) {
+            instructions = &instruction_sets[set];
+            break;
+        }
+    }
+    return true;
+}
+
+
+void FreeCornerBitsets()
+{
+    free(corner_bitsets);
+    corner_bitsets = NULL;
+    corner_bitset_used.clear();
+    edge_code_slot_count = 0;
+}
+
+
+bool AndCornerBitsets(CornerBitsetState* state, int rank, int face, int edge_face_code)
+{
+    bool any = false;
+    for (int swap_parity = 0; swap_parity < 2; ++swap_parity) {
+        const unsigned long long* bitset = GetCornerBitset(swap_parity, face, edge_face_code);
+
+        if (rank == 0) {
+            state->first_face[swap_parity] = bitset;
+            any = any || (bitset != NULL);
+            continue;
+        }
+
+        CornerBitset* result = &state->faces[rank - 1][swap_parity];
+        if (rank == 1) {
+            if ((bitset == NULL) || (state->first_face[swap_parity] == NULL)) {
+                result->count = 0;
+            }
+            else {
+                instructions->dense_and(state->first_face[swap_parity], bitset, result);
+            }
+        }
+        else {
+            const CornerBitset* left = &state->faces[rank - 2][swap_parity];
+            if ((bitset == NULL) || (left->count == 0)) {
+                result->count = 0;
+            }
+            else {
+                instructions->sparse_and(*left, bitset, result);
+            }
+        }
+        any = any || (result->count != 0);
+    }
+
+    return any;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ScrambleSearcher.h"
+
+// The bitset join is an alternative to GetCornerArrangementsIndex(). For each swap parity, face and edge face code there is a
+// bitset with a bit for each corner arrangement that makes a perfect face with it. As the edge search completes faces, it
+// ANDs those bitsets together and carries what is left down to the last edge, which takes whatever bits are still set.
+// The bitsets take about 350 MB, so they are only built when the bitset join is used.
+
+// The words in a bitset over either corner table.
+constexpr auto CORNER_BITSET_WORDS = (EP_CORNER_ARRANGEMENT_COUNT + 63) / 64;
+
+// The words of a bitset that aren't 0, in order.
+typedef struct {
+    int count;
+    int indexes[CORNER_BITSET_WORDS];
+    unsigned long long words[CORNER_BITSET_WORDS];
+} CornerBitset;
+
+// What an edge search thread has left after each completed face. Faces are counted in the order the edge search completes
+// them (face_completion_order[]), which for the default edge order is face 0 first.
+typedef struct CornerBitsetState {
+    const unsigned long long* first_face[2]; // The first face's bitset, straight from the table. NULL if nothing is left.
+    CornerBitset faces[3][2];                // What's left after the second, third and fourth faces, by swap parity.
+} CornerBitsetState;
+
+// Build the bitsets. Needs the corner tables and corner_face_matches[]. Returns false if there isn't enough memory.
+bool BuildCornerBitsets(int thread_count);
+// Free the bitsets, e.g. to time building them again. No search may be using them.
+void FreeCornerBitsets();
+
+// The bitset for a swap parity, face and edge face code. NULL if no corner arrangement makes a perfect face with it.
+const unsigned long long* GetCornerBitset(int swap_parity, int face, int edge_face_code);
+
+// Keep what's left after the face completed rank'th (from 0) given the edges' contribution to it, for both swap parities. The
+// faces completed before it must already be done. Returns false if there is nothing left for either parity.
+bool AndCornerBitsets(CornerBitsetState* state, int rank, int face, int edge_face_code);
+
+// The instructions the ANDs use: "avx512", "avx2" or "scalar". The best the CPU has is picked when the bitsets are built.
+const char* GetCornerBitsetInstructions();
+// Use other instructions, e.g. to compare them. Returns false if the CPU doesn't have them.
+bool SetCornerBitsetInstructions(const char* name);
@@ -0,0 +1,68 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+
+// CPUID leaf 7 and which register state the OS saves. 0 for both if the OS can't say (no OSXSAVE).
+void GetCpuFeatures(int leaf7[4], unsigned long long* saved)
+{
+    int info[4];
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0) {
+        leaf7[0] = leaf7[1] = leaf7[2] = leaf7[3] = 0;
+        *saved = 0;
+        return;
+    }
+    *saved = _xgetbv(0);
+    __cpuidex(leaf7, 7, 0);
+}
+
+
+bool CpuHasAvx2()
+{
+    int leaf7[4];
+    unsigned long long saved;
+    GetCpuFeatures(leaf7, &saved);
+    return ((saved & 0x6) == 0x6) && ((leaf7[1] & (1 << 5)) != 0);
+}
+
+
+bool CpuHasAvx512()
+{
+    int leaf7[4];
+    unsigned long long saved;
+    GetCpuFeatures(leaf7, &saved);
+    return ((saved & 0xE6) == 0xE6) && ((leaf7[1] & (1 << 16)) != 0);
+}
+
+
+bool CpuHasAvx512Vbmi()
+{
+    int leaf7[4];
+    unsigned long long saved;
+    GetCpuFeatures(leaf7, &saved);
+    return CpuHasAvx512() && ((leaf7[1] & (1 << 30)) != 0) && ((leaf7[2] & (1 << 1)) != 0);
+}
+
+#else
+
+bool CpuHasAvx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}
+
+
+bool CpuHasAvx512()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") != 0;
+}
+
+
+bool CpuHasAvx512Vbmi()
+{
+    __builtin_cpu_init();
+    return (__builtin_cpu_supports("avx512f") != 0) && (__builtin_cpu_supports("avx512bw") != 0) && (__builtin_cpu_supports("avx512vbmi") != 0);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+// Which vector instructions this CPU, and the OS, can run. Code that uses them is compiled for them with TARGET_AVX2 or
+// TARGET_AVX512 and only called when these say so, so the rest of the program still runs on older CPUs.
+bool CpuHasAvx2();
+bool CpuHasAvx512();     // AVX-512 F.
+bool CpuHasAvx512Vbmi(); // AVX-512 F, BW and VBMI, for byte shuffles across a whole register.
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define TARGET_AVX512_VBMI
+#define CountBits(x) __popcnt(x)
+#define CountBits64(x) __popcnt64(x)
+#else
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#define TARGET_AVX512_VBMI __attribute__((target("avx512f,avx512bw,avx512vbmi")))
+#define CountBits(x) __builtin_popcount(x)
+#define CountBits64(x) __builtin_popcountll(x)
+#endif
@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+bool MapFile(const char* filename, MappedFile* file)
+{
+    file->data = NULL;
+    file->size = 0;
+
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || (size.QuadPart == 0)) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    // The view keeps the file open, so the handles can be closed right away.
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == NULL) {
+        return false;
+    }
+
+    file->data = (const unsigned char*)view;
+    file->size = (size_t)size.QuadPart;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0)) {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    file->data = (const unsigned char*)view;
+    file->size = (size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+
+void UnmapFile(MappedFile* file)
+{
+    if (file->data == NULL) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(file->data);
+#else
+    munmap((void*)file->data, file->size);
+#endif
+
+    file->data = NULL;
+    file->size = 0;
+}
+
+
+// FNV-1a, taken a word at a time instead of a byte at a time so it keeps up with reading the file.
+unsigned long long Checksum(const void* data, size_t size, unsigned long long hash)
+{
+    const unsigned long long PRIME = 1099511628211ull;
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * PRIME;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * PRIME;
+    }
+
+    return hash;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// A whole file mapped read-only into memory. Processes that map the same file share its pages.
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+} MappedFile;
+
+// Map a file. Returns false if it doesn't exist or can't be mapped.
+bool MapFile(const char* filename, MappedFile* file);
+void UnmapFile(MappedFile* file);
+
+// A 64-bit checksum for cache files. Pass the previous result as hash to checksum data in pieces.
+constexpr unsigned long long CHECKSUM_SEED = 14695981039346656037ull;
+unsigned long long Checksum(const void* data, size_t size, unsigned long long hash = CHECKSUM_SEED);
@@ -0,0 +1,492 @@
+#include "PlacementOrder.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "ScrambleSearcher.h"
+
+unsigned char edge_order[CUBE_EDGES];
+unsigned char corner_order[CUBE_CORNERS];
+const unsigned char default_edge_order[CUBE_EDGES] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+const unsigned char default_corner_order[CUBE_CORNERS] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+unsigned char edge_positions[CUBE_EDGES][2];
+unsigned char face_completion_order[CUBE_FACES];
+int edge_face_id_checks_start[CUBE_EDGES];
+int edge_face_id_checks_end[CUBE_EDGES];
+
+unsigned char corner_positions[CUBE_CORNERS][3];
+unsigned char corner_count_checks[CORNER_COUNT_CHECKS][3];
+unsigned char corner_count_checks_start[CUBE_CORNERS];
+unsigned char corner_count_checks_end[CUBE_CORNERS];
+
+// How positions are written in an order. The edge ids match the progress string's.
+const char position_ids[] = "0123456789AB";
+
+// Where a surface is on its face: 0 1 2 / 3 4 5 / 6 7 8.
+// The edge surfaces on a face that touch at a diagonal, and the corner surfaces on a face.
+const int face_diagonals[4][2] = { { 1, 3 }, { 1, 5 }, { 3, 7 }, { 5, 7 } };
+const int face_corners[4] = { 0, 2, 6, 8 };
+const int face_edges[4] = { 1, 3, 5, 7 };
+
+// An order has to have every position exactly once.
+bool IsPlacementOrder(const unsigned char* order, int count)
+{
+    unsigned int seen = 0;
+    for (int step = 0; step < count; ++step) {
+        if ((order[step] >= count) || ((seen >> order[step]) & 1)) {
+            return false;
+        }
+        seen |= 1u << order[step];
+    }
+    return true;
+}
+
+
+// The position that has a surface, from a table of positions.
+int FindPosition(const unsigned char* positions, int count, int size, int surface)
+{
+    for (int position = 0; position < count; ++position) {
+        for (int i = 0; i < size; ++i) {
+            if (positions[position * size + i] == surface) {
+                return position;
+            }
+        }
+    }
+    return -1;
+}
+
+
+bool SetEdgeOrder(const unsigned char order[CUBE_EDGES])
+{
+    if (!IsPlacementOrder(order, CUBE_EDGES)) {
+        return false;
+    }
+
+    int steps[CUBE_EDGES]; // The step each position is filled at.
+    for (int step = 0; step < CUBE_EDGES; ++step) {
+        edge_order[step] = order[step];
+        edge_positions[step][0] = edges[order[step]][0];
+        edge_positions[step][1] = edges[order[step]][1];
+        steps[order[step]] = step;
+    }
+
+    // A face is complete once all four of its edges are filled. Faces completed at the same step go in face order.
+    int face_steps[CUBE_FACES];
+    for (int face = 0; face < CUBE_FACES; ++face) {
+        face_steps[face] = 0;
+        for (int i = 0; i < 4; ++i) {
+            face_steps[face] = std::max(face_steps[face], steps[FindPosition(&edges[0][0], CUBE_EDGES, 2, face * 9 + face_edges[i])]);
+        }
+    }
+    for (int step = 0, rank = 0; step < CUBE_EDGES; ++step) {
+        edge_face_id_checks_start[step] = -1;
+        edge_face_id_checks_end[step] = -2;
+        for (int face = 0; face < CUBE_FACES; ++face) {
+            if (face_steps[face] == step) {
+                if (edge_face_id_checks_start[step] < 0) {
+                    edge_face_id_checks_start[step] = rank;
+                }
+                edge_face_id_checks_end[step] = rank;
+                face_completion_order[rank++] = (unsigned char)face;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+bool SetCornerOrder(const unsigned char order[CUBE_CORNERS])
+{
+    if (!IsPlacementOrder(order, CUBE_CORNERS)) {
+        return false;
+    }
+
+    int steps[CUBE_CORNERS];
+    for (int step = 0; step < CUBE_CORNERS; ++step) {
+        corner_order[step] = order[step];
+        for (int i = 0; i < 3; ++i) {
+            corner_positions[step][i] = corners[order[step]][i];
+        }
+        steps[order[step]] = step;
+    }
+
+    // Each set of three of a face's corners is checked once all three are filled.
+    int check_steps[CORNER_COUNT_CHECKS];
+    int count = 0;
+    for (int face = 0; face < CUBE_FACES; ++face) {
+        for (int left_out = 3; left_out >= 0; --left_out, ++count) {
+            check_steps[count] = 0;
+            for (int i = 0, j = 0; i < 4; ++i) {
+                if (i != left_out) {
+                    int surface = face * 9 + face_corners[i];
+                    corner_count_checks[count][j++] = (unsigned char)surface;
+                    check_steps[count] = std::max(check_steps[count], steps[FindPosition(&corners[0][0], CUBE_CORNERS, 3, surface)]);
+                }
+            }
+        }
+    }
+    for (int i = 1; i < CORNER_COUNT_CHECKS; ++i) {
+        for (int j = i; (j > 0) && (check_steps[j - 1] > check_steps[j]); --j) {
+            std::swap(check_steps[j - 1], check_steps[j]);
+            for (int k = 0; k < 3; ++k) {
+                std::swap(corner_count_checks[j - 1][k], corner_count_checks[j][k]);
+            }
+        }
+    }
+    for (int step = 0, i = 0; step < CUBE_CORNERS; ++step) {
+        corner_count_checks_start[step] = (unsigned char)i;
+        while ((i < CORNER_COUNT_CHECKS) && (check_steps[i] == step)) {
+            ++i;
+        }
+        corner_count_checks_end[step] = (unsigned char)i;
+    }
+
+    return true;
+}
+
+
+bool EdgeOrderCompletesFacesInOrder()
+{
+    for (int rank = 0; rank < CUBE_FACES; ++rank) {
+        if (face_completion_order[rank] != rank) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool ParsePlacementOrder(const char* text, int count, unsigned char* order)
+{
+    if ((int)strlen(text) != count) {
+        return false;
+    }
+    for (int step = 0; step < count; ++step) {
+        const char* id = strchr(position_ids, text[step]);
+        if ((id == NULL) || (text[step] == '\0')) {
+            return false;
+        }
+        order[step] = (unsigned char)(id - position_ids);
+    }
+    return IsPlacementOrder(order, count);
+}
+
+
+void FormatPlacementOrder(const unsigned char* order, int count, char* text)
+{
+    for (int step = 0; step < count; ++step) {
+        text[step] = position_ids[order[step]];
+    }
+    text[count] = '\0';
+}
+
+
+//
+// Picking an edge order.
+//
+
+// The number of random partial arrangements kept at each step.
+const int ORDER_SAMPLES = 4000;
+// Positions that leave within this fraction of the fewest nodes count as tied.
+const double ORDER_TIE = 0.01;
+// Give up improving an order by swapping steps after this many passes over every pair of steps.
+const int ORDER_SWAP_PASSES = 4;
+
+// A partial edge arrangement that passes the checks so far.
+typedef struct {
+    unsigned char cube[CUBE_SURFACES];
+    unsigned short used_pieces;
+    unsigned char flip_parity;
+    int ep_corner_arrangements_index; // Where the corner join has got to in each corner table, as in the search.
+    int op_corner_arrangements_index;
+} OrderSample;
+
+// A simple, repeatable random number generator, so the same order is picked every time.
+unsigned long long order_random_state = 12345;
+unsigned int OrderRandom(unsigned int limit)
+{
+    order_random_state = order_random_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)((order_random_state >> 33) % limit);
+}
+
+
+// The edge surfaces that touch a surface at a diagonal, and whether each surface has been filled.
+int DiagonalPartners(int surface, int partners[2])
+{
+    int count = 0;
+    int place = surface % 9;
+    for (int i = 0; i < 4; ++i) {
+        if (face_diagonals[i][0] == place) {
+            partners[count++] = surface - place + face_diagonals[i][1];
+        }
+        else if (face_diagonals[i][1] == place) {
+            partners[count++] = surface - place + face_diagonals[i][0];
+        }
+    }
+    return count;
+}
+
+
+// The faces that are complete once the positions in filled are, as a bitmask.
+unsigned int CompletedFaces(unsigned int filled)
+{
+    unsigned int completed = 0;
+    for (int face = 0; face < CUBE_FACES; ++face) {
+        bool complete = true;
+        for (int i = 0; i < 4; ++i) {
+            complete = complete && ((filled >> FindPosition(&edges[0][0], CUBE_EDGES, 2, face * 9 + face_edges[i])) & 1);
+        }
+        completed |= complete ? (1u << face) : 0;
+    }
+    return completed;
+}
+
+
+// The edge face code of a face whose edge positions are all filled in a sample.
+unsigned short SampleEdgeFaceCode(const OrderSample& sample, int face)
+{
+    unsigned short code = 0;
+    for (int i = 0; i < 4; ++i) {
+        code = (unsigned short)(code * CUBE_COLORS + sample.cube[face * 9 + face_edges[i]] / 9);
+    }
+    return code;
+}
+
+
+// Join the corners to a sample once a step has completed new_faces, leaving completed complete, the way the search does.
+// While the completed faces are 0 through N, that is the walk join over all of them, carried on from where the sample's last
+// join got to. A face completed ahead of an earlier one can't be walked yet, so it's only checked against the corner face
+// codes on its own until the faces before it are complete. Returns false if no corner arrangement fits.
+bool JoinSampleFaces(OrderSample* sample, unsigned int completed, unsigned int new_faces)
+{
+    if (new_faces == 0) {
+        return true;
+    }
+
+    if ((completed & (completed + 1)) == 0) {
+        unsigned short edge_face_codes[CUBE_FACES];
+        int face_id_count = 0;
+        while ((completed >> face_id_count) & 1) {
+            edge_face_codes[face_id_count] = SampleEdgeFaceCode(*sample, face_id_count);
+            ++face_id_count;
+        }
+        sample->ep_corner_arrangements_index = GetCornerArrangementsIndex(sample->ep_corner_arrangements_index, &ep_corner_table, edge_face_codes, face_id_count, NULL);
+        sample->op_corner_arrangements_index = GetCornerArrangementsIndex(sample->op_corner_arrangements_index, &op_corner_table, edge_face_codes, face_id_count, NULL);
+        return (sample->ep_corner_arrangements_index != -1) || (sample->op_corner_arrangements_index != -1);
+    }
+
+    for (int face = 0; face < CUBE_FACES; ++face) {
+        if (!((new_faces >> face) & 1)) {
+            continue;
+        }
+        const unsigned long long* matches = corner_face_matches[SampleEdgeFaceCode(*sample, face)];
+        bool any = false;
+        for (int word = 0; word < CORNER_FACE_MATCH_WORDS; ++word) {
+            any = any || (matches[word] != 0);
+        }
+        if (!any) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Fill a position in each sample every way that passes the center color and diagonal checks and the corner join on any faces
+// it completes, the last position only the way flip parity allows. Returns the average number of ways per sample. If next
+// isn't NULL, the new samples are added to it.
+double SampleEdgeStep(const std::vector<OrderSample>& samples, unsigned int filled, int position, bool last, std::vector<OrderSample>* next)
+{
+    int partners[2][2];
+    int partner_counts[2];
+    for (int side = 0; side < 2; ++side) {
+        partner_counts[side] = 0;
+        int found[2];
+        int count = DiagonalPartners(edges[position][side], found);
+        for (int i = 0; i < count; ++i) {
+            if ((filled >> FindPosition(&edges[0][0], CUBE_EDGES, 2, found[i])) & 1) {
+                partners[side][partner_counts[side]++] = found[i];
+            }
+        }
+    }
+
+    unsigned int completed = CompletedFaces(filled | (1u << position));
+    unsigned int new_faces = completed & ~CompletedFaces(filled);
+
+    unsigned long long children = 0;
+    for (size_t s = 0; s < samples.size(); ++s) {
+        const OrderSample& sample = samples[s];
+        for (int piece = 0; piece < CUBE_EDGES; ++piece) {
+            if ((sample.used_pieces >> piece) & 1) {
+                continue;
+            }
+            for (int ori = 0; ori < 2; ++ori) {
+                if (last && (ori != sample.flip_parity)) {
+                    continue;
+                }
+
+                bool passed = true;
+                for (int side = 0; (side < 2) && passed; ++side) {
+                    int color = edges[piece][side ^ ori] / 9;
+                    passed = color != edges[position][side] / 9;
+                    for (int i = 0; (i < partner_counts[side]) && passed; ++i) {
+                        passed = color != sample.cube[partners[side][i]] / 9;
+                    }
+                }
+                if (!passed) {
+                    continue;
+                }
+
+                OrderSample child = sample;
+                child.cube[edges[position][0]] = edges[piece][ori];
+                child.cube[edges[position][1]] = edges[piece][1 ^ ori];
+                child.used_pieces |= 1 << piece;
+                child.flip_parity ^= ori;
+                if (!JoinSampleFaces(&child, completed, new_faces)) {
+                    continue;
+                }
+
+                ++children;
+                if (next != NULL) {
+                    next->push_back(child);
+                }
+            }
+        }
+    }
+
+    return samples.empty() ? 0.0 : (double)children / (double)samples.size();
+}
+
+
+// Keep a random ORDER_SAMPLES of the samples, so each step starts from partial arrangements spread evenly over the tree.
+void ThinOrderSamples(std::vector<OrderSample>* samples)
+{
+    for (size_t i = 0; (i < (size_t)ORDER_SAMPLES) && (i < samples->size()); ++i) {
+        std::swap((*samples)[i], (*samples)[i + OrderRandom((unsigned int)(samples->size() - i))]);
+    }
+    if (samples->size() > (size_t)ORDER_SAMPLES) {
+        samples->resize(ORDER_SAMPLES);
+    }
+}
+
+
+void InitOrderSamples(std::vector<OrderSample>* samples)
+{
+    OrderSample root;
+    memset(&root, 0, sizeof(root));
+    order_random_state = 12345;
+    samples->assign(1, root);
+}
+
+
+double EstimateEdgeSearchNodes(const unsigned char order[CUBE_EDGES])
+{
+    std::vector<OrderSample> samples;
+    std::vector<OrderSample> next;
+    InitOrderSamples(&samples);
+
+    double nodes = 1.0;
+    double total = 0.0;
+    unsigned int filled = 0;
+    for (int step = 0; step < CUBE_EDGES; ++step) {
+        next.clear();
+        nodes *= SampleEdgeStep(samples, filled, order[step], step == CUBE_EDGES - 1, &next);
+        total += nodes;
+        filled |= 1u << order[step];
+        ThinOrderSamples(&next);
+        samples.swap(next);
+    }
+    return total;
+}
+
+
+// Does an order complete the faces in order? See EdgeOrderCompletesFacesInOrder().
+bool CompletesFacesInOrder(const unsigned char order[CUBE_EDGES])
+{
+    unsigned int filled = 0;
+    for (int step = 0; step < CUBE_EDGES; ++step) {
+        filled |= 1u << order[step];
+        unsigned int completed = CompletedFaces(filled);
+        if ((completed & (completed + 1)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool PickEdgeOrder(bool faces_in_order, unsigned char order[CUBE_EDGES])
+{
+    std::vector<OrderSample> samples;
+    std::vector<OrderSample> next;
+    InitOrderSamples(&samples);
+
+    unsigned int filled = 0;
+    for (int step = 0; step < CUBE_EDGES; ++step) {
+        bool allowed[CUBE_EDGES];
+        double children[CUBE_EDGES];
+        int new_faces[CUBE_EDGES];
+        int best = -1;
+        for (int position = 0; position < CUBE_EDGES; ++position) {
+            // The walk join can only take faces in order, so the completed faces must always be 0 through N.
+            unsigned int completed = CompletedFaces(filled | (1u << position));
+            allowed[position] = !((filled >> position) & 1) && (!faces_in_order || ((completed & (completed + 1)) == 0));
+            if (!allowed[position]) {
+                continue;
+            }
+
+            children[position] = SampleEdgeStep(samples, filled, position, step == CUBE_EDGES - 1, NULL);
+            new_faces[position] = 0;
+            for (unsigned int faces = completed & ~CompletedFaces(filled); faces != 0; faces &= faces - 1) {
+                ++new_faces[position];
+            }
+            if ((best < 0) || (children[position] < children[best])) {
+                best = position;
+            }
+        }
+        if (best < 0) {
+            return false;
+        }
+
+        // Of the positions tied for the fewest nodes, complete the most faces.
+        for (int position = 0; position < CUBE_EDGES; ++position) {
+            if (allowed[position] && (children[position] <= children[best] * (1.0 + ORDER_TIE)) && (new_faces[position] > new_faces[best])) {
+                best = position;
+            }
+        }
+
+        order[step] = (unsigned char)best;
+        next.clear();
+        SampleEdgeStep(samples, filled, best, step == CUBE_EDGES - 1, &next);
+        filled |= 1u << best;
+        ThinOrderSamples(&next);
+        samples.swap(next);
+    }
+
+    // Looking one step ahead misses positions that cost a little now to make later checks fire sooner, so then try swapping
+    // every pair of steps, keeping swaps that clearly cut the estimate for the whole search.
+    double nodes = EstimateEdgeSearchNodes(order);
+    for (int pass = 0; pass < ORDER_SWAP_PASSES; ++pass) {
+        bool improved = false;
+        for (int i = 0; i < CUBE_EDGES; ++i) {
+            for (int j = i + 1; j < CUBE_EDGES; ++j) {
+                std::swap(order[i], order[j]);
+                double swapped_nodes = (!faces_in_order || CompletesFacesInOrder(order)) ? EstimateEdgeSearchNodes(order) : nodes;
+                if (swapped_nodes < nodes * (1.0 - ORDER_TIE)) {
+                    nodes = swapped_nodes;
+                    improved = true;
+                }
+                else {
+                    std::swap(order[i], order[j]);
+                }
+            }
+        }
+        if (!improved) {
+            break;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "ScrambleEvaluation.h"
+
+// The edge search fills the edge positions one at a time, in edge_order: edge_order[k] is the position it fills at step k.
+// The corner search does the same with corner_order. Everything the searches check after each step is worked out from the
+// orders by SetEdgeOrder() and SetCornerOrder(), which must be called before searching. The default orders fill the
+// positions in the order of edges[] and corners[].
+extern unsigned char edge_order[CUBE_EDGES];
+extern unsigned char corner_order[CUBE_CORNERS];
+extern const unsigned char default_edge_order[CUBE_EDGES];
+extern const unsigned char default_corner_order[CUBE_CORNERS];
+
+// The edge search's schedule, by step.
+extern unsigned char edge_positions[CUBE_EDGES][2];                        // edges[edge_order[k]], the surfaces filled at step k.
+extern unsigned char face_completion_order[CUBE_FACES];                    // The faces in the order the edge search completes them.
+extern int edge_face_id_checks_start[CUBE_EDGES];                          // Step k completes face_completion_order[start[k]] through
+extern int edge_face_id_checks_end[CUBE_EDGES];                            // face_completion_order[end[k]]. -1 and -2 if it completes none.
+
+// The corner search's schedule, by step.
+constexpr auto CORNER_COUNT_CHECKS = 24;                                   // 4 sets of 3 corner surfaces on each face.
+extern unsigned char corner_positions[CUBE_CORNERS][3];                    // corners[corner_order[k]], the surfaces filled at step k.
+extern unsigned char corner_count_checks[CORNER_COUNT_CHECKS][3];          // Corner surfaces on a face that can't all be the same color, by the
+                                                                           // step that fills the last of them.
+extern unsigned char corner_count_checks_start[CUBE_CORNERS];              // Step k applies corner_count_checks from start[k] up to end[k].
+extern unsigned char corner_count_checks_end[CUBE_CORNERS];
+
+// Use an order and work out its schedule. Returns false, and leaves the order alone, if it isn't an order of every position.
+bool SetEdgeOrder(const unsigned char order[CUBE_EDGES]);
+bool SetCornerOrder(const unsigned char order[CUBE_CORNERS]);
+
+// Does the edge order complete the faces in order, face 0 first? GetCornerArrangementsIndex() joins faces 0 through N, so the
+// walk join only works with orders that do. The bitset join works with any order.
+bool EdgeOrderCompletesFacesInOrder();
+
+// Orders are written as the position ids in the order they're filled, e.g. "0123456789AB" for the default edge order.
+// Parse one count positions long. Returns false if it isn't an order of every position.
+bool ParsePlacementOrder(const char* text, int count, unsigned char* order);
+// Write an order out. text needs count + 1 chars.
+void FormatPlacementOrder(const unsigned char* order, int count, char* text);
+
+// Estimate how many nodes the edge search would visit with an order, from a sample of random partial edge arrangements
+// at each step. The samples go through the center color and diagonal checks and the corner join on each face as it's
+// completed, so the corner tables must be loaded.
+double EstimateEdgeSearchNodes(const unsigned char order[CUBE_EDGES]);
+
+// Pick an edge order step by step, each time filling the position that the sampled partial arrangements say leaves the
+// fewest nodes at the next step. Ties go to positions that complete a face, so the corner join starts as early as it can.
+// If faces_in_order is set, only orders the walk join can use are considered. Returns false if none was found that way.
+bool PickEdgeOrder(bool faces_in_order, unsigned char order[CUBE_EDGES]);
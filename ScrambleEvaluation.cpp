@@ -1,14 +1,26 @@
 #include "ScrambleEvaluation.h"
 #include "stdio.h"
 #include "stdlib.h"
+#include "string.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "CpuFeatures.h"
+#include "MappedFile.h"
+#include "SearchCriteria.h"
 
 #define __SANITY_CHECKS__
 
-const __int16 NOT_SET = 32767;
-
 __int16 face_table[FACE_ARRANGEMENTS]; // The unique pattern id for every possible face arrangment.
 bool face_table_filled = false;
 
+unsigned long long perfect_faces[(FACE_ARRANGEMENTS + 63) / 64];
+
+// The pattern id of every perfect face arrangement, in index order. perfect_face_ranks[word] is how many perfect face
+// arrangements come before perfect_faces[word], so the bits set below an index in its word finish off its place in here.
+std::vector<unsigned char> perfect_face_ids;
+unsigned int perfect_face_ranks[(FACE_ARRANGEMENTS + 63) / 64];
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // Scramble criteria
@@ -82,6 +94,31 @@ unsigned char GetFaceColorConnectedness(unsigned char face_colors[9])
 ////////////////////////////////////////////////////////////////////////////////
 
 
+// The ways a face can be rotated or flipped. The surface in position s of the transformed face is surface face_symmetries[n][s] of the original.
+const unsigned char face_symmetries[8][9] =
+    { { 0, 1, 2, 3, 4, 5, 6, 7, 8},   // Original face.
+      { 2, 5, 8, 1, 4, 7, 0, 3, 6},   // Rotated 90 degrees counter     clockwise.
+      { 8, 7, 6, 5, 4, 3, 2, 1, 0},   // Rotated 180 degrees.
+      { 6, 3, 0, 7, 4, 1, 8, 5, 2},   // Rotated 90 degrees clockwise.
+      { 2, 1, 0, 5, 4, 3, 8, 7, 6},   // Flipped.
+      { 8, 5, 2, 7, 4, 1, 6, 3, 0},   // Flipped, rotated 90 degrees clockwise.
+      { 6, 7, 8, 3, 4, 5, 0, 1, 2},   // Flipped, rotated 180 degrees.
+      { 0, 3, 6, 1, 4, 7, 2, 5, 8} }; // Flipped, rotated 90 degrees counter-clockwise.
+
+// FaceTable.dat is a FaceTableFileHeader followed by face_table[].
+const char FACE_TABLE_FILE_MAGIC[4] = { 'P', 'S', 'F', 'T' };
+const unsigned int FACE_TABLE_FILE_VERSION = 1;
+
+typedef struct {
+    char magic[4];                  // "PSFT"
+    unsigned int version;           // FACE_TABLE_FILE_VERSION.
+    unsigned int entry_count;       // FACE_ARRANGEMENTS.
+    unsigned int entry_size;        // sizeof(__int16).
+    unsigned long long checksum;    // Checksum() of face_table[].
+    unsigned char padding[8];
+} FaceTableFileHeader;
+
+
 // Convert the index into face_table[] into a list of colors on a cube face.
 void FaceIndexToColors(int index, unsigned char colors[9])
 {
@@ -92,6 +129,122 @@ void FaceIndexToColors(int index, unsigned char colors[9])
 }
 
 
+// The index of a face after applying face_symmetries[symmetry] and then swapping colors with color_swaps.
+int TransformFace(const unsigned char face_colors[9], int symmetry, const unsigned char color_swaps[CUBE_COLORS])
+{
+    int idx = 0;
+    for (int surface = 8; surface >= 0; --surface) {
+        idx = idx * CUBE_COLORS + color_swaps[face_colors[face_symmetries[symmetry][surface]]];
+    }
+    return idx;
+}
+
+
+// The lowest index that a face can be rotated, flipped, or have its colors swapped into.
+//
+// Surface 8 is the most significant digit of the index, so for any one symmetry the color swap that gives the lowest index
+// is the one that numbers the colors in the order they first appear, starting from surface 8. That leaves 8 candidates
+// instead of 8 * 720.
+int CanonicalFaceIndex(int index)
+{
+    unsigned char face_colors[9];
+    FaceIndexToColors(index, face_colors);
+
+    int lowest = index;
+    for (int symmetry = 0; symmetry < 8; ++symmetry) {
+        unsigned char color_swaps[CUBE_COLORS] = { 99, 99, 99, 99, 99, 99 };
+        unsigned char next_color = 0;
+        for (int surface = 8; surface >= 0; --surface) {
+            unsigned char color = face_colors[face_symmetries[symmetry][surface]];
+            if (color_swaps[color] == 99) {
+                color_swaps[color] = next_color++;
+            }
+        }
+
+        int idx = TransformFace(face_colors, symmetry, color_swaps);
+        if (idx < lowest) {
+            lowest = idx;
+        }
+    }
+
+    return lowest;
+}
+
+
+// A perfect face pattern meets the face criteria of a policy, which by default are:
+//     1. All 6 colors on one face.
+//     2. No more than two surfaces of each color.
+//     3. No two surfaces of the same color touching on an edge.
+//     4. No two surfaces of the same color touching on a diagonal.
+template <typename Criteria>
+bool IsPerfectPattern(int index)
+{
+    unsigned char color_count, max_instances;
+    unsigned char face_colors[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    FaceIndexToColors(index, face_colors);
+    GetFaceColorCounts(face_colors, &color_count, &max_instances);
+    if ((Criteria::ALL_COLORS && (color_count != CUBE_COLORS)) || (max_instances > Criteria::MAX_COLOR_COUNT)) {
+        return false;
+    }
+
+    // The least connected a face can be for the policy.
+    const int connectedness = Criteria::SIDES_MAY_TOUCH ? SIDES_TOUCHING : Criteria::CORNERS_MAY_TOUCH ? CORNERS_TOUCHING : NOTHING_TOUCHING;
+    return GetFaceColorConnectedness(face_colors) >= connectedness;
+}
+
+
+// Find the lowest index of every pattern, in order.
+//
+// A pattern's lowest index numbers its colors in the order they first appear, starting from surface 8. So the candidates
+// are the ways to color the face in that order, which is about 20,000 faces instead of 10 million. The ones that can't be
+// rotated or flipped to a lower index are the patterns.
+void FindFacePatterns(std::vector<int>* patterns)
+{
+    // Walk the colorings one surface at a time from surface 8, with each surface using a color already used or the next new one.
+    int idx[10] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    unsigned char next_color[10] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    unsigned char color[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    int depth = 0;
+    while (depth >= 0) {
+        if (depth == 9) {
+            if (CanonicalFaceIndex(idx[9]) == idx[9]) {
+                patterns->push_back(idx[9]);
+            }
+            --depth;
+            ++color[depth];
+            continue;
+        }
+        if ((color[depth] > next_color[depth]) || (color[depth] >= CUBE_COLORS)) {
+            color[depth] = 0;
+            if (--depth >= 0) {
+                ++color[depth];
+            }
+            continue;
+        }
+        idx[depth + 1] = idx[depth] * CUBE_COLORS + color[depth];
+        next_color[depth + 1] = (color[depth] == next_color[depth]) ? next_color[depth] + 1 : next_color[depth];
+        ++depth;
+    }
+}
+
+
+// Call visit(idx) for every rotation, flip and color swap of a face. Variations that look the same are visited more than once.
+template <typename Visit>
+void ForEachFaceVariation(int index, Visit visit)
+{
+    unsigned char face_colors[9];
+    FaceIndexToColors(index, face_colors);
+
+    for (int symmetry = 0; symmetry < 8; ++symmetry) {
+        unsigned char color_swaps[CUBE_COLORS] = { 0, 1, 2, 3, 4, 5 };
+        do {
+            visit(TransformFace(face_colors, symmetry, color_swaps));
+        } while (std::next_permutation(color_swaps, color_swaps + CUBE_COLORS));
+    }
+}
+
+
 // Build the face table.
 // 
 // A face is converted to an id by treading the colors of each face as a 9-digit, base-6 number.
@@ -101,92 +254,127 @@ void FaceIndexToColors(int index, unsigned char colors[9])
 // 
 // Patterns 0-15 are "perfect shuffle" patterns - all 6 colors on one face, no more
 // than two of any color, and no two of the same color touching on an edge or corner.
-void BuildFaceTable() {
-    unsigned char symmetries[8][9] =
-    { { 0, 1, 2, 3, 4, 5, 6, 7, 8},   // Original face.
-      { 2, 5, 8, 1, 4, 7, 0, 3, 6},   // Rotated 90 degrees counter     clockwise.
-      { 8, 7, 6, 5, 4, 3, 2, 1, 0},   // Rotated 180 degrees.
-      { 6, 3, 0, 7, 4, 1, 8, 5, 2},   // Rotated 90 degrees clockwise.
-      { 2, 1, 0, 5, 4, 3, 8, 7, 6},   // Flipped.
-      { 8, 5, 2, 7, 4, 1, 6, 3, 0},   // Flipped, rotated 90 degrees clockwise.
-      { 6, 7, 8, 3, 4, 5, 0, 1, 2},   // Flipped, rotated 180 degrees.
-      { 0, 3, 6, 1, 4, 7, 2, 5, 8} }; // Flipped, rotated 90 degrees counter-clockwise.
-
-    // Mark all patterns as unset.
-    for (int i = 0; i < FACE_ARRANGEMENTS; ++i) {
-        face_table[i] = NOT_SET;
+// Pattern ids are handed out in order of each pattern's lowest index, perfect and regular patterns separately.
+//
+// The patterns come straight from FindFacePatterns(), and every face belongs to exactly one pattern, so the patterns
+// are split over thread_count threads and each thread fills in every variation of its own patterns.
+void BuildFaceTable(int thread_count) {
+    if (thread_count < 1) {
+        thread_count = 1;
     }
 
-    // A perfect face pattern has:
-    //     1. All 6 colors on one face.
-    //     2. No more than two surfaces of each color.
-    //     3. No two surfaces of the same color touching on an edge.
-    //     4. No two surfaces of the same color touching on a diagonal.
+    std::vector<int> patterns;
+    FindFacePatterns(&patterns);
+
     // There are 16 perfect patterns, and they will be pattern ids 0 - 15.
     int next_perfect_pattern_id = 0;
     // A regular pattern is anything else.
-    int next_regular_pattern_id = 16;
+    int next_regular_pattern_id = PERFECT_PATTERNS;
 
-    int pattern_id;
-    for (int i = 0; i < FACE_ARRANGEMENTS; ++i) {
-        if (NOT_SET != face_table[i]) {
-            continue;
-        }
+    std::vector<__int16> pattern_ids(patterns.size());
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        pattern_ids[i] = IsPerfectPattern<DefaultCriteria>(patterns[i]) ? next_perfect_pattern_id++ : next_regular_pattern_id++;
+    }
 
-        unsigned char color_count, max_instances, color_connectedness;
-        int val = i;
-        unsigned char face_colors[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([t, thread_count, &patterns, &pattern_ids]() {
+            for (size_t i = t; i < patterns.size(); i += thread_count) {
+                __int16 pattern_id = pattern_ids[i];
+                ForEachFaceVariation(patterns[i], [pattern_id](int idx) { face_table[idx] = pattern_id; });
+            }
+        });
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
 
-        FaceIndexToColors(i, face_colors);
-        GetFaceColorCounts(face_colors, &color_count, &max_instances);
-        color_connectedness = GetFaceColorConnectedness(face_colors);
+#ifdef __SANITY_CHECKS__
+    if (next_perfect_pattern_id != PERFECT_PATTERNS) {
+        fprintf(stderr, "Found %i perfect patterns, but expected %i.\n", next_perfect_pattern_id, PERFECT_PATTERNS);
+    }
+#endif
 
-        if ((color_count == CUBE_COLORS) && (max_instances == 2) && (color_connectedness == NOTHING_TOUCHING)) {
-            pattern_id = next_perfect_pattern_id++;
-        }
-        else {
-            pattern_id = next_regular_pattern_id++;
+    face_table_filled = true;
+}
+
+
+// Fill out perfect_faces[], perfect_face_ids and perfect_face_ranks[] for a policy without building the face table. The perfect
+// patterns are found the same way BuildFaceTable() finds them, so with the default criteria the ids match.
+template <typename Criteria>
+void BuildPerfectFacesFor()
+{
+    std::vector<int> patterns;
+    FindFacePatterns(&patterns);
+
+    memset(perfect_faces, 0, sizeof(perfect_faces));
+    std::vector<unsigned int> found; // (index << 8) | pattern id for each perfect face arrangement.
+
+    unsigned int pattern_id = 0;
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        if (!IsPerfectPattern<Criteria>(patterns[i])) {
+            continue;
         }
 
-        int color_swaps[CUBE_COLORS] = { 0, 1, 2, 3, 4, 5 };
-        for (int symmetry = 0; symmetry < 8; ++symmetry) {
-            for (int c0 = 0; c0 < CUBE_COLORS; ++c0) {
-                SWAP(color_swaps[0], color_swaps[c0]);
-                for (int c1 = 1; c1 < CUBE_COLORS; ++c1) {
-                    SWAP(color_swaps[1], color_swaps[c1]);
-                    for (int c2 = 2; c2 < CUBE_COLORS; ++c2) {
-                        SWAP(color_swaps[2], color_swaps[c2]);
-                        for (int c3 = 3; c3 < CUBE_COLORS; ++c3) {
-                            SWAP(color_swaps[3], color_swaps[c3]);
-                            for (int c4 = 4; c4 < CUBE_COLORS; ++c4) {
-                                SWAP(color_swaps[4], color_swaps[c4]);
-
-                                int idx = 0;
-                                for (int surface = 8; surface >= 0; --surface) {
-                                    idx = idx * CUBE_COLORS + color_swaps[face_colors[symmetries[symmetry][surface]]];
-                                }
-
-                                if (face_table[idx] == NOT_SET) {
-                                    face_table[idx] = pattern_id;
-                                }
-
-                                SWAP(color_swaps[4], color_swaps[c4]);
-                            }
-                            SWAP(color_swaps[3], color_swaps[c3]);
-                        }
-                        SWAP(color_swaps[2], color_swaps[c2]);
-                    }
-                    SWAP(color_swaps[1], color_swaps[c1]);
-                }
-                SWAP(color_swaps[0], color_swaps[c0]);
+        ForEachFaceVariation(patterns[i], [pattern_id, &found](int idx) {
+            if ((perfect_faces[idx / 64] & (1ULL << (idx % 64))) == 0) {
+                perfect_faces[idx / 64] |= 1ULL << (idx % 64);
+                found.push_back(((unsigned int)idx << 8) | pattern_id);
             }
-        }
+        });
+        ++pattern_id;
+    }
+
+    if (pattern_id != Criteria::FACE_PATTERNS) {
+        fprintf(stderr, "Found %u perfect patterns, but expected %i.\n", pattern_id, Criteria::FACE_PATTERNS);
+    }
+
+    std::sort(found.begin(), found.end());
+    perfect_face_ids.resize(found.size());
+    for (size_t i = 0; i < found.size(); ++i) {
+        perfect_face_ids[i] = (unsigned char)(found[i] & 255);
+    }
+
+    unsigned int rank = 0;
+    for (int word = 0; word < (FACE_ARRANGEMENTS + 63) / 64; ++word) {
+        perfect_face_ranks[word] = rank;
+        rank += (unsigned int)CountBits64(perfect_faces[word]);
     }
 }
 
 
+void BuildPerfectFaces(int criteria)
+{
+    static_assert(FACE_ARRANGEMENTS <= (1 << 24), "Face indexes must fit in 24 bits, next to a pattern id.");
+    static_assert(DefaultCriteria::FACE_PATTERNS == PERFECT_PATTERNS, "The face table's perfect patterns are the default criteria's.");
+
+    static void (* const build[SEARCH_CRITERIA_COUNT])() = SEARCH_CRITERIA_INSTANCES(BuildPerfectFacesFor);
+    build[criteria]();
+}
+
+
+int PerfectPatternId(int index)
+{
+    unsigned long long bits = perfect_faces[(unsigned int)index / 64];
+    unsigned long long below = (1ULL << ((unsigned int)index % 64)) - 1;
+    if ((bits & (below + 1)) == 0) {
+        return -1;
+    }
+
+    return perfect_face_ids[perfect_face_ranks[(unsigned int)index / 64] + CountBits64(bits & below)];
+}
+
+
 // Write face_table[] to a file.
 bool WriteFaceTable() {
+    FaceTableFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FACE_TABLE_FILE_MAGIC, sizeof(header.magic));
+    header.version = FACE_TABLE_FILE_VERSION;
+    header.entry_count = FACE_ARRANGEMENTS;
+    header.entry_size = sizeof(__int16);
+    header.checksum = Checksum(face_table, sizeof(face_table));
+
     FILE* fp;
     errno_t err = fopen_s(&fp, "FaceTable.dat", "wb");
     if ((0 != err) || (NULL == fp)) {
@@ -194,31 +382,54 @@ bool WriteFaceTable() {
         return false;
     }
 
-    fwrite(face_table, sizeof(__int16), FACE_ARRANGEMENTS, fp);
+    bool written = (fwrite(&header, sizeof(header), 1, fp) == 1) && (fwrite(face_table, sizeof(__int16), FACE_ARRANGEMENTS, fp) == FACE_ARRANGEMENTS);
     fclose(fp);
     fp = NULL;
 
-    return true;
+    if (!written) {
+        fprintf(stderr, "Failed to write FaceTable.dat\n");
+        remove("FaceTable.dat");
+    }
+    return written;
 }
 
 
-// Read face_table from a file.
+// Read face_table from a file. Returns false if there isn't one, or if it doesn't match this version of the program.
 bool ReadFaceTable() {
-    FILE* fp;
-    errno_t err = fopen_s(&fp, "FaceTable.dat", "rb");
-    if ((0 != err) || (NULL == fp)) {
-        fprintf(stdout, "Building the face table.\n");
-        BuildFaceTable();
-        WriteFaceTable();
+    MappedFile file;
+    if (!MapFile("FaceTable.dat", &file)) {
+        return false;
+    }
+
+    const FaceTableFileHeader* header = (const FaceTableFileHeader*)file.data;
+    bool valid = (file.size == sizeof(FaceTableFileHeader) + sizeof(face_table)) &&
+                 (memcmp(header->magic, FACE_TABLE_FILE_MAGIC, sizeof(header->magic)) == 0) && (header->version == FACE_TABLE_FILE_VERSION) &&
+                 (header->entry_count == FACE_ARRANGEMENTS) && (header->entry_size == sizeof(__int16)) &&
+                 (Checksum(file.data + sizeof(FaceTableFileHeader), sizeof(face_table)) == header->checksum);
+    if (valid) {
+        memcpy(face_table, file.data + sizeof(FaceTableFileHeader), sizeof(face_table));
+        face_table_filled = true;
+    }
+    else {
+        fprintf(stderr, "FaceTable.dat is out of date or corrupt. It will be rebuilt.\n");
+    }
+
+    UnmapFile(&file);
+    return valid;
+}
+
+
+bool LoadFaceTable(int thread_count) {
+    if (face_table_filled) {
         return true;
     }
 
-    fprintf(stdout, "Reading the face table.\n");
-    fread(face_table, sizeof(__int16), FACE_ARRANGEMENTS, fp);
-    fclose(fp);
-    fp = NULL;
+    if (ReadFaceTable()) {
+        return true;
+    }
 
-    face_table_filled = true;
+    BuildFaceTable(thread_count);
+    WriteFaceTable();
     return true;
 }
 
@@ -229,40 +440,40 @@ bool ReadFaceTable() {
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-// See how connected a cube is.
+// Surfaces to compare to see if there are two side-by-side surfaces with the same color.
 // See ScrambleSearcher.cpp for the cube layout diagram.
-int GetColorConnectedness(unsigned char cube[CUBE_SURFACES])
+static const unsigned char side_pairs[72][2] = {
+    {  0,  1 },{  1,  2 },{  3,  4 },{  4,  5 },{  6,  7 },{  7,  8 },{  0,  3 },{  1,  4 },{  2,  5 },{  3,  6 },{  4,  7 },{  5,  8 },
+    {  9, 10 },{ 10, 11 },{ 12, 13 },{ 13, 14 },{ 15, 16 },{ 16, 17 },{  9, 12 },{ 10, 13 },{ 11, 14 },{ 12, 15 },{ 13, 16 },{ 14, 17 },
+    { 18, 19 },{ 19, 20 },{ 21, 22 },{ 22, 23 },{ 24, 25 },{ 25, 26 },{ 18, 21 },{ 19, 22 },{ 20, 23 },{ 21, 24 },{ 22, 25 },{ 23, 26 },
+    { 27, 28 },{ 28, 29 },{ 30, 31 },{ 31, 32 },{ 33, 34 },{ 34, 35 },{ 27, 30 },{ 28, 31 },{ 29, 32 },{ 30, 33 },{ 31, 34 },{ 32, 35 },
+    { 36, 37 },{ 37, 38 },{ 39, 40 },{ 40, 41 },{ 42, 43 },{ 43, 44 },{ 36, 39 },{ 37, 40 },{ 38, 41 },{ 39, 42 },{ 40, 43 },{ 41, 44 },
+    { 45, 46 },{ 46, 47 },{ 48, 49 },{ 49, 50 },{ 51, 52 },{ 52, 53 },{ 45, 48 },{ 46, 49 },{ 47, 50 },{ 48, 51 },{ 49, 52 },{ 50, 53 }
+};
+
+// Surfaces to compare to see if there are two surfaces with the same color, touching on the corners.
+static const unsigned char corner_pairs[48][2] = {
+    {  0,  4 }, {  2,  4 }, {  6,  4 }, {  8,  4 }, {  1,  3 }, {  1,  5 }, {  7,  3 }, {  7,  5 },
+    {  9, 13 }, { 11, 13 }, { 15, 13 }, { 17, 13 }, { 10, 12 }, { 10, 14 }, { 16, 12 }, { 16, 14 },
+    { 18, 22 }, { 20, 22 }, { 24, 22 }, { 26, 22 }, { 19, 21 }, { 19, 23 }, { 25, 21 }, { 25, 23 },
+    { 27, 31 }, { 29, 31 }, { 33, 31 }, { 35, 31 }, { 28, 30 }, { 28, 32 }, { 34, 30 }, { 34, 32 },
+    { 36, 40 }, { 38, 40 }, { 42, 40 }, { 44, 40 }, { 37, 39 }, { 37, 41 }, { 43, 39 }, { 43, 41 },
+    { 45, 49 }, { 47, 49 }, { 51, 49 }, { 53, 49 }, { 46, 48 }, { 46, 50 }, { 52, 48 }, { 52, 50 }
+};
+
+// Surfaces to compare to see if there are two surfaces with the same color, touching on the corners across two adjacent faces.
+const unsigned char face_corner_pairs[48][2] = {
+    { 19,  6 }, { 19,  8 }, { 21, 11 }, { 21, 17 }, { 23, 27 }, { 23, 33 }, { 25, 36 }, { 25, 38 },
+    { 37, 24 }, { 37, 26 }, { 39, 17 }, { 39, 15 }, { 41, 33 }, { 41, 35 }, { 43, 45 }, { 43, 47 },
+    { 46, 42 }, { 46, 44 }, { 48, 15 }, { 48,  9 }, { 50, 35 }, { 50, 29 }, { 52,  0 }, { 52,  2 },
+    {  1, 51 }, {  1, 53 }, {  3,  9 }, {  3, 11 }, {  5, 29 }, {  5, 27 }, {  7, 18 }, {  7, 20 },
+    { 10,  0 }, { 10,  6 }, { 12, 51 }, { 12, 45 }, { 14, 18 }, { 14, 24 }, { 16, 42 }, { 16, 36 },
+    { 28,  8 }, { 28,  2 }, { 30, 20 }, { 30, 26 }, { 32, 53 }, { 32, 47 }, { 34, 38 }, { 34, 44 }
+};
+
+
+int GetColorConnectednessScalar(const unsigned char cube[CUBE_SURFACES])
 {
-    // Surfaces to compare to see if there are two side-by-side surfaces with the same color.
-    static const unsigned char sides[72][2] = {
-        {  0,  1 },{  1,  2 },{  3,  4 },{  4,  5 },{  6,  7 },{  7,  8 },{  0,  3 },{  1,  4 },{  2,  5 },{  3,  6 },{  4,  7 },{  5,  8 },
-        {  9, 10 },{ 10, 11 },{ 12, 13 },{ 13, 14 },{ 15, 16 },{ 16, 17 },{  9, 12 },{ 10, 13 },{ 11, 14 },{ 12, 15 },{ 13, 16 },{ 14, 17 },
-        { 18, 19 },{ 19, 20 },{ 21, 22 },{ 22, 23 },{ 24, 25 },{ 25, 26 },{ 18, 21 },{ 19, 22 },{ 20, 23 },{ 21, 24 },{ 22, 25 },{ 23, 26 },
-        { 27, 28 },{ 28, 29 },{ 30, 31 },{ 31, 32 },{ 33, 34 },{ 34, 35 },{ 27, 30 },{ 28, 31 },{ 29, 32 },{ 30, 33 },{ 31, 34 },{ 32, 35 },
-        { 36, 37 },{ 37, 38 },{ 39, 40 },{ 40, 41 },{ 42, 43 },{ 43, 44 },{ 36, 39 },{ 37, 40 },{ 38, 41 },{ 39, 42 },{ 40, 43 },{ 41, 44 },
-        { 45, 46 },{ 46, 47 },{ 48, 49 },{ 49, 50 },{ 51, 52 },{ 52, 53 },{ 45, 48 },{ 46, 49 },{ 47, 50 },{ 48, 51 },{ 49, 52 },{ 50, 53 }
-    };
-
-    // Surfaces to compare to see if there are two surfaces with the same color, touching on the corners.
-    static const unsigned char corners[48][2] = {
-        {  0,  4 }, {  2,  4 }, {  6,  4 }, {  8,  4 }, {  1,  3 }, {  1,  5 }, {  7,  3 }, {  7,  5 },
-        {  9, 13 }, { 11, 13 }, { 15, 13 }, { 17, 13 }, { 10, 12 }, { 10, 14 }, { 16, 12 }, { 16, 14 },
-        { 18, 22 }, { 20, 22 }, { 24, 22 }, { 26, 22 }, { 19, 21 }, { 19, 23 }, { 25, 21 }, { 25, 23 },
-        { 27, 31 }, { 29, 31 }, { 33, 31 }, { 35, 31 }, { 28, 30 }, { 28, 32 }, { 34, 30 }, { 34, 32 },
-        { 36, 40 }, { 38, 40 }, { 42, 40 }, { 44, 40 }, { 37, 39 }, { 37, 41 }, { 43, 39 }, { 43, 41 },
-        { 45, 49 }, { 47, 49 }, { 51, 49 }, { 53, 49 }, { 46, 48 }, { 46, 50 }, { 52, 48 }, { 52, 50 }
-    };
-
-    // Surfaces to compare to see if there are two surfaces with the same color, touching on the corners across two adjacent faces.
-    static const unsigned char fcorners[48][2] = {
-        { 19,  6 }, { 19,  8 }, { 21, 11 }, { 21, 17 }, { 23, 27 }, { 23, 33 }, { 25, 36 }, { 25, 38 },
-        { 37, 24 }, { 37, 26 }, { 39, 17 }, { 39, 15 }, { 41, 33 }, { 41, 35 }, { 43, 45 }, { 43, 47 },
-        { 46, 42 }, { 46, 44 }, { 48, 15 }, { 48,  9 }, { 50, 35 }, { 50, 29 }, { 52,  0 }, { 52,  2 },
-        {  1, 51 }, {  1, 53 }, {  3,  9 }, {  3, 11 }, {  5, 29 }, {  5, 27 }, {  7, 18 }, {  7, 20 },
-        { 10,  0 }, { 10,  6 }, { 12, 51 }, { 12, 45 }, { 14, 18 }, { 14, 24 }, { 16, 42 }, { 16, 36 },
-        { 28,  8 }, { 28,  2 }, { 30, 20 }, { 30, 26 }, { 32, 53 }, { 32, 47 }, { 34, 38 }, { 34, 44 }
-    };
-
     unsigned char colors[CUBE_SURFACES] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
                                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
@@ -274,24 +485,159 @@ int GetColorConnectedness(unsigned char cube[CUBE_SURFACES])
 
     // Check to see if two of the same color are touching on a side, on the same face
     for (int idx = 0; idx < 72; ++idx) {
-        if (colors[sides[idx][0]] == colors[sides[idx][1]]) {
+        if (colors[side_pairs[idx][0]] == colors[side_pairs[idx][1]]) {
             return SIDES_TOUCHING;
         }
     }
 
     // Check to see if two of the same color are touching on a corner, on the same face.
     for (int idx = 0; idx < 48; ++idx) {
-        if (colors[corners[idx][0]] == colors[corners[idx][1]]) {
+        if (colors[corner_pairs[idx][0]] == colors[corner_pairs[idx][1]]) {
             return CORNERS_TOUCHING;
         }
     }
 
     // Check to see if two of the same color are touching on a corner, on adjacent faces.
     for (int idx = 0; idx < 48; ++idx) {
-        if (colors[fcorners[idx][0]] == colors[fcorners[idx][1]]) {
+        if (colors[face_corner_pairs[idx][0]] == colors[face_corner_pairs[idx][1]]) {
             return ADJACENT_FACES_TOUCHING;
         }
     }
 
     return NOTHING_TOUCHING;
 }
+
+
+void GetColorConnectednessBatchScalar(const unsigned char (*cubes)[CUBE_SURFACES], int count, int* results)
+{
+    for (int i = 0; i < count; ++i) {
+        results[i] = GetColorConnectednessScalar(cubes[i]);
+    }
+}
+
+
+// The AVX-512 version looks up every surface's color with one byte shuffle, then every pair table two shuffles and a compare
+// at a time, 64 pairs to a register. The side pairs take two registers. Only the lanes in connectedness_lane_masks hold pairs.
+typedef struct {
+    unsigned char colors[64];    // colors[surface] = surface / 9.
+    unsigned char first[4][64];  // The first surface of each pair: side pairs 0-63, side pairs 64-71, corner pairs, face corner pairs.
+    unsigned char second[4][64]; // The second surface of each pair.
+} ConnectednessLanes;
+
+ConnectednessLanes connectedness_lanes;
+const unsigned long long connectedness_lane_masks[4] = { ~0ULL, (1ULL << 8) - 1, (1ULL << 48) - 1, (1ULL << 48) - 1 };
+
+void FillConnectednessLanes()
+{
+    memset(&connectedness_lanes, 0, sizeof(connectedness_lanes));
+    for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+        connectedness_lanes.colors[surface] = (unsigned char)(surface / 9);
+    }
+    for (int i = 0; i < 72; ++i) {
+        connectedness_lanes.first[i / 64][i % 64] = side_pairs[i][0];
+        connectedness_lanes.second[i / 64][i % 64] = side_pairs[i][1];
+    }
+    for (int i = 0; i < 48; ++i) {
+        connectedness_lanes.first[2][i] = corner_pairs[i][0];
+        connectedness_lanes.second[2][i] = corner_pairs[i][1];
+        connectedness_lanes.first[3][i] = face_corner_pairs[i][0];
+        connectedness_lanes.second[3][i] = face_corner_pairs[i][1];
+    }
+}
+
+
+TARGET_AVX512_VBMI inline int ScoreConnectednessAvx512(const unsigned char cube[CUBE_SURFACES], __m512i color_lanes, const __m512i first[4], const __m512i second[4])
+{
+    // cube[] is only 54 bytes long, so load it with a mask. Surfaces are all under 64, so they index the color lanes directly.
+    __m512i colors = _mm512_permutexvar_epi8(_mm512_maskz_loadu_epi8((1ULL << CUBE_SURFACES) - 1, cube), color_lanes);
+
+    __mmask64 touching[4];
+    for (int v = 0; v < 4; ++v) {
+        touching[v] = _mm512_mask_cmpeq_epi8_mask(connectedness_lane_masks[v], _mm512_permutexvar_epi8(first[v], colors), _mm512_permutexvar_epi8(second[v], colors));
+    }
+
+    if ((touching[0] | touching[1]) != 0) {
+        return SIDES_TOUCHING;
+    }
+    if (touching[2] != 0) {
+        return CORNERS_TOUCHING;
+    }
+    if (touching[3] != 0) {
+        return ADJACENT_FACES_TOUCHING;
+    }
+    return NOTHING_TOUCHING;
+}
+
+
+TARGET_AVX512_VBMI void GetColorConnectednessBatchAvx512(const unsigned char (*cubes)[CUBE_SURFACES], int count, int* results)
+{
+    // Load the lanes once for the whole batch.
+    __m512i color_lanes = _mm512_loadu_si512(connectedness_lanes.colors);
+    __m512i first[4];
+    __m512i second[4];
+    for (int v = 0; v < 4; ++v) {
+        first[v] = _mm512_loadu_si512(connectedness_lanes.first[v]);
+        second[v] = _mm512_loadu_si512(connectedness_lanes.second[v]);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        results[i] = ScoreConnectednessAvx512(cubes[i], color_lanes, first, second);
+    }
+}
+
+
+int GetColorConnectednessAvx512(const unsigned char cube[CUBE_SURFACES])
+{
+    int result;
+    GetColorConnectednessBatchAvx512((const unsigned char (*)[CUBE_SURFACES])cube, 1, &result);
+    return result;
+}
+
+
+typedef struct {
+    const char* name;
+    int (*score)(const unsigned char cube[CUBE_SURFACES]);
+    void (*score_batch)(const unsigned char (*cubes)[CUBE_SURFACES], int count, int* results);
+} ConnectednessInstructions;
+
+const ConnectednessInstructions connectedness_instruction_sets[2] = { { "scalar", GetColorConnectednessScalar, GetColorConnectednessBatchScalar },
+                                                                      { "avx512", GetColorConnectednessAvx512, GetColorConnectednessBatchAvx512 } };
+
+const ConnectednessInstructions* PickConnectednessInstructions()
+{
+    FillConnectednessLanes();
+    return CpuHasAvx512Vbmi() ? &connectedness_instruction_sets[1] : &connectedness_instruction_sets[0];
+}
+
+const ConnectednessInstructions* connectedness_instructions = PickConnectednessInstructions();
+
+
+const char* GetConnectednessInstructions()
+{
+    return connectedness_instructions->name;
+}
+
+
+bool SetConnectednessInstructions(const char* name)
+{
+    for (int set = 0; set < 2; ++set) {
+        if ((strcmp(name, connectedness_instruction_sets[set].name) == 0) && ((set == 0) || CpuHasAvx512Vbmi())) {
+            connectedness_instructions = &connectedness_instruction_sets[set];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// See how connected a cube is.
+int GetColorConnectedness(unsigned char cube[CUBE_SURFACES])
+{
+    return connectedness_instructions->score(cube);
+}
+
+
+void GetColorConnectednessBatch(const unsigned char (*cubes)[CUBE_SURFACES], int count, int* results)
+{
+    connectedness_instructions->score_batch(cubes, count, results);
+}
@@ -16,13 +16,50 @@ constexpr auto CORNERS_TOUCHING = 1;        // Two surfaces of the same color ar
 constexpr auto ADJACENT_FACES_TOUCHING = 2; // Two surfaces of the same color, on adjacent faces, are touching at the corners.
 constexpr auto NOTHING_TOUCHING = 3;        // None of the above are touching.
 
+constexpr auto PERFECT_PATTERNS = 16; // Pattern ids 0-15 are the perfect patterns.
+
 extern __int16 face_table[FACE_ARRANGEMENTS]; // The unique pattern id for every possible face arrangment.
 
-void BuildFaceTable();
-// These write the face table out to a file and then read them for the next time the program is run.
-// They're really not necessary since building the face table from scratch is about as fast as reading it from a file.
+// The search only needs to know whether a face arrangement is perfect, and which perfect pattern it is. face_table[] is 20 MB
+// of random accesses, so the search uses these instead: a bit per face arrangement (1.2 MB) for "is it perfect", and for
+// "which one", the pattern ids of the few thousand perfect arrangements in order, found by counting the bits set before an
+// arrangement's bit. Filled in by BuildPerfectFaces(), which doesn't need face_table[].
+extern unsigned long long perfect_faces[(FACE_ARRANGEMENTS + 63) / 64];
+
+// Is face_table[index] < PERFECT_PATTERNS? Or with other search criteria, does the face arrangement meet their face criteria?
+inline bool IsPerfectFace(int index)
+{
+    return (perfect_faces[(unsigned int)index / 64] & (1ULL << ((unsigned int)index % 64))) != 0;
+}
+
+// face_table[index] for a perfect face arrangement, or with other search criteria, the arrangement's pattern id among the
+// patterns that meet them. Returns -1 if the arrangement isn't perfect.
+int PerfectPatternId(int index);
+
+// The surfaces for each corner and edge piece. Defined in ScrambleSearcher.cpp, next to the cube layout diagram.
+extern const unsigned char corners[CUBE_CORNERS][3];
+extern const unsigned char edges[CUBE_EDGES][2];
+
+// Only tools that need regular pattern ids need the face table. The search only needs BuildPerfectFaces().
+void BuildFaceTable(int thread_count);
+// Build them for one of the SEARCH_CRITERIA_* policies in SearchCriteria.h.
+void BuildPerfectFaces(int criteria);
+// These write the face table out to FaceTable.dat and then read it for the next time the program is run.
 bool ReadFaceTable();
 bool WriteFaceTable();
+// Read FaceTable.dat, or build the face table and write it if FaceTable.dat is missing or out of date.
+bool LoadFaceTable(int thread_count);
+
+// Pairs of surfaces on adjacent faces that touch at a corner, edge surface first. Once every face is perfect, these are the
+// only pairs left that can tell ADJACENT_FACES_TOUCHING from NOTHING_TOUCHING.
+extern const unsigned char face_corner_pairs[48][2];
 
-// See how connected a cube is.
+// See how connected a cube is. Every entry of cube[] must be a surface, 0 to 53.
 int GetColorConnectedness(unsigned char cube[CUBE_SURFACES]);
+// Score count cubes at once: results[i] = GetColorConnectedness(cubes[i]).
+void GetColorConnectednessBatch(const unsigned char (*cubes)[CUBE_SURFACES], int count, int* results);
+// The instructions GetColorConnectedness() uses: "avx512" (with VBMI byte shuffles) or "scalar". The best the CPU has is
+// picked at startup.
+const char* GetConnectednessInstructions();
+// Use other instructions, e.g. to compare them. Returns false if the CPU doesn't have them.
+bool SetConnectednessInstructions(const char* name);
@@ -47,9 +47,28 @@
 // Moving the corner piece will move all three surfaces. When the cube is in its solved state, surface 6 will be in position 6, etc.
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
 #include <ostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Benchmark.h"
+#include "CornerBitsets.h"
+#include "MappedFile.h"
+#include "PlacementOrder.h"
 #include "ScrambleEvaluation.h"
+#include "ScrambleSearcher.h"
+#include "SearchCriteria.h"
+#include "Sharding.h"
+#include "SolutionDedupe.h"
+#include "SolutionSink.h"
+#include "SolutionStream.h"
 
 #pragma region Utilities
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -58,8 +77,6 @@
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-constexpr auto CUBE_COLORS_SQ = CUBE_COLORS * CUBE_COLORS;
-
 // The color of each surface in a cube. colors[x] seems marginally faster than x / 9, though I haven't done any formal timing tests.
 const unsigned char colors[CUBE_SURFACES] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2,
                                               3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5 };
@@ -72,8 +89,20 @@ inline unsigned char ColorOf(unsigned char x)
     return color;
 }
 
+// The index of the lowest set bit. bits must not be 0.
+inline int LowestBit(unsigned long long bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return (int)index;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
 // Compare the first [count] entries in two arrays of Face Ids.
-int compareFaceIds(unsigned int* a, unsigned int* b, int count)
+int compareFaceIds(const unsigned int* a, const unsigned int* b, int count)
 {
     for (int i = 0; i < count; ++i) {
         if (a[i] < b[i]) {
@@ -104,71 +133,292 @@ int compareFaceIds(unsigned int* a, unsigned int* b, int count)
 const unsigned char corners[CUBE_CORNERS][3] = { { 18, 11,  6 }, { 20,  8, 27 }, { 24, 36, 17 }, { 26, 33, 38 },
                                                  { 45, 15, 42 }, { 47, 44, 35 }, { 51,  0,  9 }, { 53, 29,  2 } };
 
-// Positions to check to ensure that no three corners on the same face have the same color.
-const unsigned char corner_count_checks[24][3] = {
-            { 18, 20, 24 },                                                                 // Index   0   - Requires corner 2.
-            { 18, 20, 26 }, { 18, 24, 26 }, { 20, 24, 26 },                                 // Index 1-3   - Requires corner 3.
-            { 11, 15, 17 }, { 36, 38, 42 },                                                 // Index 4-5   - Requires corner 4.
-            { 27, 33, 35 }, { 36, 38, 44 }, { 36, 42, 44 }, { 38, 42, 44 },                 // Index 6-9   - Requires corner 5.
-            {  0,  6,  8 }, { 45, 47, 51 }, {  9, 11, 15 }, {  9, 11, 17 }, {  9, 15, 17 }, // Index 10-14 - Requires corner 6.
-            {  0,  2,  6 }, {  0,  2,  8 }, {  2,  6,  8 }, { 27, 29, 33 }, { 27, 29, 35 }, // Index 15-23 - Requires corner 7.
-            { 29, 33, 35 }, { 45, 47, 53 }, { 45, 51, 53 }, { 47, 51, 53 } };
-
-// Once corner piece N is placed, apply corner count checks from corner_count_checks_start[N] through corner_count_checks_end[N].
-const unsigned char corner_count_checks_start[CUBE_CORNERS] = {  99, 99, 0, 1, 4, 6, 10, 15};
-const unsigned char corner_count_checks_end  [CUBE_CORNERS] = {  98, 98, 0, 3, 5, 9, 14, 23};
+// The checks the corner search makes after placing each piece are worked out from corner_order, in PlacementOrder.cpp.
 
 //
 // Cached data - All the acceptable ways to arrange the corner pieces.
 //
 
+// A corner arrangement while the corner tables are being built. Once they're built, the arrangements are split into
+// ep/op_corner_table, which keep the keys that the join reads apart from the arrangements that only RecordSolution() reads.
 typedef struct {
     unsigned char arrangement[CUBE_SURFACES];  // The positions of the corner pieces. To be OR'ed together with edge arrangements.
     unsigned int faceIds[CUBE_FACES];          // The corners' contribution to each face arrangement. Includes the center piece. To be added to the edges' contribution.
     unsigned int nextIndex[CUBE_FACES];        // The index of the first entry that contains a different value.
 } CornerArrangement;
 
-// Hard-coded because I worked it out once and now I can be lazy with array sizes.
-const int EP_CORNER_ARRANGEMENT_COUNT = 375336;
-const int OP_CORNER_ARRANGEMENT_COUNT = 375304;
-
-CornerArrangement ep_corner_arrangements[EP_CORNER_ARRANGEMENT_COUNT];
-CornerArrangement op_corner_arrangements[OP_CORNER_ARRANGEMENT_COUNT];
-
 // Used when filling ep/op_corner_arrangements.
+CornerArrangement* ep_corner_arrangements = NULL;
+CornerArrangement* op_corner_arrangements = NULL;
 int ep_corner_arrangement_count = 0;
 int op_corner_arrangement_count = 0;
+// The arrangements stored so far, for the progress CreateCornerArrangements() prints.
+int corner_progress_count = 0;
+bool print_corner_progress = true;
+
+// Either built by CreateCornerArrangements() or mapped read-only from Corners.dat by ReadCornerArrangements().
+CornerArrangementTable ep_corner_table = { NULL, NULL, 0, NULL, NULL };
+CornerArrangementTable op_corner_table = { NULL, NULL, 0, NULL, NULL };
+
+// The first_indexes of ep/op_corner_table. Worked out from the keys whenever the tables are loaded.
+int ep_first_indexes[CORNER_FACE_CODES + 1];
+int op_first_indexes[CORNER_FACE_CODES + 1];
+
+unsigned int corner_face_ids[CORNER_FACE_CODES];
+unsigned int edge_face_ids[EDGE_FACE_CODES];
+unsigned long long corner_face_matches[EDGE_FACE_CODES][CORNER_FACE_MATCH_WORDS];
+unsigned char edge_color_bits[CUBE_SURFACES];
+
+// Corners.dat is a CornerFileHeader followed by the even and odd parity keys, then the even and odd parity arrangements,
+// exactly as they are in memory. The header records the layout of CornerArrangementKey so a file from an older build or
+// a different compiler is rebuilt instead of misread.
+const char CORNER_FILE_MAGIC[4] = { 'P', 'S', 'C', 'A' };
+const unsigned int CORNER_FILE_VERSION = 1;
+
+typedef struct {
+    char magic[4];                  // "PSCA"
+    unsigned int version;           // CORNER_FILE_VERSION.
+    unsigned int key_size;          // sizeof(CornerArrangementKey).
+    unsigned int face_ids_offset;   // offsetof(CornerArrangementKey, faceIds).
+    unsigned int next_index_offset; // offsetof(CornerArrangementKey, nextIndex).
+    unsigned int ep_count;          // EP_CORNER_ARRANGEMENT_COUNT.
+    unsigned int op_count;          // OP_CORNER_ARRANGEMENT_COUNT.
+    unsigned int arrangement_size;  // CUBE_SURFACES.
+    unsigned long long checksum;    // Checksum() of everything after the header.
+    unsigned char padding[24];      // Keeps the keys 64-byte aligned in the mapping.
+} CornerFileHeader;
+
+// The mapping of Corners.dat. It stays mapped for as long as the program runs.
+MappedFile corner_file = { NULL, 0 };
+
+
+// Fill out corner_face_ids[].
+void FillCornerFaceIds()
+{
+    for (int code = 0; code < CORNER_FACE_CODES; ++code) {
+        unsigned int face_id = 0;
+        for (int digit = 4, rest = code; digit >= 0; --digit) {
+            int place = 1;
+            for (int i = 0; i < digit; ++i) {
+                place *= CUBE_COLORS;
+            }
+            face_id = face_id * CUBE_COLORS_SQ + (rest / place);
+            rest %= place;
+        }
+        corner_face_ids[code] = face_id;
+    }
+}
+
+
+// The inverse of corner_face_ids[]: convert a corner contribution to a face id into a corner face code.
+unsigned short CornerFaceCode(unsigned int face_id)
+{
+    unsigned int code = 0;
+    unsigned int place = 1;
+    for (int digit = 0; digit < 5; ++digit) {
+        code += (face_id % CUBE_COLORS_SQ) * place;
+        face_id /= CUBE_COLORS_SQ;
+        place *= CUBE_COLORS;
+    }
+    return (unsigned short)code;
+}
+
+
+// Fill out edge_face_ids[] and corner_face_matches[]. The perfect faces must already be built.
+void FillEdgeFaceTables()
+{
+    for (int code = 0; code < EDGE_FACE_CODES; ++code) {
+        int top = code / (CUBE_COLORS * CUBE_COLORS_SQ);
+        int left = (code / CUBE_COLORS_SQ) % CUBE_COLORS;
+        int right = (code / CUBE_COLORS) % CUBE_COLORS;
+        int bottom = code % CUBE_COLORS;
+        edge_face_ids[code] = (((top * CUBE_COLORS_SQ + left) * CUBE_COLORS_SQ + right) * CUBE_COLORS_SQ + bottom) * CUBE_COLORS;
+    }
+
+    // Split every perfect face arrangement into its corner and edge digits.
+    memset(corner_face_matches, 0, sizeof(corner_face_matches));
+    for (int word = 0; word < (FACE_ARRANGEMENTS + 63) / 64; ++word) {
+        for (unsigned long long bits = perfect_faces[word]; bits != 0; bits &= bits - 1) {
+            int face_idx = word * 64 + LowestBit(bits);
+
+            int corner_code = 0;
+            int edge_code = 0;
+            int place = FACE_ARRANGEMENTS / CUBE_COLORS;
+            for (int digit = 0; digit < 9; ++digit, place /= CUBE_COLORS) {
+                int color = (face_idx / place) % CUBE_COLORS;
+                if ((digit % 2) == 0) {
+                    corner_code = corner_code * CUBE_COLORS + color;
+                }
+                else {
+                    edge_code = edge_code * CUBE_COLORS + color;
+                }
+            }
+            corner_face_matches[edge_code][corner_code / 64] |= 1ULL << (corner_code % 64);
+        }
+    }
+}
+
+
+// Fill out a table's first_indexes from its keys.
+void FillFirstIndexes(CornerArrangementTable* table, int first_indexes[CORNER_FACE_CODES + 1])
+{
+    int index = table->count;
+    for (int code = CORNER_FACE_CODES; code >= 0; --code) {
+        while ((index > 0) && (table->keys[index - 1].faceIds[0] >= code)) {
+            --index;
+        }
+        first_indexes[code] = index;
+    }
+    table->first_indexes = first_indexes;
+}
+
+
+// Fill out a table's adjacent_colors from its arrangements, and edge_color_bits[] if it hasn't been yet.
+void FillAdjacentColors(CornerArrangementTable* table)
+{
+    for (int edge = 0; edge < CUBE_EDGES; ++edge) {
+        edge_color_bits[edges[edge][0]] = (unsigned char)((2 * edge) * 8);
+        edge_color_bits[edges[edge][1]] = (unsigned char)((2 * edge + 1) * 8);
+    }
+
+    unsigned long long (*adjacent_colors)[EDGE_COLOR_WORDS] = (unsigned long long (*)[EDGE_COLOR_WORDS])calloc(table->count, sizeof(*adjacent_colors));
+    if (adjacent_colors == NULL) {
+        fprintf(stderr, "Out of memory for corner arrangements.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < table->count; ++i) {
+        for (int pair = 0; pair < 48; ++pair) {
+            int bit = edge_color_bits[face_corner_pairs[pair][0]] + table->arrangements[i][face_corner_pairs[pair][1]] / 9;
+            adjacent_colors[i][bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+    table->adjacent_colors = adjacent_colors;
+}
+
+
+// Does a search with these criteria join the corners to the edge colors?
+template <typename Criteria>
+bool JoinsEdgeColors()
+{
+    return !Criteria::ADJACENT_FACES_MAY_TOUCH;
+}
+
+
+// Fill out the tables' adjacent_colors once they're loaded, if the search criteria join the corners to the edge colors. No
+// other search reads them, so it doesn't pay for building them or for the private memory they take.
+void FillAdjacentColorsIfNeeded()
+{
+    static bool (* const joins_edge_colors[SEARCH_CRITERIA_COUNT])() = SEARCH_CRITERIA_INSTANCES(JoinsEdgeColors);
+    if (!joins_edge_colors[search_criteria]()) {
+        return;
+    }
+
+    CornerArrangementTable* tables[2] = { &ep_corner_table, &op_corner_table };
+    for (int parity = 0; parity < 2; ++parity) {
+        if ((tables[parity]->count > 0) && (tables[parity]->adjacent_colors == NULL)) {
+            FillAdjacentColors(tables[parity]);
+        }
+    }
+}
 
 
+// Free the tables' adjacent_colors, e.g. because the arrangements they were filled from are being replaced.
+void FreeAdjacentColors()
+{
+    CornerArrangementTable* tables[2] = { &ep_corner_table, &op_corner_table };
+    for (int parity = 0; parity < 2; ++parity) {
+        free((void*)tables[parity]->adjacent_colors);
+        tables[parity]->adjacent_colors = NULL;
+    }
+}
+
+
+// Fill out the header for the corner tables that are in memory.
+void InitCornerFileHeader(CornerFileHeader* header)
+{
+    memset(header, 0, sizeof(CornerFileHeader));
+    memcpy(header->magic, CORNER_FILE_MAGIC, sizeof(header->magic));
+    header->version = CORNER_FILE_VERSION;
+    header->key_size = sizeof(CornerArrangementKey);
+    header->face_ids_offset = offsetof(CornerArrangementKey, faceIds);
+    header->next_index_offset = offsetof(CornerArrangementKey, nextIndex);
+    header->ep_count = EP_CORNER_ARRANGEMENT_COUNT;
+    header->op_count = OP_CORNER_ARRANGEMENT_COUNT;
+    header->arrangement_size = CUBE_SURFACES;
+}
+
+
+// Map Corners.dat and use the tables in it in place.
 bool ReadCornerArrangements()
 {
-    FILE* fp = NULL;
-    errno_t result = fopen_s(&fp, "Corners.dat", "rb");
-    if ((result != 0) || (fp == NULL)) {
+    FillCornerFaceIds();
+    FillEdgeFaceTables();
+
+    if (!MapFile("Corners.dat", &corner_file)) {
         return false;
     }
 
-    int records_read = (int)fread(ep_corner_arrangements, sizeof(CornerArrangement), EP_CORNER_ARRANGEMENT_COUNT, fp);
-    if (records_read != EP_CORNER_ARRANGEMENT_COUNT) {
-        fprintf(stderr, "Reading ep_corner_arrangements - expected to read %d, but read %d.\n", EP_CORNER_ARRANGEMENT_COUNT, records_read);
-        fclose(fp);
+    CornerFileHeader expected;
+    InitCornerFileHeader(&expected);
+
+    size_t ep_keys_size = EP_CORNER_ARRANGEMENT_COUNT * sizeof(CornerArrangementKey);
+    size_t op_keys_size = OP_CORNER_ARRANGEMENT_COUNT * sizeof(CornerArrangementKey);
+    size_t ep_arrangements_size = EP_CORNER_ARRANGEMENT_COUNT * CUBE_SURFACES;
+    size_t op_arrangements_size = OP_CORNER_ARRANGEMENT_COUNT * CUBE_SURFACES;
+    size_t data_size = ep_keys_size + op_keys_size + ep_arrangements_size + op_arrangements_size;
+    if (corner_file.size != sizeof(CornerFileHeader) + data_size) {
+        fprintf(stderr, "Corners.dat is %zu bytes, but should be %zu. It will be rebuilt.\n", corner_file.size, sizeof(CornerFileHeader) + data_size);
+        UnmapFile(&corner_file);
         return false;
     }
 
-    records_read = (int)fread(op_corner_arrangements, sizeof(CornerArrangement), OP_CORNER_ARRANGEMENT_COUNT, fp);
-    if (records_read != OP_CORNER_ARRANGEMENT_COUNT) {
-        fprintf(stderr, "Reading op_corner_arrangements - expected to read %d, but read %d.\n", OP_CORNER_ARRANGEMENT_COUNT, records_read);
-        fclose(fp);
+    const CornerFileHeader* header = (const CornerFileHeader*)corner_file.data;
+    if ((memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0) || (header->version != expected.version) ||
+        (header->key_size != expected.key_size) || (header->face_ids_offset != expected.face_ids_offset) ||
+        (header->next_index_offset != expected.next_index_offset) || (header->ep_count != expected.ep_count) ||
+        (header->op_count != expected.op_count) || (header->arrangement_size != expected.arrangement_size)) {
+        fprintf(stderr, "Corners.dat was written by a different version of this program. It will be rebuilt.\n");
+        UnmapFile(&corner_file);
         return false;
     }
 
-    fclose(fp);
+    const unsigned char* data = corner_file.data + sizeof(CornerFileHeader);
+    if (Checksum(data, data_size) != header->checksum) {
+        fprintf(stderr, "Corners.dat is corrupt. It will be rebuilt.\n");
+        UnmapFile(&corner_file);
+        return false;
+    }
+
+    // The mapping is read-only. Nothing writes to the tables once they are built.
+    ep_corner_table.keys = (const CornerArrangementKey*)data;
+    op_corner_table.keys = (const CornerArrangementKey*)(data + ep_keys_size);
+    ep_corner_table.arrangements = (const unsigned char (*)[CUBE_SURFACES])(data + ep_keys_size + op_keys_size);
+    op_corner_table.arrangements = (const unsigned char (*)[CUBE_SURFACES])(data + ep_keys_size + op_keys_size + ep_arrangements_size);
+    ep_corner_table.count = EP_CORNER_ARRANGEMENT_COUNT;
+    op_corner_table.count = OP_CORNER_ARRANGEMENT_COUNT;
+    FillFirstIndexes(&ep_corner_table, ep_first_indexes);
+    FillFirstIndexes(&op_corner_table, op_first_indexes);
+    FreeAdjacentColors();
+    FillAdjacentColorsIfNeeded();
     return true;
 }
 
 
 bool WriteCornerArrangements()
 {
+    const void* blocks[4] = { ep_corner_table.keys, op_corner_table.keys, ep_corner_table.arrangements, op_corner_table.arrangements };
+    size_t block_sizes[4] = { EP_CORNER_ARRANGEMENT_COUNT * sizeof(CornerArrangementKey), OP_CORNER_ARRANGEMENT_COUNT * sizeof(CornerArrangementKey),
+                              EP_CORNER_ARRANGEMENT_COUNT * CUBE_SURFACES, OP_CORNER_ARRANGEMENT_COUNT * CUBE_SURFACES };
+    const char* block_names[4] = { "even parity keys", "odd parity keys", "even parity arrangements", "odd parity arrangements" };
+
+    CornerFileHeader header;
+    InitCornerFileHeader(&header);
+    header.checksum = CHECKSUM_SEED;
+    for (int i = 0; i < 4; ++i) {
+        header.checksum = Checksum(blocks[i], block_sizes[i], header.checksum);
+    }
+
     FILE* fp = NULL;
     errno_t result = fopen_s(&fp, "Corners.dat", "wb");
     if ((result != 0) || (fp == NULL)) {
@@ -176,18 +426,19 @@ bool WriteCornerArrangements()
         return false;
     }
 
-    int records_written = (int)fwrite(ep_corner_arrangements, sizeof(CornerArrangement), EP_CORNER_ARRANGEMENT_COUNT, fp);
-    if (records_written != EP_CORNER_ARRANGEMENT_COUNT) {
-        fprintf(stderr, "Writing ep_corner_arrangements - expected to write %d, but wrote %d.\n", EP_CORNER_ARRANGEMENT_COUNT, records_written);
+    if (fwrite(&header, sizeof(CornerFileHeader), 1, fp) != 1) {
+        fprintf(stderr, "Writing the Corners.dat header failed.\n");
         fclose(fp);
         return false;
     }
 
-    records_written = (int)fwrite(op_corner_arrangements, sizeof(CornerArrangement), OP_CORNER_ARRANGEMENT_COUNT, fp);
-    if (records_written != OP_CORNER_ARRANGEMENT_COUNT) {
-        fprintf(stderr, "Writing op_corner_arrangements - expected to write %d, but wrote %d.\n", OP_CORNER_ARRANGEMENT_COUNT, records_written);
-        fclose(fp);
-        return false;
+    for (int i = 0; i < 4; ++i) {
+        size_t bytes_written = fwrite(blocks[i], 1, block_sizes[i], fp);
+        if (bytes_written != block_sizes[i]) {
+            fprintf(stderr, "Writing %s - expected to write %zu bytes, but wrote %zu.\n", block_names[i], block_sizes[i], bytes_written);
+            fclose(fp);
+            return false;
+        }
     }
 
     fclose(fp);
@@ -195,52 +446,18 @@ bool WriteCornerArrangements()
 }
 
 
+// Add an arrangement to the end of the list. The list gets sorted once every arrangement has been found.
 void StoreCornerArrangement(unsigned char cube[CUBE_SURFACES], CornerArrangement* corner_arrangements, int corner_arrangement_count)
 {
-    // Calculate the corners' contributions to the face arrangement
-    unsigned int face_ids[CUBE_FACES] = { 0, 0, 0, 0, 0, 0 };
+    CornerArrangement* corner_arrangement = &corner_arrangements[corner_arrangement_count];
 
+    // Calculate the corners' contributions to the face arrangement
     for (int i = 0; i < CUBE_FACES; ++i) {
         int start = i * 9;
-        face_ids[i] = ((((cube[start] / 9) * CUBE_COLORS_SQ + (cube[start + 2] / 9)) * CUBE_COLORS_SQ + (cube[start + 4] / 9)) * CUBE_COLORS_SQ + (cube[start + 6] / 9)) * CUBE_COLORS_SQ + (cube[start + 8] / 9);
-    }
-
-    // Find the position to insert the cube arrangmeent at.
-    int insert_at = 0;
-    int lower = 0;
-    int upper = corner_arrangement_count - 1;
-
-    if (corner_arrangement_count == 0) {
-        insert_at = 0;
-    }
-    else if (compareFaceIds(face_ids, corner_arrangements[lower].faceIds, CUBE_FACES) < 0) {
-        insert_at = 0;
-    }
-    else if (compareFaceIds(face_ids, corner_arrangements[upper].faceIds, CUBE_FACES) > 0) {
-        insert_at = upper + 1;
-    }
-    else {
-        while (lower + 1 < upper) {
-            int mid = (upper + lower) / 2;
-            int comp = compareFaceIds(face_ids, corner_arrangements[mid].faceIds, CUBE_FACES);
-            if (comp < 0) {
-                upper = mid;
-            }
-            else {
-                lower = mid;
-            }
-        };
-        insert_at = upper;
-    }
-
-    // Move stuff to make room for the new arrangement.
-    for (int i = corner_arrangement_count - 1; i >= insert_at; --i) {
-        memcpy(&(corner_arrangements[i + 1]), &(corner_arrangements[i]), sizeof(CornerArrangement));
+        corner_arrangement->faceIds[i] = ((((cube[start] / 9) * CUBE_COLORS_SQ + (cube[start + 2] / 9)) * CUBE_COLORS_SQ + (cube[start + 4] / 9)) * CUBE_COLORS_SQ + (cube[start + 6] / 9)) * CUBE_COLORS_SQ + (cube[start + 8] / 9);
     }
 
-    // Insert the new arrangement.
-    memcpy(corner_arrangements[insert_at].arrangement, cube, CUBE_SURFACES * sizeof(unsigned char));
-    memcpy(corner_arrangements[insert_at].faceIds, face_ids, CUBE_FACES * sizeof(unsigned int));
+    memcpy(corner_arrangement->arrangement, cube, CUBE_SURFACES * sizeof(unsigned char));
 }
 
 
@@ -250,25 +467,28 @@ void PlaceLastCornerPiece(unsigned char corner_num, unsigned char pieces[CUBE_CO
     unsigned char ori = (3 - rotation_parity) % 3;
 
     // Place the piece.
-    cube[corners[corner_num][0]] = corners[pieces[corner_num]][(0 + ori) % 3];
-    cube[corners[corner_num][1]] = corners[pieces[corner_num]][(1 + ori) % 3];
-    cube[corners[corner_num][2]] = corners[pieces[corner_num]][(2 + ori) % 3];
+    cube[corner_positions[corner_num][0]] = corners[pieces[corner_num]][(0 + ori) % 3];
+    cube[corner_positions[corner_num][1]] = corners[pieces[corner_num]][(1 + ori) % 3];
+    cube[corner_positions[corner_num][2]] = corners[pieces[corner_num]][(2 + ori) % 3];
+    ++corner_search_stats.nodes[corner_num];
 
     // Check to make sure that no corner surface has the same color as the center (no CORNERS_TOUCHING).
-    if ((ColorOf(cube[corners[corner_num][0]]) == ColorOf(corners[corner_num][0])) ||
-        (ColorOf(cube[corners[corner_num][1]]) == ColorOf(corners[corner_num][1])) ||
-        (ColorOf(cube[corners[corner_num][2]]) == ColorOf(corners[corner_num][2]))) {
+    if ((ColorOf(cube[corner_positions[corner_num][0]]) == ColorOf(corner_positions[corner_num][0])) ||
+        (ColorOf(cube[corner_positions[corner_num][1]]) == ColorOf(corner_positions[corner_num][1])) ||
+        (ColorOf(cube[corner_positions[corner_num][2]]) == ColorOf(corner_positions[corner_num][2]))) {
+        ++corner_search_stats.pruned[corner_num][CORNER_PRUNE_CENTER_COLOR];
         return;
     }
 
     // Check to make sure that we don't have 3 corners of the same color on a single face.
     bool color_count_passed = true;
-    for (int i = corner_count_checks_start[corner_num]; i <= corner_count_checks_end[corner_num]; ++i) {
+    for (int i = corner_count_checks_start[corner_num]; i < corner_count_checks_end[corner_num]; ++i) {
         color_count_passed &= (ColorOf(cube[corner_count_checks[i][0]]) != ColorOf(cube[corner_count_checks[i][1]])) ||
             (ColorOf(cube[corner_count_checks[i][0]]) != ColorOf(cube[corner_count_checks[i][2]]));
     }
 
     if (!color_count_passed) {
+        ++corner_search_stats.pruned[corner_num][CORNER_PRUNE_THREE_OF_A_COLOR];
         return;
     }
 
@@ -282,10 +502,9 @@ void PlaceLastCornerPiece(unsigned char corner_num, unsigned char pieces[CUBE_CO
     }
 
     // Show progress.
-    static int count = 0;
-    if ((++count % 7506) == 0)
+    if (((++corner_progress_count % 7506) == 0) && print_corner_progress)
     {
-        int pct = count / 7506;
+        int pct = corner_progress_count / 7506;
         printf("%i%% done. ", pct);
         if (((pct % 7) == 0) || (pct == 100)) {
             printf("\n");
@@ -322,14 +541,16 @@ void PlaceCornerPiece(unsigned char corner_num, unsigned char pieces[CUBE_CORNER
             rotation_parity = (rotation_parity + ori) % 3;
 
             // Place the piece.
-            cube[corners[corner_num][0]] = corners[pieces[corner_num]][(0 + ori) % 3];
-            cube[corners[corner_num][1]] = corners[pieces[corner_num]][(1 + ori) % 3];
-            cube[corners[corner_num][2]] = corners[pieces[corner_num]][(2 + ori) % 3];
+            cube[corner_positions[corner_num][0]] = corners[pieces[corner_num]][(0 + ori) % 3];
+            cube[corner_positions[corner_num][1]] = corners[pieces[corner_num]][(1 + ori) % 3];
+            cube[corner_positions[corner_num][2]] = corners[pieces[corner_num]][(2 + ori) % 3];
+            ++corner_search_stats.nodes[corner_num];
 
             // Check to make sure that no corner surface has the same color as the center (no CORNERS_TOUCHING).
-            if ((ColorOf(cube[corners[corner_num][0]]) == ColorOf(corners[corner_num][0])) ||
-                (ColorOf(cube[corners[corner_num][1]]) == ColorOf(corners[corner_num][1])) ||
-                (ColorOf(cube[corners[corner_num][2]]) == ColorOf(corners[corner_num][2]))) {
+            if ((ColorOf(cube[corner_positions[corner_num][0]]) == ColorOf(corner_positions[corner_num][0])) ||
+                (ColorOf(cube[corner_positions[corner_num][1]]) == ColorOf(corner_positions[corner_num][1])) ||
+                (ColorOf(cube[corner_positions[corner_num][2]]) == ColorOf(corner_positions[corner_num][2]))) {
+                ++corner_search_stats.pruned[corner_num][CORNER_PRUNE_CENTER_COLOR];
                 // Undo rotation parity.
                 rotation_parity = (rotation_parity + 3 - ori) % 3;
                 continue;
@@ -337,12 +558,13 @@ void PlaceCornerPiece(unsigned char corner_num, unsigned char pieces[CUBE_CORNER
 
             // Check to make sure that we don't have 3 corner surfaces of the same color on a single face.
             bool three_same_color = false;
-            for (int i = corner_count_checks_start[corner_num]; (i <= corner_count_checks_end[corner_num]) && !three_same_color; ++i) {
+            for (int i = corner_count_checks_start[corner_num]; (i < corner_count_checks_end[corner_num]) && !three_same_color; ++i) {
                 three_same_color = (ColorOf(cube[corner_count_checks[i][0]]) == ColorOf(cube[corner_count_checks[i][1]])) &&
                     (ColorOf(cube[corner_count_checks[i][0]]) == ColorOf(cube[corner_count_checks[i][2]]));
             }
 
             if (three_same_color) {
+                ++corner_search_stats.pruned[corner_num][CORNER_PRUNE_THREE_OF_A_COLOR];
                 // Undo rotation parity.
                 rotation_parity = (rotation_parity + 3 - ori) % 3;
                 continue;
@@ -367,34 +589,115 @@ void PlaceCornerPiece(unsigned char corner_num, unsigned char pieces[CUBE_CORNER
 }
 
 
+bool CornerArrangementLess(const CornerArrangement& a, const CornerArrangement& b)
+{
+    return compareFaceIds(a.faceIds, b.faceIds, CUBE_FACES) < 0;
+}
+
+
+// Sort the arrangements by faceIds. Each thread sorts a slice, then neighbouring slices are merged until one is left.
+// No two arrangements have the same faceIds (the colors on the faces pin down every corner piece and its rotation),
+// so this gives the same order no matter how many threads there are.
+void SortCornerArrangements(CornerArrangement* corner_arrangements, int corner_arrangement_count, int thread_count)
+{
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    std::vector<int> bounds;
+    for (int i = 0; i <= thread_count; ++i) {
+        bounds.push_back((int)((long long)corner_arrangement_count * i / thread_count));
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([=]() {
+            std::sort(corner_arrangements + bounds[i], corner_arrangements + bounds[i + 1], CornerArrangementLess);
+        });
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    for (int width = 1; width < thread_count; width *= 2) {
+        threads.clear();
+        for (int i = 0; i + width < thread_count; i += 2 * width) {
+            int first = bounds[i];
+            int middle = bounds[i + width];
+            int last = bounds[(i + 2 * width < thread_count) ? (i + 2 * width) : thread_count];
+            threads.emplace_back([=]() {
+                std::inplace_merge(corner_arrangements + first, corner_arrangements + middle, corner_arrangements + last, CornerArrangementLess);
+            });
+        }
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+    }
+}
+
+
+// Fill out nextIndex for sorted arrangements. Working backwards, an arrangement that shares its first (index + 1) faceIds
+// with the one after it skips to the same place that one does. Otherwise it only needs to skip to the one after it.
 void FillCornerIndexes(CornerArrangement* corner_arrangements, int corner_arrangement_count) {
-    for (int arrangement = 0; arrangement < corner_arrangement_count; ++arrangement) {
+    for (int arrangement = corner_arrangement_count - 1; arrangement >= 0; --arrangement) {
+        int next_arrangement = arrangement + 1;
+
+        // The number of leading faceIds this arrangement shares with the next one.
+        int shared = 0;
+        if (next_arrangement < corner_arrangement_count) {
+            while ((shared < CUBE_FACES) && (corner_arrangements[arrangement].faceIds[shared] == corner_arrangements[next_arrangement].faceIds[shared])) {
+                ++shared;
+            }
+        }
+
         for (int index = 0; index < CUBE_FACES; ++index) {
-            if ((arrangement > 0) && (compareFaceIds(corner_arrangements[arrangement].faceIds, corner_arrangements[arrangement - 1].faceIds, index + 1) == 0)) {
-                corner_arrangements[arrangement].nextIndex[index] = corner_arrangements[arrangement - 1].nextIndex[index];
+            if (index < shared) {
+                corner_arrangements[arrangement].nextIndex[index] = corner_arrangements[next_arrangement].nextIndex[index];
+            }
+            else if (next_arrangement >= corner_arrangement_count) {
+                corner_arrangements[arrangement].nextIndex[index] = -1;
             }
             else {
-                int next_arrangement;
-                for (next_arrangement = arrangement + 1;
-                    (next_arrangement < corner_arrangement_count) &&
-                    (compareFaceIds(corner_arrangements[arrangement].faceIds, corner_arrangements[next_arrangement].faceIds, index + 1) == 0);
-                    ++next_arrangement);
-                if (next_arrangement >= corner_arrangement_count) {
-                    corner_arrangements[arrangement].nextIndex[index] = -1;
-                }
-                else {
-                    corner_arrangements[arrangement].nextIndex[index] = next_arrangement;
-                }
+                corner_arrangements[arrangement].nextIndex[index] = next_arrangement;
             }
         }
     }
 }
 
 
-void CreateCornerArrangements()
+// Move built arrangements into a search table: the keys the join reads in one array and the arrangements in another.
+void SplitCornerArrangements(const CornerArrangement* corner_arrangements, int corner_arrangement_count, CornerArrangementTable* table)
+{
+    CornerArrangementKey* keys = (CornerArrangementKey*)calloc(corner_arrangement_count, sizeof(CornerArrangementKey));
+    unsigned char (*arrangements)[CUBE_SURFACES] = (unsigned char (*)[CUBE_SURFACES])calloc(corner_arrangement_count, CUBE_SURFACES);
+    if ((keys == NULL) || (arrangements == NULL)) {
+        fprintf(stderr, "Out of memory for corner arrangements.\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < corner_arrangement_count; ++i) {
+        for (int face = 0; face < CUBE_FACES; ++face) {
+            keys[i].faceIds[face] = CornerFaceCode(corner_arrangements[i].faceIds[face]);
+            keys[i].nextIndex[face] = corner_arrangements[i].nextIndex[face];
+        }
+        memcpy(arrangements[i], corner_arrangements[i].arrangement, CUBE_SURFACES);
+    }
+
+    table->keys = keys;
+    table->arrangements = arrangements;
+    table->count = corner_arrangement_count;
+}
+
+
+void CreateCornerArrangements(int thread_count, bool print_progress)
 {
-    // The positions of the corner pieces. pieces[3] = 5 means that corner piece 5 is in corner piece 3's position.
-    unsigned char pieces[CUBE_CORNERS] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    FillCornerFaceIds();
+    FillEdgeFaceTables();
+
+    // The positions of the corner pieces. pieces[3] = 5 means that corner piece 5 is in the position filled at step 3. Every
+    // piece starts out in its own position, so the swap parity starts out even whatever the corner order is.
+    unsigned char pieces[CUBE_CORNERS];
+    memcpy(pieces, corner_order, sizeof(pieces));
 
     // The cube. Corners will be overwritten in PlaceCornerPiece().
     // Set corner surfaces to 99 for safety checks.
@@ -403,37 +706,144 @@ void CreateCornerArrangements()
     unsigned char cube[CUBE_SURFACES] = { 99, 0, 99, 0,  4, 0, 99, 0, 99, 99, 0, 99, 0, 13, 0, 99, 0, 99, 99, 0, 99, 0, 22, 0, 99, 0, 99,
                                           99, 0, 99, 0, 31, 0, 99, 0, 99, 99, 0, 99, 0, 40, 0, 99, 0, 99, 99, 0, 99, 0, 49, 0, 99, 0, 99 };
 
+    // Start from nothing, in case the arrangements were already created or read.
+    ep_corner_arrangement_count = 0;
+    op_corner_arrangement_count = 0;
+    corner_progress_count = 0;
+    print_corner_progress = print_progress;
+    ep_corner_arrangements = (CornerArrangement*)calloc(EP_CORNER_ARRANGEMENT_COUNT, sizeof(CornerArrangement));
+    op_corner_arrangements = (CornerArrangement*)calloc(OP_CORNER_ARRANGEMENT_COUNT, sizeof(CornerArrangement));
+    if ((ep_corner_arrangements == NULL) || (op_corner_arrangements == NULL)) {
+        fprintf(stderr, "Out of memory for corner arrangements.\n");
+        exit(1);
+    }
+
     PlaceCornerPiece(0, pieces, cube, 0, 0);
+    int pct = corner_progress_count / 7506;
+    if (print_progress && (pct % 7 != 0) && (pct != 100)) {
+        printf("\n");
+    }
+
+    SortCornerArrangements(ep_corner_arrangements, ep_corner_arrangement_count, thread_count);
+    SortCornerArrangements(op_corner_arrangements, op_corner_arrangement_count, thread_count);
 
     FillCornerIndexes(ep_corner_arrangements, ep_corner_arrangement_count);
     FillCornerIndexes(op_corner_arrangements, op_corner_arrangement_count);
+
+    SplitCornerArrangements(ep_corner_arrangements, ep_corner_arrangement_count, &ep_corner_table);
+    SplitCornerArrangements(op_corner_arrangements, op_corner_arrangement_count, &op_corner_table);
+    FillFirstIndexes(&ep_corner_table, ep_first_indexes);
+    FillFirstIndexes(&op_corner_table, op_first_indexes);
+    FreeAdjacentColors();
+    FillAdjacentColorsIfNeeded();
+
+    free(ep_corner_arrangements);
+    free(op_corner_arrangements);
+    ep_corner_arrangements = NULL;
+    op_corner_arrangements = NULL;
+}
+
+
+// The first corner face code at or after code that is set in matches. CORNER_FACE_CODES if there is none.
+inline int NextCornerFaceMatch(const unsigned long long* matches, int code)
+{
+    if (code >= CORNER_FACE_CODES) {
+        return CORNER_FACE_CODES;
+    }
+
+    int word = code / 64;
+    unsigned long long bits = matches[word] & (~0ULL << (code % 64));
+    while (bits == 0) {
+        if (++word == CORNER_FACE_MATCH_WORDS) {
+            return CORNER_FACE_CODES;
+        }
+        bits = matches[word];
+    }
+
+    return word * 64 + LowestBit(bits);
+}
+
+
+// The first key from first up to last whose faceIds[face_num] is code or more, or last if there is none. The keys in between
+// must share their earlier faceIds, so they're sorted by this one. The next match is usually close, so gallop forward first.
+inline int SkipToCornerFaceCode(const CornerArrangementKey* keys, int first, int last, int face_num, int code)
+{
+    int low = first;
+    int high = first;
+    for (int step = 1; (high < last) && (keys[high].faceIds[face_num] < code); step *= 2) {
+        low = high + 1;
+        high = low + step;
+    }
+    if (high > last) {
+        high = last;
+    }
+
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (keys[middle].faceIds[face_num] < code) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
 }
 
 
-int GetCornerArrangementsIndex(int index, CornerArrangement* corner_arrangements, unsigned int * face_ids, int face_id_count, int max_index)
+int GetCornerArrangementsIndex(int index, const CornerArrangementTable* table, const unsigned short* edge_face_codes, int face_id_count,
+                               const unsigned long long* edge_colors)
 {
-    if ((index > max_index) || (index == -1)) {
+    if ((index >= table->count) || (index == -1)) {
         return -1;
     }
 
-    for (int face_num = 0; face_num < face_id_count; ) {
-        int face_idx = corner_arrangements[index].faceIds[face_num] + face_ids[face_num];
-        __int16 face_id = face_table[face_idx];
-        bool valid = face_id < 16;
+    const CornerArrangementKey* keys = table->keys;
+    for (int face_num = 0; ; ) {
+        if (face_num == face_id_count) {
+            // Every face fits. The edge colors don't line up with the sort order, so an arrangement that touches them across
+            // two faces can only be stepped over.
+            if ((edge_colors == NULL) || !EdgeColorsOverlap(table->adjacent_colors[index], edge_colors)) {
+                return index;
+            }
+            if (++index >= table->count) {
+                return -1;
+            }
+            face_num = 0;
+            continue;
+        }
 
-        if (valid) {
+        const unsigned long long* matches = corner_face_matches[edge_face_codes[face_num]];
+        int code = keys[index].faceIds[face_num];
+
+        if ((matches[code / 64] & (1ULL << (code % 64))) != 0) {
             ++face_num;
+            continue;
+        }
+
+        // Skip straight to the next corner face code that matches. For the first face, first_indexes says where it starts.
+        // Otherwise look for it among the keys that share the codes for the earlier faces, which run up to nextIndex[face_num - 1].
+        int next_code = NextCornerFaceMatch(matches, code + 1);
+        if (face_num == 0) {
+            index = table->first_indexes[next_code];
         }
         else {
-            index = corner_arrangements[index].nextIndex[face_num];
-            if (index == -1) {
-                break;
+            int last = (int)keys[index].nextIndex[face_num - 1];
+            if (last == -1) {
+                last = table->count;
+            }
+
+            index = (next_code == CORNER_FACE_CODES) ? last : SkipToCornerFaceCode(keys, index + 1, last, face_num, next_code);
+            if (index == last) {
+                face_num = 0; // The earlier faces are different now, so they have to be checked again.
             }
-            face_num = 0;
         }
-    }
 
-    return index;
+        if (index >= table->count) {
+            return -1;
+        }
+    }
 }
 
 
@@ -451,36 +861,54 @@ int GetCornerArrangementsIndex(int index, CornerArrangement* corner_arrangements
 const unsigned char edges[CUBE_EDGES][2] = { { 52,  1 }, {  3, 10 }, {  5, 28 }, { 19,  7 }, { 48, 12 }, { 21, 14 },
                                            { 39, 16 }, { 23, 30 }, { 25, 37 }, { 50, 32 }, { 41, 34 }, { 46, 43 }};
 
-// Positions to check to ensure that no edge surfaces, touching at a diagonal, have the same color.
-const unsigned char edge_diagonal_checks[24][2] = { {  1,  3 }, {  1,  5 }, {  3,  7 }, {  5,  7 }, { 10, 12 }, { 48, 52 },
-                                                    { 10, 14 }, { 19, 21 }, { 12, 16 }, { 14, 16 }, { 19, 23 }, { 28, 30 },
-                                                    { 21, 25 }, { 23, 25 }, { 37, 39 }, { 28, 32 }, { 50, 52 }, { 30, 34 },
-                                                    { 32, 34 }, { 37, 41 }, { 39, 43 }, { 41, 43 }, { 46, 48 }, { 46, 50 }};
-
-// Once edge piece N is placed, apply edge diagonal checks from edge_diagonal_checks_start[N] through edge_diagonal_checks_ends[N].
-const unsigned char edge_diagonal_checks_start[CUBE_EDGES] = { 99, 0, 1, 2, 4, 6, 8, 10, 12, 15, 17, 20};
-const unsigned char edge_diagonal_checks_end  [CUBE_EDGES] = { 98, 0, 1, 3, 5, 7, 9, 11, 14, 16, 19, 23};
+// The checks the edge search makes after placing each piece are worked out from edge_order, in PlacementOrder.cpp.
 
-// Once edge piece N is places, apply face id checks from edge_face_id_checks_start[N] through edge_face_id_checks_end[N].
-const int edge_face_id_checks_start[CUBE_EDGES] = { -1, -1, -1, 0, -1, -1, 1, -1, 2, -1, 3, 4 };
-const int edge_face_id_checks_end  [CUBE_EDGES] = { -2, -2, -2, 0, -2, -1, 1, -2, 2, -2, 3, 5 };
+// Edge searches are split into tasks for the thread pool. Subtrees that start at an edge below EDGE_TASK_SEED_DEPTH
+// are always handed to the pool. Subtrees that start below EDGE_TASK_SPLIT_DEPTH are handed to the pool only when
+// a thread has run out of work. Deeper subtrees are too small to be worth the copy.
+const int EDGE_TASK_SEED_DEPTH = 2;
+const int EDGE_TASK_SPLIT_DEPTH = 8;
 
+// Totals over all edge search threads, filled in once TryEdgeArrangements() is done.
 unsigned long int edge_arrangements = 0;
 unsigned long int odd_edge_arrangements = 0;
 unsigned long int even_edge_arrangements = 0;
 char edge_ids[13] = "0123456789AB";
-char edge_progress[25] = "                        ";
+
+// The SEARCH_CRITERIA_* policy RunEdgeTask() searches with.
+int search_criteria = SEARCH_CRITERIA_DEFAULT;
+
+// Solution counts are shared by all edge search threads. Only touch them while holding solution_mutex.
+std::mutex solution_mutex;
+long int solution_counts[SOLUTION_CLASSES] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+long int total_solutions = 0;
+long int all_solution_counts[SOLUTION_CLASSES] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }; // Including symmetric solutions that weren't written.
+
+// A count-only search prints progress each time this many more solutions have been counted.
+const long int COUNT_PROGRESS_INTERVAL = 100000;
+
+// Every symmetry but the identity.
+const unsigned long long ALL_SYMMETRIES = ((1ULL << CUBE_SYMMETRIES) - 1) & ~1ULL;
 
 
-void RecordSolution(unsigned int face_ids[CUBE_FACES], unsigned char cube[CUBE_SURFACES], CornerArrangement* corner_arrangements, int corner_arrangements_index)
+// Print the solution counts so far, after the edges placed so far. Hold solution_mutex.
+void PrintSolutionProgress(const char* edge_progress)
 {
-    static long int solution_counts[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    printf("%s   solutions: ", edge_progress);
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        printf(" %i", solution_counts[i]);
+    }
+    printf("\n");
+}
 
-    // Get the face ids
+
+// The number of different face patterns in a solution.
+int CountUniquePatterns(const unsigned short* edge_face_codes, const CornerArrangementKey* key)
+{
     int unique_patterns = 6;
     __int16 solution_face_ids[CUBE_FACES] = { 0, 0, 0, 0, 0, 0 };
     for (int i = 0; i < CUBE_FACES; ++i) {
-        solution_face_ids[i] = face_table[face_ids[i] + corner_arrangements[corner_arrangements_index].faceIds[i]];
+        solution_face_ids[i] = PerfectPatternId(edge_face_ids[edge_face_codes[i]] + corner_face_ids[key->faceIds[i]]);
 
         for (int j = 0; j < i; ++j) {
             if (solution_face_ids[j] == solution_face_ids[i]) {
@@ -490,12 +918,37 @@ void RecordSolution(unsigned int face_ids[CUBE_FACES], unsigned char cube[CUBE_S
         }
     }
 
+    return unique_patterns;
+}
+
+
+// Put together the solution the corner join found and check it against the rest of the criteria. Fills in solution_cube,
+// and orbit[] with the solutions symmetric to it in a symmetry-reduced search, and returns its solution class, or -1 if it
+// isn't a solution after all. *orbit_size is how many solutions it stands for.
+template <typename Criteria>
+int EvaluateSolution(const EdgeSearchState* state, const CornerArrangementTable* table, int corner_arrangements_index, unsigned char solution_cube[CUBE_SURFACES],
+                     unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES], int* orbit_size)
+{
+    const unsigned char* cube = state->cube;
+    const unsigned char* arrangement = table->arrangements[corner_arrangements_index];
+    int unique_patterns = CountUniquePatterns(state->edge_face_codes, &table->keys[corner_arrangements_index]);
+    if (unique_patterns < Criteria::MIN_UNIQUE_PATTERNS) {
+        return -1;
+    }
+
     // Assemble the final cube.
-    unsigned char solution_cube[CUBE_SURFACES] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                                                   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                                                   0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
     for (int i = 0; i < CUBE_SURFACES; ++i) {
-        solution_cube[i] = cube[i] | corner_arrangements[corner_arrangements_index].arrangement[i];
+        solution_cube[i] = cube[i] | arrangement[i];
+    }
+
+    // A symmetry-reduced search only keeps the representative of each set of symmetric solutions. The edge search has
+    // already ruled out most of the others, but not ones that only differ from the representative in the corners.
+    *orbit_size = 1;
+    if (state->symmetry_mode != SYMMETRY_NONE) {
+        *orbit_size = GetSymmetricCubes(solution_cube, orbit);
+        if (*orbit_size == 0) {
+            return -1;
+        }
     }
 
     // Get the overall color connectedness.
@@ -503,227 +956,1753 @@ void RecordSolution(unsigned int face_ids[CUBE_FACES], unsigned char cube[CUBE_S
 
     if (connectedness < ADJACENT_FACES_TOUCHING) {
         fprintf(stderr, "Corners or sides touching in a solution cube. This should not have reached a solution.\n");
-        return;
+        return -1;
+    }
+    if (!Criteria::ADJACENT_FACES_MAY_TOUCH && (connectedness == ADJACENT_FACES_TOUCHING)) {
+        return -1;
     }
 
-    // Get the filename to save this result to.
-    char filename[100];
-    sprintf_s(filename, "Solutions_%i_patterns%s.txt", unique_patterns, ((connectedness == ADJACENT_FACES_TOUCHING) ? "" : "_Perfect"));
+    return SolutionClass(unique_patterns, connectedness);
+}
+
 
-    // Write the solution to the file.
-    FILE* fp = NULL;
-    errno_t result = fopen_s(&fp, filename, "a");
-    if ((result != 0) || (fp == NULL)) {
-        fprintf(stderr, "Unable to open solution file: %s\n", filename);
+// Record a solution the corner join found, if it meets the rest of the criteria.
+template <typename Criteria>
+void RecordSolution(EdgeSearchState* state, const CornerArrangementTable* table, int corner_arrangements_index)
+{
+    unsigned char solution_cube[CUBE_SURFACES];
+    unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES];
+    int orbit_size;
+    int solution_class = EvaluateSolution<Criteria>(state, table, corner_arrangements_index, solution_cube, orbit, &orbit_size);
+    if (solution_class < 0) {
         return;
     }
 
-    fprintf(fp, "%i", solution_cube[0]);
-    for (int i = 1; i < CUBE_SURFACES; ++i) {
-        fprintf(fp, ",%i", solution_cube[i]);
-    }
-    fprintf(fp, "\n");
-    fclose(fp);
-    fp = NULL;
+    // Queue the solution for its solution file, along with the symmetric ones when expanding.
+    // Solutions in a checkpoint unit wait for the rest of the unit.
+    int written = (state->symmetry_mode == SYMMETRY_EXPAND) ? orbit_size : 1;
+    if (state->unit != NULL) {
+        char records[CUBE_SYMMETRIES][CUBE_SURFACES * 3];
+        int lengths[CUBE_SYMMETRIES];
+        for (int i = 0; i < written; ++i) {
+            lengths[i] = FormatSinkSolution(records[i], (i == 0) ? solution_cube : orbit[i]);
+        }
 
-    static int total_solutions = 0;
-    ++total_solutions;
-    ++solution_counts[unique_patterns - 1 + ((connectedness == ADJACENT_FACES_TOUCHING) ? 0 : 6)];
-    if (((total_solutions % 100) == 0) || (connectedness == NOTHING_TOUCHING)) {
-        printf("%s   solutions: ", edge_progress);
-        for (int i = 0; i < 12; ++i) {
-            printf(" %i", solution_counts[i]);
+        std::lock_guard<std::mutex> lock(state->unit->mutex);
+        for (int i = 0; i < written; ++i) {
+            state->unit->solutions[solution_class].append(records[i], lengths[i]);
+        }
+        state->unit->totals.solution_counts[solution_class] += written;
+        state->unit->totals.all_solution_counts[solution_class] += orbit_size;
+    }
+    else {
+        for (int i = 0; i < written; ++i) {
+            WriteSolution(solution_class, (i == 0) ? solution_cube : orbit[i]);
         }
-        printf("\n");
     }
-}
 
+    std::lock_guard<std::mutex> lock(solution_mutex);
 
-void PlaceLastEdgePiece(unsigned char edge_num, unsigned char pieces[CUBE_EDGES], unsigned char cube[CUBE_SURFACES], unsigned char swap_parity, unsigned char flip_parity, unsigned int face_ids[CUBE_FACES], int corner_arrangements_index)
-{
-    // If placing the last piece, the piece and rotation are determined by the previous selections
-    unsigned char ori = flip_parity;
+    total_solutions += written;
+    solution_counts[solution_class] += written;
+    all_solution_counts[solution_class] += orbit_size;
+    if (state->print_progress && (((total_solutions / 100) != ((total_solutions - written) / 100)) || (solution_class >= SOLUTION_CLASSES / 2))) {
+        PrintSolutionProgress(state->edge_progress);
+    }
+}
 
-    cube[edges[edge_num][0]] = edges[pieces[edge_num]][ori];
-    cube[edges[edge_num][1]] = edges[pieces[edge_num]][1 ^ ori];
 
-    edge_progress[2 * edge_num] = edge_ids[pieces[edge_num]];
-    edge_progress[2 * edge_num + 1] = ori ? '-' : '_';
+// RecordSolution() for a count-only search. Every face of a solution is already perfect, so all GetColorConnectedness()
+// would have left to find is adjacent faces touching at a corner. Those pairs are compared straight from the edges and the
+// corner arrangement, without putting the cube together, unless a symmetry-reduced search needs the cube for its symmetric
+// ones. The counts stay in the state until FlushSolutionCounts().
+template <typename Criteria>
+void CountSolution(EdgeSearchState* state, const CornerArrangementTable* table, int corner_arrangements_index)
+{
+    const unsigned char* cube = state->cube;
+    const unsigned char* arrangement = table->arrangements[corner_arrangements_index];
+    int unique_patterns = CountUniquePatterns(state->edge_face_codes, &table->keys[corner_arrangements_index]);
+    if (unique_patterns < Criteria::MIN_UNIQUE_PATTERNS) {
+        return;
+    }
 
-    // Check to make sure that no edge surface has the same color as the center (no SIDES_TOUCHING).
-    if ((ColorOf(cube[edges[edge_num][0]]) == ColorOf(edges[edge_num][0])) ||
-        (ColorOf(cube[edges[edge_num][1]]) == ColorOf(edges[edge_num][1]))) {
-        edge_progress[2 * edge_num] = ' ';
-        edge_progress[2 * edge_num + 1] = ' ';
+    int connectedness = NOTHING_TOUCHING;
+    for (int i = 0; i < 48; ++i) {
+        if ((cube[face_corner_pairs[i][0]] / 9) == (arrangement[face_corner_pairs[i][1]] / 9)) {
+            connectedness = ADJACENT_FACES_TOUCHING;
+            break;
+        }
+    }
+    if (!Criteria::ADJACENT_FACES_MAY_TOUCH && (connectedness == ADJACENT_FACES_TOUCHING)) {
         return;
     }
 
-    // Check to make sure that two edge surfaces, touching at a diagonal, don't have the same color.
-    for (int i = edge_diagonal_checks_start[edge_num]; (i <= edge_diagonal_checks_end[edge_num]); ++i) {
-        if (ColorOf(cube[edge_diagonal_checks[i][0]]) == ColorOf(cube[edge_diagonal_checks[i][1]])) {
-            edge_progress[2 * edge_num] = ' ';
-            edge_progress[2 * edge_num + 1] = ' ';
+    int orbit_size = 1;
+    if (state->symmetry_mode != SYMMETRY_NONE) {
+        unsigned char solution_cube[CUBE_SURFACES];
+        for (int i = 0; i < CUBE_SURFACES; ++i) {
+            solution_cube[i] = cube[i] | arrangement[i];
+        }
+        unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES];
+        orbit_size = GetSymmetricCubes(solution_cube, orbit);
+        if (orbit_size == 0) {
             return;
         }
     }
 
-    // Fill out the edges' contribution to each face ids.
-    for (int face_index = edge_face_id_checks_start[edge_num]; face_index <= edge_face_id_checks_end[edge_num]; ++face_index) {
-        int start = face_index * 9;
-        face_ids[face_index] = ((((cube[start + 1] / 9) * CUBE_COLORS_SQ + (cube[start + 3] / 9)) * CUBE_COLORS_SQ + (cube[start + 5] / 9)) * CUBE_COLORS_SQ + (cube[start + 7] / 9)) * CUBE_COLORS;
-    }
+    int solution_class = SolutionClass(unique_patterns, connectedness);
+    state->counts.solution_counts[solution_class] += (state->symmetry_mode == SYMMETRY_EXPAND) ? orbit_size : 1;
+    state->counts.all_solution_counts[solution_class] += orbit_size;
+}
 
-    ++edge_arrangements;
-    if (swap_parity == 0)
-        ++even_edge_arrangements;
-    else
-        ++odd_edge_arrangements;
 
-    CornerArrangement* arrangements = (swap_parity == 0) ? ep_corner_arrangements : op_corner_arrangements;
-    int max_index = ((swap_parity == 0) ? EP_CORNER_ARRANGEMENT_COUNT : OP_CORNER_ARRANGEMENT_COUNT) - 1;
-    corner_arrangements_index = GetCornerArrangementsIndex(corner_arrangements_index, arrangements, face_ids, edge_face_id_checks_end[edge_num] + 1, max_index);
+// Add what a count-only search has counted on this thread to the shared solution counts.
+void FlushSolutionCounts(EdgeSearchState* state)
+{
+    std::lock_guard<std::mutex> lock(solution_mutex);
 
-    while (corner_arrangements_index != -1) {
-        RecordSolution(face_ids, cube, arrangements, corner_arrangements_index);
-        if (corner_arrangements_index >= max_index) {
-            break;
-        }
-        corner_arrangements_index = GetCornerArrangementsIndex(corner_arrangements_index + 1, arrangements, face_ids, edge_face_id_checks_end[edge_num] + 1, max_index);
+    long int counted = 0;
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        solution_counts[i] += (long int)state->counts.solution_counts[i];
+        all_solution_counts[i] += (long int)state->counts.all_solution_counts[i];
+        counted += (long int)state->counts.solution_counts[i];
     }
+    total_solutions += counted;
+    InitSearchTotals(&state->counts);
 
-    edge_progress[2 * edge_num] = ' ';
-    edge_progress[2 * edge_num + 1] = ' ';
+    if (state->print_progress && ((total_solutions / COUNT_PROGRESS_INTERVAL) != ((total_solutions - counted) / COUNT_PROGRESS_INTERVAL))) {
+        PrintSolutionProgress(state->edge_progress);
+    }
 }
 
 
-void PlaceEdgePiece(unsigned char edge_num, unsigned char pieces[CUBE_EDGES], unsigned char cube[CUBE_SURFACES], unsigned char swap_parity, unsigned char flip_parity, unsigned int face_ids[CUBE_FACES], int ep_corner_arrangements_index, int op_corner_arrangements_index)
+// GetCornerArrangementsIndex() for the edge search. Logs the probe first if the state is recording them.
+inline int JoinCornerArrangements(EdgeSearchState* state, int index, unsigned char swap_parity, int face_id_count, const unsigned long long* edge_colors)
 {
-    if (edge_num == 11) {
-        PlaceLastEdgePiece(edge_num, pieces, cube, swap_parity, flip_parity, face_ids, (swap_parity == 0) ? ep_corner_arrangements_index : op_corner_arrangements_index);
+    if (state->join_probes != NULL) {
+        JoinProbe probe;
+        probe.index = index;
+        memcpy(probe.edge_face_codes, state->edge_face_codes, sizeof(probe.edge_face_codes));
+        probe.face_id_count = face_id_count;
+        probe.swap_parity = swap_parity;
+        state->join_probes->push_back(probe);
     }
 
-    // Select corner piece.
-    for (int pos = edge_num; pos < CUBE_EDGES; ++pos) {
-        unsigned char temp;
-
-        if (pos != edge_num) {
-            // Swap the piece into place in the pieces array.
-            temp = pieces[edge_num];
-            pieces[edge_num] = pieces[pos];
-            pieces[pos] = temp;
+    const CornerArrangementTable* table = (swap_parity == 0) ? &ep_corner_table : &op_corner_table;
+    int result = GetCornerArrangementsIndex(index, table, state->edge_face_codes, face_id_count, edge_colors);
+    ++state->stats.joins;
+    if (result != -1) {
+        state->stats.join_skipped_keys += result - index;
+    }
+    return result;
+}
 
-            // Track swap parity.
-            swap_parity ^= 1;
-        }
+
+// Add the colors of the edge placed at edge_num to the ones before it, for a perfect-only search's join.
+inline void AddEdgeColors(EdgeSearchState* state, unsigned char edge_num)
+{
+    const unsigned char* cube = state->cube;
+    unsigned long long* colors = state->edge_colors[edge_num + 1];
+    memcpy(colors, state->edge_colors[edge_num], sizeof(state->edge_colors[edge_num]));
+    for (int side = 0; side < 2; ++side) {
+        int surface = edge_positions[edge_num][side];
+        int bit = edge_color_bits[surface] + cube[surface] / 9;
+        colors[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+
+// The edge lanes hold each face's edge surfaces in the order 1, 3, 7, 5, a nibble each, so the pairs that touch at a
+// diagonal are each nibble and the next one round its group. Faces 0-3 are in the first word and 4-5 in the second. A
+// surface that isn't filled yet holds 8 plus its place in the group, which can't match a color or another empty surface.
+const unsigned long long EDGE_LANES_EMPTY = 0xBA98BA98BA98BA98ULL;
+// Each face's center color in every nibble of its group. The two groups past face 5 hold 0, which can't match 8 - 11.
+const unsigned long long edge_lane_centers[EDGE_LANE_WORDS] = { 0x3333222211110000ULL, 0x0000000055554444ULL };
+// The nibble for each edge surface: word lane / 16, bits (lane % 16) * 4 and up.
+const unsigned char edge_surface_lanes[CUBE_SURFACES] = { 0,  0, 0,  1, 0,  3, 0,  2, 0,
+                                                          0,  4, 0,  5, 0,  7, 0,  6, 0,
+                                                          0,  8, 0,  9, 0, 11, 0, 10, 0,
+                                                          0, 12, 0, 13, 0, 15, 0, 14, 0,
+                                                          0, 16, 0, 17, 0, 19, 0, 18, 0,
+                                                          0, 20, 0, 21, 0, 23, 0, 22, 0 };
+
+
+// Does any nibble of x hold 0? If none does, subtracting 1 from each never borrows, and only leaves the top bit set in nibbles
+// that had it set already. Otherwise the lowest 0 turns into F.
+inline bool HasZeroNibble(unsigned long long x)
+{
+    return ((x - 0x1111111111111111ULL) & ~x & 0x8888888888888888ULL) != 0;
+}
+
+
+// edge_lane_changes[position][piece][ori] turns the empty nibbles for an edge position into the colors of a piece put there
+// with an orientation, when XOR'ed into the lanes.
+unsigned long long edge_lane_changes[CUBE_EDGES][CUBE_EDGES][2][EDGE_LANE_WORDS];
+
+
+void FillEdgeLaneChanges()
+{
+    memset(edge_lane_changes, 0, sizeof(edge_lane_changes));
+    for (int position = 0; position < CUBE_EDGES; ++position) {
+        for (int piece = 0; piece < CUBE_EDGES; ++piece) {
+            for (int ori = 0; ori < 2; ++ori) {
+                for (int side = 0; side < 2; ++side) {
+                    int lane = edge_surface_lanes[edges[position][side]];
+                    int color = ColorOf(edges[piece][side ^ ori]);
+                    edge_lane_changes[position][piece][ori][lane / 16] |= (unsigned long long)((8 + lane % 4) ^ color) << ((lane % 16) * 4);
+                }
+            }
+        }
+    }
+}
+
+
+// Fill in the colors of the edge placed at edge_num with orientation ori on top of the edges before it.
+inline void AddEdgeLanes(EdgeSearchState* state, unsigned char edge_num, int ori)
+{
+    const unsigned long long* changes = edge_lane_changes[edge_order[edge_num]][state->pieces[edge_num]][ori];
+    state->edge_lanes[edge_num + 1][0] = state->edge_lanes[edge_num][0] ^ changes[0];
+    state->edge_lanes[edge_num + 1][1] = state->edge_lanes[edge_num][1] ^ changes[1];
+}
+
+
+// Is any edge surface in a word of lanes the color of its face's center?
+inline bool EdgeLanesTouchCenters(const unsigned long long* lanes, int word)
+{
+    return HasZeroNibble(lanes[word] ^ edge_lane_centers[word]);
+}
+
+
+// Do any two edge surfaces in a word of lanes touch at a diagonal with the same color? Turning each group by a nibble lines
+// every surface up with the next one round.
+inline bool EdgeLanesTouchDiagonally(const unsigned long long* lanes, int word)
+{
+    unsigned long long turned = ((lanes[word] >> 4) & 0x0FFF0FFF0FFF0FFFULL) | ((lanes[word] << 12) & 0xF000F000F000F000ULL);
+    return HasZeroNibble(lanes[word] ^ turned);
+}
+
+
+EdgeHalfTable edge_half_table;
+
+// What each edge surface's color is multiplied by in its face's edge face code.
+const unsigned short edge_code_weights[9] = { 0, CUBE_COLORS * CUBE_COLORS_SQ, 0, CUBE_COLORS_SQ, 0, CUBE_COLORS, 0, 1, 0 };
+
+
+// Fill in the second half from step on with every piece that isn't used yet, both ways round, and add each one that passes
+// the checks among its own edges. lanes holds the edges of the half placed so far, over empty lanes.
+void AddEdgeHalves(EdgeHalf* half, int step, int used, const unsigned long long* lanes, std::vector<EdgeHalf>* halves)
+{
+    if (step == CUBE_EDGES) {
+        half->lanes[0] = lanes[0] ^ EDGE_LANES_EMPTY;
+        half->lanes[1] = lanes[1] ^ EDGE_LANES_EMPTY;
+        memset(half->face_codes, 0, sizeof(half->face_codes));
+        half->swap_parity = 0;
+        for (int k = 0; k < EDGE_HALF_EDGES; ++k) {
+            int ori = (half->oris >> k) & 1;
+            for (int side = 0; side < 2; ++side) {
+                int surface = edge_positions[EDGE_HALF_DEPTH + k][side];
+                half->face_codes[surface / 9] += ColorOf(edges[half->pieces[k]][side ^ ori]) * edge_code_weights[surface % 9];
+            }
+            for (int j = k + 1; j < EDGE_HALF_EDGES; ++j) {
+                half->swap_parity ^= (edge_half_table.steps[half->pieces[k]] > edge_half_table.steps[half->pieces[j]]) ? 1 : 0;
+            }
+        }
+        halves->push_back(*half);
+        return;
+    }
+
+    int k = step - EDGE_HALF_DEPTH;
+    for (int piece = 0; piece < CUBE_EDGES; ++piece) {
+        if ((used & (1 << piece)) != 0) {
+            continue;
+        }
+        for (int ori = 0; ori < 2; ++ori) {
+            const unsigned long long* changes = edge_lane_changes[edge_order[step]][piece][ori];
+            unsigned long long next[EDGE_LANE_WORDS] = { lanes[0] ^ changes[0], lanes[1] ^ changes[1] };
+            if (EdgeLanesTouchCenters(next, 0) || EdgeLanesTouchCenters(next, 1) || EdgeLanesTouchDiagonally(next, 0) || EdgeLanesTouchDiagonally(next, 1)) {
+                continue;
+            }
+            half->pieces[k] = (unsigned char)piece;
+            half->oris = (unsigned char)((half->oris & ~(1 << k)) | (ori << k));
+            AddEdgeHalves(half, step + 1, used | (1 << piece), next, halves);
+        }
+    }
+}
+
+
+// The group a half goes in, in edge_half_table.first_halves.
+int EdgeHalfGroup(const EdgeHalf& half)
+{
+    int pieces = 0;
+    int flip_parity = 0;
+    for (int k = 0; k < EDGE_HALF_EDGES; ++k) {
+        pieces |= 1 << half.pieces[k];
+        flip_parity ^= (half.oris >> k) & 1;
+    }
+    return pieces * 2 + flip_parity;
+}
+
+
+void BuildEdgeHalves()
+{
+    EdgeHalfTable* table = &edge_half_table;
+    for (int step = 0; step < CUBE_EDGES; ++step) {
+        table->steps[edge_order[step]] = (unsigned char)step;
+    }
+
+    // The faces the first half completes come before the key face.
+    table->key_rank = 0;
+    for (int step = 0; step < EDGE_HALF_DEPTH; ++step) {
+        if (edge_face_id_checks_start[step] >= 0) {
+            table->key_rank = edge_face_id_checks_end[step] + 1;
+        }
+    }
+
+    table->halves.clear();
+    EdgeHalf half;
+    memset(&half, 0, sizeof(half));
+    const unsigned long long empty[EDGE_LANE_WORDS] = { EDGE_LANES_EMPTY, EDGE_LANES_EMPTY };
+    AddEdgeHalves(&half, EDGE_HALF_DEPTH, 0, empty, &table->halves);
+
+    std::vector<int> groups(table->halves.size());
+    std::vector<int> order(table->halves.size());
+    for (size_t i = 0; i < table->halves.size(); ++i) {
+        groups[i] = EdgeHalfGroup(table->halves[i]);
+        order[i] = (int)i;
+    }
+    int key_face = face_completion_order[table->key_rank];
+    const std::vector<EdgeHalf>& halves = table->halves;
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (groups[a] != groups[b]) {
+            return groups[a] < groups[b];
+        }
+        return halves[a].face_codes[key_face] < halves[b].face_codes[key_face];
+    });
+
+    std::vector<EdgeHalf> sorted(halves.size());
+    table->first_halves.assign((1 << CUBE_EDGES) * 2 + 1, 0);
+    for (size_t i = 0; i < order.size(); ++i) {
+        sorted[i] = halves[order[i]];
+        ++table->first_halves[groups[order[i]] + 1];
+    }
+    for (size_t i = 1; i < table->first_halves.size(); ++i) {
+        table->first_halves[i] += table->first_halves[i - 1];
+    }
+    table->halves.swap(sorted);
+}
+
+
+// Compare the edges placed so far with where each symmetry still in symmetry_masks[edge_num] would move them, in the order
+// CompareSymmetryKeys() uses. Symmetries that already make the cube come later can't make it come earlier once more pieces
+// are placed, so they are left out of symmetry_masks[edge_num + 1]. Returns false if some symmetry makes the cube come
+// earlier, whatever the rest of the pieces are: it isn't a representative.
+inline bool CheckEdgeSymmetries(EdgeSearchState* state, unsigned char edge_num)
+{
+    unsigned long long mask = state->symmetry_masks[edge_num];
+    const unsigned char* cube = state->cube;
+    int placed = edge_num + 1;
+
+    for (unsigned long long remaining = mask; remaining != 0; remaining &= remaining - 1) {
+        int symmetry = 0;
+        while (((remaining >> symmetry) & 1) == 0) {
+            ++symmetry;
+        }
+
+        for (int k = 0; k < placed; ++k) {
+            if (symmetry_edge_sources[symmetry][k] >= placed) {
+                break; // Can't tell yet.
+            }
+
+            unsigned char moved = symmetry_surfaces[symmetry][cube[symmetry_edge_source_surfaces[symmetry][k]]];
+            unsigned char current = cube[edge_positions[k][0]];
+            if (moved < current) {
+                return false;
+            }
+            if (moved > current) {
+                mask &= ~(1ULL << symmetry);
+                break;
+            }
+        }
+    }
+
+    state->symmetry_masks[edge_num + 1] = mask;
+    return true;
+}
+
+
+// Count the last edge as pruned by the corner join if the join found nothing, given the solution count from before it.
+inline void CountLastEdgeSolutions(EdgeSearchState* state, unsigned char edge_num, unsigned long int solutions)
+{
+    if (state->solutions == solutions) {
+        ++state->stats.pruned[edge_num][PRUNE_FACE_JOIN];
+    }
+}
+
+
+// Join the corners to a complete edge arrangement in state->cube and state->edge_face_codes, starting from the first
+// arrangement with its swap parity that fits the faces completed before the last edge, and find its solutions.
+template <typename Criteria>
+void JoinLastEdge(EdgeSearchState* state, unsigned char swap_parity, int corner_arrangements_index, const unsigned long long* edge_colors)
+{
+    const unsigned short* edge_face_codes = state->edge_face_codes;
+    const CornerArrangementTable* table = (swap_parity == 0) ? &ep_corner_table : &op_corner_table;
+
+    if (state->corner_bitsets != NULL) {
+        // Whatever is left after the first four faces, and fits the last two, is a solution. The bits come out in index order,
+        // the same order the walk finds them in.
+        const CornerBitset* left = &state->corner_bitsets->faces[2][swap_parity];
+        int last_face_ids[2] = { face_completion_order[4], face_completion_order[5] };
+        const unsigned long long* last_faces[2] = { GetCornerBitset(swap_parity, last_face_ids[0], edge_face_codes[last_face_ids[0]]),
+                                                    GetCornerBitset(swap_parity, last_face_ids[1], edge_face_codes[last_face_ids[1]]) };
+        if ((last_faces[0] != NULL) && (last_faces[1] != NULL)) {
+            for (int i = 0; i < left->count; ++i) {
+                int word = left->indexes[i];
+                for (unsigned long long bits = left->words[i] & last_faces[0][word] & last_faces[1][word]; bits != 0; bits &= bits - 1) {
+                    int index = word * 64 + LowestBit(bits);
+                    if (!Criteria::ADJACENT_FACES_MAY_TOUCH && EdgeColorsOverlap(table->adjacent_colors[index], edge_colors)) {
+                        continue;
+                    }
+                    ++state->solutions;
+                    if (state->count_only) {
+                        CountSolution<Criteria>(state, table, index);
+                    }
+                    else if (state->record_solutions) {
+                        RecordSolution<Criteria>(state, table, index);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    int face_id_count = edge_face_id_checks_end[CUBE_EDGES - 1] + 1;
+    corner_arrangements_index = JoinCornerArrangements(state, corner_arrangements_index, swap_parity, face_id_count, edge_colors);
+
+    while (corner_arrangements_index != -1) {
+        ++state->solutions;
+        if (state->count_only) {
+            CountSolution<Criteria>(state, table, corner_arrangements_index);
+        }
+        else if (state->record_solutions) {
+            RecordSolution<Criteria>(state, table, corner_arrangements_index);
+        }
+        if (corner_arrangements_index >= table->count - 1) {
+            break;
+        }
+        corner_arrangements_index = JoinCornerArrangements(state, corner_arrangements_index + 1, swap_parity, face_id_count, edge_colors);
+    }
+}
+
+
+// Put the last piece in place, the way round the flip parity says, and check it. If it passes, fill in the faces it completes
+// and, in a perfect-only search, its colors, ready for JoinLastEdge(), and count the edge arrangement. Returns false if the
+// piece can't go there. Either way the progress string shows the piece until the caller clears it.
+template <typename Criteria>
+bool PlaceLastEdge(EdgeSearchState* state, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity)
+{
+    unsigned char* pieces = state->pieces;
+    unsigned char* cube = state->cube;
+    unsigned short* edge_face_codes = state->edge_face_codes;
+    char* edge_progress = state->edge_progress;
+
+    // If placing the last piece, the piece and rotation are determined by the previous selections
+    unsigned char ori = flip_parity;
+
+    cube[edge_positions[edge_num][0]] = edges[pieces[edge_num]][ori];
+    cube[edge_positions[edge_num][1]] = edges[pieces[edge_num]][1 ^ ori];
+
+    edge_progress[2 * edge_num] = edge_ids[pieces[edge_num]];
+    edge_progress[2 * edge_num + 1] = ori ? '-' : '_';
+    ++state->stats.nodes[edge_num];
+
+    // Check to make sure that no edge surface has the same color as the center (no SIDES_TOUCHING).
+    // Only the words with the edge's two faces can have changed.
+    AddEdgeLanes(state, edge_num, ori);
+    const unsigned long long* lanes = state->edge_lanes[edge_num + 1];
+    int first_word = edge_surface_lanes[edge_positions[edge_num][0]] / 16;
+    int second_word = edge_surface_lanes[edge_positions[edge_num][1]] / 16;
+    if (EdgeLanesTouchCenters(lanes, first_word) || ((second_word != first_word) && EdgeLanesTouchCenters(lanes, second_word))) {
+        ++state->stats.pruned[edge_num][PRUNE_CENTER_COLOR];
+        return false;
+    }
+
+    // Check to make sure that two edge surfaces, touching at a diagonal, don't have the same color.
+    if (EdgeLanesTouchDiagonally(lanes, first_word) || ((second_word != first_word) && EdgeLanesTouchDiagonally(lanes, second_word))) {
+        ++state->stats.pruned[edge_num][PRUNE_EDGE_DIAGONAL];
+        return false;
+    }
+
+    // Skip the corner join if this can't be a representative.
+    if ((state->symmetry_masks[edge_num] != 0) && !CheckEdgeSymmetries(state, edge_num)) {
+        ++state->stats.pruned[edge_num][PRUNE_SYMMETRY];
+        return false;
+    }
+
+    // A perfect-only search joins on every edge color too.
+    if (!Criteria::ADJACENT_FACES_MAY_TOUCH) {
+        AddEdgeColors(state, edge_num);
+    }
+
+    // Fill out the edges' contribution to each face.
+    for (int rank = edge_face_id_checks_start[edge_num]; rank <= edge_face_id_checks_end[edge_num]; ++rank) {
+        int start = face_completion_order[rank] * 9;
+        edge_face_codes[face_completion_order[rank]] = (((cube[start + 1] / 9) * CUBE_COLORS + (cube[start + 3] / 9)) * CUBE_COLORS + (cube[start + 5] / 9)) * CUBE_COLORS + (cube[start + 7] / 9);
+    }
+
+    ++state->edge_arrangements;
+    if (swap_parity == 0)
+        ++state->even_edge_arrangements;
+    else
+        ++state->odd_edge_arrangements;
+    return true;
+}
+
+
+template <typename Criteria>
+void PlaceLastEdgePiece(EdgeSearchState* state, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity, int corner_arrangements_index)
+{
+    if (PlaceLastEdge<Criteria>(state, edge_num, swap_parity, flip_parity)) {
+        unsigned long int solutions = state->solutions;
+        JoinLastEdge<Criteria>(state, swap_parity, corner_arrangements_index, Criteria::ADJACENT_FACES_MAY_TOUCH ? NULL : state->edge_colors[edge_num + 1]);
+        CountLastEdgeSolutions(state, edge_num, solutions);
+    }
+
+    state->edge_progress[2 * edge_num] = ' ';
+    state->edge_progress[2 * edge_num + 1] = ' ';
+}
+
+
+// Put the piece in pieces[edge_num] at edge_num with the given orientation, and check it. If it passes and completes any faces,
+// narrow the corner arrangement indices down to the first arrangements that still fit. Returns false if the piece can't go there.
+// Every search criteria policy keeps criteria 3 and 4, so the checks here are the same whichever one the search runs with.
+template <typename Criteria>
+inline bool PlaceEdge(EdgeSearchState* state, unsigned char edge_num, int ori, int* ep_corner_arrangements_index, int* op_corner_arrangements_index)
+{
+    unsigned char* pieces = state->pieces;
+    unsigned char* cube = state->cube;
+    unsigned short* edge_face_codes = state->edge_face_codes;
+
+    // Place the piece.
+    cube[edge_positions[edge_num][0]] = edges[pieces[edge_num]][ori];
+    cube[edge_positions[edge_num][1]] = edges[pieces[edge_num]][1 ^ ori];
+
+    // Check to make sure that no edge surface has the same color as the center (no SIDES_TOUCHING).
+    // Only the words with the edge's two faces can have changed.
+    AddEdgeLanes(state, edge_num, ori);
+    const unsigned long long* lanes = state->edge_lanes[edge_num + 1];
+    int first_word = edge_surface_lanes[edge_positions[edge_num][0]] / 16;
+    int second_word = edge_surface_lanes[edge_positions[edge_num][1]] / 16;
+    if (EdgeLanesTouchCenters(lanes, first_word) || ((second_word != first_word) && EdgeLanesTouchCenters(lanes, second_word))) {
+        ++state->stats.pruned[edge_num][PRUNE_CENTER_COLOR];
+        return false;
+    }
+
+    // Check to make sure that two edge surfaces, touching at a diagonal, don't have the same color.
+    if (EdgeLanesTouchDiagonally(lanes, first_word) || ((second_word != first_word) && EdgeLanesTouchDiagonally(lanes, second_word))) {
+        ++state->stats.pruned[edge_num][PRUNE_EDGE_DIAGONAL];
+        return false;
+    }
+
+    // In a symmetry-reduced search, check that this can still be a representative.
+    state->symmetry_masks[edge_num + 1] = 0;
+    if ((state->symmetry_masks[edge_num] != 0) && !CheckEdgeSymmetries(state, edge_num)) {
+        ++state->stats.pruned[edge_num][PRUNE_SYMMETRY];
+        return false;
+    }
+
+    const unsigned long long* edge_colors = NULL;
+    if (!Criteria::ADJACENT_FACES_MAY_TOUCH) {
+        AddEdgeColors(state, edge_num);
+        edge_colors = state->edge_colors[edge_num + 1];
+    }
+
+    if (edge_face_id_checks_start[edge_num] >= 0) {
+        int face_id_count = edge_face_id_checks_end[edge_num] + 1;
+        // Fill out the edges' contribution to each face.
+        for (int rank = edge_face_id_checks_start[edge_num]; rank < face_id_count; ++rank) {
+            int start = face_completion_order[rank] * 9;
+            edge_face_codes[face_completion_order[rank]] = (((cube[start + 1] / 9) * CUBE_COLORS + (cube[start + 3] / 9)) * CUBE_COLORS + (cube[start + 5] / 9)) * CUBE_COLORS + (cube[start + 7] / 9);
+        }
+
+        // The bitset join keeps its own record of what's left, so the indices aren't used.
+        if (state->corner_bitsets != NULL) {
+            for (int rank = edge_face_id_checks_start[edge_num]; rank < face_id_count; ++rank) {
+                if (!AndCornerBitsets(state->corner_bitsets, rank, face_completion_order[rank], edge_face_codes[face_completion_order[rank]])) {
+                    ++state->stats.pruned[edge_num][PRUNE_FACE_JOIN];
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        *ep_corner_arrangements_index = JoinCornerArrangements(state, *ep_corner_arrangements_index, 0, face_id_count, edge_colors);
+        *op_corner_arrangements_index = JoinCornerArrangements(state, *op_corner_arrangements_index, 1, face_id_count, edge_colors);
+        if ((*ep_corner_arrangements_index == -1) && (*op_corner_arrangements_index == -1)) {
+            ++state->stats.pruned[edge_num][PRUNE_FACE_JOIN];
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Join the partial edge arrangement placed so far, EDGE_HALF_DEPTH edges deep, to every second half in state->edge_halves
+// that uses the pieces left and evens out the flip parity, instead of searching below it. The same edge arrangements count,
+// and the same solutions are found, as searching below it would find, in a different order.
+template <typename Criteria>
+void JoinEdgeHalves(EdgeSearchState* state, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index)
+{
+    const EdgeHalfTable* table = state->edge_halves;
+    const unsigned char* pieces = state->pieces;
+    unsigned char* cube = state->cube;
+    unsigned short* edge_face_codes = state->edge_face_codes;
+    char* edge_progress = state->edge_progress;
+    const int last_edge = CUBE_EDGES - 1;
+
+    // The pieces left, and the parity of the order they are in, which each half's own parity is measured from.
+    int left = 0;
+    unsigned char left_parity = 0;
+    for (int k = EDGE_HALF_DEPTH; k < CUBE_EDGES; ++k) {
+        left |= 1 << pieces[k];
+        for (int j = k + 1; j < CUBE_EDGES; ++j) {
+            left_parity ^= (table->steps[pieces[k]] > table->steps[pieces[j]]) ? 1 : 0;
+        }
+    }
+
+    // The first half's part of each face's edge face code.
+    unsigned short first_codes[CUBE_FACES] = { 0, 0, 0, 0, 0, 0 };
+    for (int k = 0; k < EDGE_HALF_DEPTH; ++k) {
+        for (int side = 0; side < 2; ++side) {
+            int surface = edge_positions[k][side];
+            first_codes[surface / 9] += (cube[surface] / 9) * edge_code_weights[surface % 9];
+        }
+    }
+
+    const EdgeHalf* halves = table->halves.data();
+    int group = left * 2 + flip_parity;
+    int end = table->first_halves[group + 1];
+    state->stats.nodes[last_edge] += end - table->first_halves[group];
+
+    const unsigned long long* first_lanes = state->edge_lanes[EDGE_HALF_DEPTH];
+    const unsigned long long* first_colors = Criteria::ADJACENT_FACES_MAY_TOUCH ? NULL : state->edge_colors[EDGE_HALF_DEPTH];
+    int key_rank = table->key_rank;
+    int key_face = face_completion_order[key_rank];
+    // The search joins the faces completed before the last edge for both swap parities. An edge arrangement counts once some
+    // corner arrangement fits those.
+    const int joined_faces = CUBE_FACES - 2;
+    int joined_colors = last_edge;
+    for (int step = 0; step < last_edge; ++step) {
+        if (edge_face_id_checks_end[step] == joined_faces - 1) {
+            joined_colors = step + 1;
+        }
+    }
+
+    for (int run_start = table->first_halves[group], run_end; run_start < end; run_start = run_end) {
+        unsigned short key = halves[run_start].face_codes[key_face];
+        run_end = run_start + 1;
+        while ((run_end < end) && (halves[run_end].face_codes[key_face] == key)) {
+            ++run_end;
+        }
+
+        // Join the key face once for the whole run.
+        edge_face_codes[key_face] = first_codes[key_face] + key;
+        int run_ep_index = ep_corner_arrangements_index;
+        int run_op_index = op_corner_arrangements_index;
+        if (state->corner_bitsets != NULL) {
+            if (!AndCornerBitsets(state->corner_bitsets, key_rank, key_face, edge_face_codes[key_face])) {
+                state->stats.pruned[last_edge][PRUNE_FACE_JOIN] += run_end - run_start;
+                continue;
+            }
+        }
+        else {
+            run_ep_index = JoinCornerArrangements(state, run_ep_index, 0, key_rank + 1, first_colors);
+            run_op_index = JoinCornerArrangements(state, run_op_index, 1, key_rank + 1, first_colors);
+            if ((run_ep_index == -1) && (run_op_index == -1)) {
+                state->stats.pruned[last_edge][PRUNE_FACE_JOIN] += run_end - run_start;
+                continue;
+            }
+        }
+
+        for (int i = run_start; i < run_end; ++i) {
+            const EdgeHalf* half = &halves[i];
+
+            // The halves were each checked on their own, so all that's left is edge surfaces touching at a diagonal across them.
+            const unsigned long long lanes[EDGE_LANE_WORDS] = { first_lanes[0] ^ half->lanes[0], first_lanes[1] ^ half->lanes[1] };
+            if (EdgeLanesTouchDiagonally(lanes, 0) || EdgeLanesTouchDiagonally(lanes, 1)) {
+                ++state->stats.pruned[last_edge][PRUNE_EDGE_DIAGONAL];
+                continue;
+            }
+
+            for (int k = 0; k < EDGE_HALF_EDGES; ++k) {
+                int step = EDGE_HALF_DEPTH + k;
+                int ori = (half->oris >> k) & 1;
+                cube[edge_positions[step][0]] = edges[half->pieces[k]][ori];
+                cube[edge_positions[step][1]] = edges[half->pieces[k]][1 ^ ori];
+            }
+
+            bool representative = true;
+            for (int step = EDGE_HALF_DEPTH; representative && (step < CUBE_EDGES) && (state->symmetry_masks[step] != 0); ++step) {
+                representative = CheckEdgeSymmetries(state, (unsigned char)step);
+            }
+            if (!representative) {
+                ++state->stats.pruned[last_edge][PRUNE_SYMMETRY];
+                continue;
+            }
+
+            const unsigned long long* edge_colors = NULL;
+            if (!Criteria::ADJACENT_FACES_MAY_TOUCH) {
+                for (int step = EDGE_HALF_DEPTH; step < CUBE_EDGES; ++step) {
+                    AddEdgeColors(state, (unsigned char)step);
+                }
+                edge_colors = state->edge_colors[CUBE_EDGES];
+            }
+
+            for (int rank = key_rank + 1; rank < CUBE_FACES; ++rank) {
+                int face = face_completion_order[rank];
+                edge_face_codes[face] = first_codes[face] + half->face_codes[face];
+            }
+
+            // Join the rest of the faces before the last edge, to the colors of the edges before it.
+            int ep_index = run_ep_index;
+            int op_index = run_op_index;
+            if (state->corner_bitsets != NULL) {
+                bool any = true;
+                for (int rank = key_rank + 1; any && (rank < joined_faces); ++rank) {
+                    any = AndCornerBitsets(state->corner_bitsets, rank, face_completion_order[rank], edge_face_codes[face_completion_order[rank]]);
+                }
+                if (!any) {
+                    ++state->stats.pruned[last_edge][PRUNE_FACE_JOIN];
+                    continue;
+                }
+            }
+            else {
+                const unsigned long long* colors = Criteria::ADJACENT_FACES_MAY_TOUCH ? NULL : state->edge_colors[joined_colors];
+                ep_index = JoinCornerArrangements(state, ep_index, 0, joined_faces, colors);
+                op_index = JoinCornerArrangements(state, op_index, 1, joined_faces, colors);
+                if ((ep_index == -1) && (op_index == -1)) {
+                    ++state->stats.pruned[last_edge][PRUNE_FACE_JOIN];
+                    continue;
+                }
+            }
+
+            unsigned char half_parity = swap_parity ^ left_parity ^ half->swap_parity;
+            ++state->edge_arrangements;
+            if (half_parity == 0)
+                ++state->even_edge_arrangements;
+            else
+                ++state->odd_edge_arrangements;
+
+            for (int k = 0; k < EDGE_HALF_EDGES; ++k) {
+                edge_progress[2 * (EDGE_HALF_DEPTH + k)] = edge_ids[half->pieces[k]];
+                edge_progress[2 * (EDGE_HALF_DEPTH + k) + 1] = ((half->oris >> k) & 1) ? '-' : '_';
+            }
+
+            unsigned long int solutions = state->solutions;
+            JoinLastEdge<Criteria>(state, half_parity, (half_parity == 0) ? ep_index : op_index, edge_colors);
+            CountLastEdgeSolutions(state, last_edge, solutions);
+        }
+    }
+
+    memset(edge_progress + 2 * EDGE_HALF_DEPTH, ' ', 2 * EDGE_HALF_EDGES);
+}
+
+
+// Hand the subtree starting at edge_num to the thread pool instead of walking it here.
+void PushEdgeTask(EdgeSearchState* state, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index)
+{
+    EdgeTask task;
+    task.unit = state->unit;
+    if (task.unit != NULL) {
+        task.unit->pending_tasks.fetch_add(1);
+    }
+    task.edge_num = edge_num;
+    memcpy(task.pieces, state->pieces, sizeof(task.pieces));
+    memcpy(task.cube, state->cube, sizeof(task.cube));
+    memcpy(task.edge_face_codes, state->edge_face_codes, sizeof(task.edge_face_codes));
+    memcpy(task.edge_progress, state->edge_progress, sizeof(task.edge_progress));
+    task.swap_parity = swap_parity;
+    task.flip_parity = flip_parity;
+    task.ep_corner_arrangements_index = ep_corner_arrangements_index;
+    task.op_corner_arrangements_index = op_corner_arrangements_index;
+
+    state->pool->Push(state->worker, task);
+}
+
+
+// Should the subtree starting at edge_num go to the thread pool?
+inline bool ShouldSplitEdgeTask(EdgeSearchState* state, unsigned char edge_num)
+{
+    if (state->pool == NULL) {
+        return false;
+    }
+
+    return (edge_num < EDGE_TASK_SEED_DEPTH) || ((edge_num < EDGE_TASK_SPLIT_DEPTH) && state->pool->WantsWork());
+}
+
+
+template <typename Criteria>
+void StartCheckpointUnit(EdgeSearchState* state, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index);
+
+
+// Place the pieces from edge_num on, searching with the given criteria.
+template <typename Criteria>
+void PlaceEdgePiece(EdgeSearchState* state, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index)
+{
+    unsigned char* pieces = state->pieces;
+    char* edge_progress = state->edge_progress;
+
+    if ((edge_num == CHECKPOINT_DEPTH) && (state->finished_units != NULL) && (state->unit == NULL)) {
+        StartCheckpointUnit<Criteria>(state, edge_num, swap_parity, flip_parity, ep_corner_arrangements_index, op_corner_arrangements_index);
+        return;
+    }
+
+    if ((edge_num == EDGE_HALF_DEPTH) && (state->edge_halves != NULL)) {
+        JoinEdgeHalves<Criteria>(state, swap_parity, flip_parity, ep_corner_arrangements_index, op_corner_arrangements_index);
+        return;
+    }
+
+    if (edge_num == 11) {
+        // The last piece and its orientation are already determined, so there is nothing left to select.
+        PlaceLastEdgePiece<Criteria>(state, edge_num, swap_parity, flip_parity, (swap_parity == 0) ? ep_corner_arrangements_index : op_corner_arrangements_index);
+        return;
+    }
+
+    // Every piece that's left gets tried both ways round. Counting them all at once here is cheaper than in PlaceEdge().
+    state->stats.nodes[edge_num] += 2 * (CUBE_EDGES - edge_num);
+
+    // Select corner piece.
+    for (int pos = edge_num; pos < CUBE_EDGES; ++pos) {
+        unsigned char temp;
+
+        if (pos != edge_num) {
+            // Swap the piece into place in the pieces array.
+            temp = pieces[edge_num];
+            pieces[edge_num] = pieces[pos];
+            pieces[pos] = temp;
+
+            // Track swap parity.
+            swap_parity ^= 1;
+        }
 
         // Select orientation.
         for (int ori = 0; ori < 2; ++ori) {
-            // Track rotation parity.
-            flip_parity ^= ori;
+            int next_ep_corner_arrangements_index = ep_corner_arrangements_index;
+            int next_op_corner_arrangements_index = op_corner_arrangements_index;
+
+            if (PlaceEdge<Criteria>(state, edge_num, ori, &next_ep_corner_arrangements_index, &next_op_corner_arrangements_index)) {
+                edge_progress[2 * edge_num] = edge_ids[pieces[edge_num]];
+                edge_progress[2 * edge_num + 1] = ori ? '-' : '_';
+
+                // Flip parity tracks the orientations picked so far.
+                if (ShouldSplitEdgeTask(state, edge_num + 1)) {
+                    PushEdgeTask(state, edge_num + 1, swap_parity, flip_parity ^ ori, next_ep_corner_arrangements_index, next_op_corner_arrangements_index);
+                }
+                else {
+                    // Recursive call to place the next edge piece.
+                    PlaceEdgePiece<Criteria>(state, edge_num + 1, swap_parity, flip_parity ^ ori, next_ep_corner_arrangements_index, next_op_corner_arrangements_index);
+                }
+
+                edge_progress[2 * edge_num] = ' ';
+                edge_progress[2 * edge_num + 1] = ' ';
+            }
+        }
+
+        // Undo piece swap and swap parity.
+        if (pos != edge_num) {
+            temp = pieces[edge_num];
+            pieces[edge_num] = pieces[pos];
+            pieces[pos] = temp;
+
+            swap_parity ^= 1;
+        }
+    }
+}
+
+
+// This thread is done with its part of a unit. If that was the last part, hand the unit's solutions to the solution sink.
+void FinishUnitTask(CheckpointUnit* unit)
+{
+    if (unit->pending_tasks.fetch_sub(1) == 1) {
+        WriteFinishedUnit(unit->prefix, unit->solutions, unit->totals);
+        delete unit;
+    }
+}
+
+
+// Walk part of a unit on this thread, and count the edge arrangements it finds, and the solutions if only counting them,
+// towards the unit.
+template <typename Criteria>
+void SearchUnitPart(EdgeSearchState* state, CheckpointUnit* unit, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index)
+{
+    unsigned long int edge_arrangements = state->edge_arrangements;
+    unsigned long int even_edge_arrangements = state->even_edge_arrangements;
+    unsigned long int odd_edge_arrangements = state->odd_edge_arrangements;
+
+    state->unit = unit;
+    PlaceEdgePiece<Criteria>(state, edge_num, swap_parity, flip_parity, ep_corner_arrangements_index, op_corner_arrangements_index);
+    state->unit = NULL;
+
+    {
+        std::lock_guard<std::mutex> lock(unit->mutex);
+        unit->totals.edge_arrangements += state->edge_arrangements - edge_arrangements;
+        unit->totals.even_edge_arrangements += state->even_edge_arrangements - even_edge_arrangements;
+        unit->totals.odd_edge_arrangements += state->odd_edge_arrangements - odd_edge_arrangements;
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            unit->totals.solution_counts[i] += state->counts.solution_counts[i];
+            unit->totals.all_solution_counts[i] += state->counts.all_solution_counts[i];
+        }
+    }
+    if (state->count_only) {
+        FlushSolutionCounts(state);
+    }
+
+    FlushEdgeSearchStats(&state->stats);
+    FinishUnitTask(unit);
+}
+
+
+// Search the unit below the edges placed so far, unless a checkpoint says it's already finished.
+template <typename Criteria>
+void StartCheckpointUnit(EdgeSearchState* state, unsigned char edge_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index)
+{
+    std::string prefix(state->edge_progress, CHECKPOINT_PREFIX_LENGTH);
+    if ((state->finished_units->count(prefix) != 0) || ((state->shard_units != NULL) && (state->shard_units->count(prefix) == 0))) {
+        return;
+    }
+
+    CheckpointUnit* unit = new CheckpointUnit;
+    memcpy(unit->prefix, prefix.c_str(), CHECKPOINT_PREFIX_LENGTH + 1);
+    unit->pending_tasks = 1;
+    InitSearchTotals(&unit->totals);
+
+    SearchUnitPart<Criteria>(state, unit, edge_num, swap_parity, flip_parity, ep_corner_arrangements_index, op_corner_arrangements_index);
+}
+
+
+void InitEdgeTask(EdgeTask* task)
+{
+    task->unit = NULL;
+    task->edge_num = 0;
+
+    // The position of the edge pieces. pieces[3] = 5 means that edge piece 5 is in the position filled at step 3. Every piece
+    // starts out in its own position, so the swap parity starts out even whatever the edge order is.
+    memcpy(task->pieces, edge_order, sizeof(task->pieces));
+
+    // The cube. Edges will be overwritten in PlaceEdgePiece().
+    // Set edge surfaces to 99 for safety checks.
+    // Set corner surfaces as 0 so they can be OR'ed in later.
+    // Set centers to actual values so they can be compared to the corner colors.
+    unsigned char cube[CUBE_SURFACES] = { 0, 99, 0, 99,  4, 99, 0, 99, 0, 0, 99, 0, 99, 13, 99, 0, 99, 0, 0, 99, 0, 99, 22, 99, 0, 99, 0,
+                                          0, 99, 0, 99, 31, 99, 0, 99, 0, 0, 99, 0, 99, 40, 99, 0, 99, 0, 0, 99, 0, 99, 49, 99, 0, 99, 0 };
+    memcpy(task->cube, cube, sizeof(task->cube));
+
+    memset(task->edge_face_codes, 0, sizeof(task->edge_face_codes));
+    memcpy(task->edge_progress, "                        ", sizeof(task->edge_progress));
+    task->swap_parity = 0;                  // Start with even swap parity, 0.
+    task->flip_parity = 0;                  // Start with even flip parity, 0.
+    task->ep_corner_arrangements_index = 0; // Start with 0 index into even parity corner arrangements.
+    task->op_corner_arrangements_index = 0; // Start with 0 index into odd parity corner arrangements.
+}
+
+
+bool ApplyEdgePrefix(EdgeTask* task, const char* prefix)
+{
+    EdgeSearchState state;
+    InitEdgeSearchState(&state);
+    memcpy(state.pieces, task->pieces, sizeof(state.pieces));
+    memcpy(state.cube, task->cube, sizeof(state.cube));
+    memcpy(state.edge_face_codes, task->edge_face_codes, sizeof(state.edge_face_codes));
+
+    for (; (prefix[0] != '\0') && (prefix[1] != '\0'); prefix += 2) {
+        unsigned char edge_num = task->edge_num;
+        const char* id = strchr(edge_ids, prefix[0]);
+        if ((edge_num >= CUBE_EDGES - 1) || (id == NULL) || ((prefix[1] != '_') && (prefix[1] != '-'))) {
+            return false;
+        }
+
+        // Swap the piece into place, the same way PlaceEdgePiece() does.
+        int pos = edge_num;
+        while ((pos < CUBE_EDGES) && (state.pieces[pos] != (id - edge_ids))) {
+            ++pos;
+        }
+        if (pos == CUBE_EDGES) {
+            return false; // The piece has already been placed.
+        }
+        if (pos != edge_num) {
+            unsigned char temp = state.pieces[edge_num];
+            state.pieces[edge_num] = state.pieces[pos];
+            state.pieces[pos] = temp;
+            task->swap_parity ^= 1;
+        }
+
+        int ori = (prefix[1] == '-') ? 1 : 0;
+        if (!PlaceEdge<DefaultCriteria>(&state, edge_num, ori, &task->ep_corner_arrangements_index, &task->op_corner_arrangements_index)) {
+            return false;
+        }
+
+        task->flip_parity ^= ori;
+        task->edge_progress[2 * edge_num] = prefix[0];
+        task->edge_progress[2 * edge_num + 1] = prefix[1];
+        ++task->edge_num;
+    }
+
+    if (prefix[0] != '\0') {
+        return false;
+    }
+
+    memcpy(task->pieces, state.pieces, sizeof(task->pieces));
+    memcpy(task->cube, state.cube, sizeof(task->cube));
+    memcpy(task->edge_face_codes, state.edge_face_codes, sizeof(task->edge_face_codes));
+    return true;
+}
+
+
+void InitEdgeSearchState(EdgeSearchState* state)
+{
+    memset(state, 0, sizeof(EdgeSearchState));
+    state->pool = NULL;
+    state->join_probes = NULL;
+    state->record_solutions = true;
+    state->count_only = false;
+    InitSearchTotals(&state->counts);
+    state->print_progress = true;
+    state->finished_units = NULL;
+    state->shard_units = NULL;
+    state->unit = NULL;
+    state->symmetry_mode = SYMMETRY_NONE;
+    state->corner_bitsets = NULL;
+    state->edge_halves = NULL;
+    state->edge_lanes[0][0] = EDGE_LANES_EMPTY;
+    state->edge_lanes[0][1] = EDGE_LANES_EMPTY;
+}
 
-            // Place the piece.
-            cube[edges[edge_num][0]] = edges[pieces[edge_num]][ori];
-            cube[edges[edge_num][1]] = edges[pieces[edge_num]][1 ^ ori];
-
-            // Check to make sure that no edge surface has the same color as the center (no SIDES_TOUCHING).
-            if ((ColorOf(cube[edges[edge_num][0]]) == ColorOf(edges[edge_num][0])) ||
-                (ColorOf(cube[edges[edge_num][1]]) == ColorOf(edges[edge_num][1]))) {
-                // Undo flip parity.
-                flip_parity ^= ori;
-                continue;
-            }
 
-            // Check to make sure that two edge surfaces, touching at a diagonal, don't have the same color.
-            bool diagonals_touching = false;
-            for (int i = edge_diagonal_checks_start[edge_num]; (i <= edge_diagonal_checks_end[edge_num]) && !diagonals_touching; ++i) {
-                diagonals_touching = ColorOf(cube[edge_diagonal_checks[i][0]]) == ColorOf(cube[edge_diagonal_checks[i][1]]);
-            }
+void SetSearchCriteria(int criteria)
+{
+    search_criteria = criteria;
+    BuildPerfectFaces(criteria);
+    FillEdgeFaceTables();
+    FillEdgeLaneChanges();
+    FillAdjacentColorsIfNeeded();
+}
 
-            if (diagonals_touching) {
-                // Undo rotation parity.
-                flip_parity ^= ori;
-                continue;
+
+// Set a state up to search below a task: the edges the task starts with, and everything the search keeps track of about them.
+template <typename Criteria>
+void LoadEdgeTask(EdgeSearchState* state, const EdgeTask& task)
+{
+    memcpy(state->pieces, task.pieces, sizeof(state->pieces));
+    memcpy(state->cube, task.cube, sizeof(state->cube));
+    memcpy(state->edge_face_codes, task.edge_face_codes, sizeof(state->edge_face_codes));
+    memcpy(state->edge_progress, task.edge_progress, sizeof(state->edge_progress));
+
+    // Work out which symmetries are still in play after the edges the task starts with.
+    state->symmetry_masks[0] = (state->symmetry_mode != SYMMETRY_NONE) ? ALL_SYMMETRIES : 0;
+    for (int edge_num = 0; edge_num < task.edge_num; ++edge_num) {
+        state->symmetry_masks[edge_num + 1] = 0;
+        if (state->symmetry_masks[edge_num] != 0) {
+            CheckEdgeSymmetries(state, edge_num);
+        }
+    }
+
+    // Likewise the bitset join's record of what's left after the faces the task starts with.
+    if (state->corner_bitsets != NULL) {
+        for (int edge_num = 0; edge_num < task.edge_num; ++edge_num) {
+            for (int rank = edge_face_id_checks_start[edge_num]; (rank >= 0) && (rank <= edge_face_id_checks_end[edge_num]); ++rank) {
+                AndCornerBitsets(state->corner_bitsets, rank, face_completion_order[rank], state->edge_face_codes[face_completion_order[rank]]);
             }
+        }
+    }
 
-            int next_ep_corner_arrangements_index = ep_corner_arrangements_index;
-            int next_op_corner_arrangements_index = op_corner_arrangements_index;
-            bool indices_ok = true;
-
-            if (edge_face_id_checks_start[edge_num] >= 0) {
-                int face_id_count = edge_face_id_checks_end[edge_num] + 1;
-                // Fill out the edges' contribution to each face ids.
-                for (int face_index = edge_face_id_checks_start[edge_num]; face_index < face_id_count; ++face_index) {
-                    int start = face_index * 9;
-                    face_ids[face_index] = ((((cube[start + 1] / 9) * CUBE_COLORS_SQ + (cube[start + 3] / 9)) * CUBE_COLORS_SQ + (cube[start + 5] / 9)) * CUBE_COLORS_SQ + (cube[start + 7] / 9)) * CUBE_COLORS;
-                }
+    // And the colors of those edges, packed for the checks, and for a perfect-only search's join.
+    for (int edge_num = 0; edge_num < task.edge_num; ++edge_num) {
+        AddEdgeLanes(state, edge_num, (state->cube[edge_positions[edge_num][0]] == edges[state->pieces[edge_num]][0]) ? 0 : 1);
+        if (!Criteria::ADJACENT_FACES_MAY_TOUCH) {
+            AddEdgeColors(state, edge_num);
+        }
+    }
+}
+
+
+// Pick up an edge subtree on this thread.
+template <typename Criteria>
+void RunEdgeTaskFor(EdgeSearchState* state, const EdgeTask& task)
+{
+    static_assert(CheckSearchCriteria<Criteria>(), "");
+
+    LoadEdgeTask<Criteria>(state, task);
+    if (task.unit != NULL) {
+        SearchUnitPart<Criteria>(state, task.unit, task.edge_num, task.swap_parity, task.flip_parity, task.ep_corner_arrangements_index, task.op_corner_arrangements_index);
+    }
+    else {
+        PlaceEdgePiece<Criteria>(state, task.edge_num, task.swap_parity, task.flip_parity, task.ep_corner_arrangements_index, task.op_corner_arrangements_index);
+    }
+}
+
+
+void RunEdgeTask(EdgeSearchState* state, const EdgeTask& task)
+{
+    static void (* const run[SEARCH_CRITERIA_COUNT])(EdgeSearchState*, const EdgeTask&) = SEARCH_CRITERIA_INSTANCES(RunEdgeTaskFor);
+    run[search_criteria](state, task);
+}
+
+
+SolutionStream::SolutionStream(const EdgeTask& task, int symmetry_mode) : task(task)
+{
+    static bool (SolutionStream::* const next_for[SEARCH_CRITERIA_COUNT])(StreamSolution*) = SEARCH_CRITERIA_INSTANCES(&SolutionStream::NextFor);
+    static bool (SolutionStream::* const set_position_for[SEARCH_CRITERIA_COUNT])(const SolutionStreamPosition&) = SEARCH_CRITERIA_INSTANCES(&SolutionStream::SetPositionFor);
+    next = next_for[search_criteria];
+    set_position = set_position_for[search_criteria];
+
+    InitEdgeSearchState(&state);
+    state.symmetry_mode = symmetry_mode;
+    state.record_solutions = false;
+    state.print_progress = false;
+    loaded = false;
+    edge_num = task.edge_num;
+    StartStep(edge_num, task.swap_parity, task.flip_parity, task.ep_corner_arrangements_index, task.op_corner_arrangements_index);
+    joining = false;
+    corner_index = -1;
+    solution_index = -1;
+    solution_class = 0;
+    orbit_size = 0;
+    orbit_next = 0;
+    solutions = 0;
+
+    finished = !EdgeOrderCompletesFacesInOrder();
+    if (finished) {
+        fprintf(stderr, "Solution streams join the corners with the walk join, which needs an edge order that completes the faces in order.\n");
+    }
+}
+
+
+bool SolutionStream::Next(StreamSolution* solution)
+{
+    return (this->*next)(solution);
+}
+
+
+bool SolutionStream::SetPosition(const SolutionStreamPosition& position)
+{
+    return (this->*set_position)(position);
+}
+
+
+void SolutionStream::GetPosition(SolutionStreamPosition* position) const
+{
+    memset(position, 0, sizeof(SolutionStreamPosition));
+    position->start_edge = (unsigned char)task.edge_num;
+    position->edge_num = (unsigned char)edge_num;
+    for (int step_num = task.edge_num; (step_num <= edge_num) && (step_num < CUBE_EDGES - 1); ++step_num) {
+        position->positions[step_num] = steps[step_num].pos;
+        position->oris[step_num] = steps[step_num].ori;
+    }
+    position->finished = finished ? 1 : 0;
+    position->orbit_next = (unsigned char)orbit_next;
+    position->corner_index = joining ? corner_index : -1;
+    position->solution_index = solution_index;
+    position->solutions = solutions;
+}
+
+
+// Put a step on top of the stack, with nothing tried at it yet.
+void SolutionStream::StartStep(int step_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index)
+{
+    Step* step = &steps[step_num];
+    step->pos = (unsigned char)step_num;
+    step->ori = 0;
+    step->swap_parity = swap_parity;
+    step->flip_parity = flip_parity;
+    step->ep_corner_arrangements_index = ep_corner_arrangements_index;
+    step->op_corner_arrangements_index = op_corner_arrangements_index;
+}
+
+
+// Take the step on top of the stack off once everything below it has been tried. The stream is finished once that was the
+// step its task starts at.
+void SolutionStream::PopStep()
+{
+    state.edge_progress[2 * edge_num] = ' ';
+    state.edge_progress[2 * edge_num + 1] = ' ';
+    if (edge_num == task.edge_num) {
+        finished = true;
+    }
+    else {
+        --edge_num;
+    }
+}
 
-                next_ep_corner_arrangements_index = GetCornerArrangementsIndex(ep_corner_arrangements_index, ep_corner_arrangements, face_ids, face_id_count, EP_CORNER_ARRANGEMENT_COUNT - 1);
-                next_op_corner_arrangements_index = GetCornerArrangementsIndex(op_corner_arrangements_index, op_corner_arrangements, face_ids, face_id_count, OP_CORNER_ARRANGEMENT_COUNT - 1);
-                indices_ok = (next_ep_corner_arrangements_index != -1) || (next_op_corner_arrangements_index != -1);
+
+// Place the piece the top step is at with an orientation, as PlaceEdgePiece() does, and if it fits, put the next step on
+// the stack.
+template <typename Criteria>
+bool SolutionStream::PlaceStep(int ori)
+{
+    Step* step = &steps[edge_num];
+    int ep_corner_arrangements_index = step->ep_corner_arrangements_index;
+    int op_corner_arrangements_index = step->op_corner_arrangements_index;
+    if (!PlaceEdge<Criteria>(&state, (unsigned char)edge_num, ori, &ep_corner_arrangements_index, &op_corner_arrangements_index)) {
+        return false;
+    }
+
+    state.edge_progress[2 * edge_num] = edge_ids[state.pieces[edge_num]];
+    state.edge_progress[2 * edge_num + 1] = ori ? '-' : '_';
+    unsigned char swap_parity = step->swap_parity ^ ((step->pos != edge_num) ? 1 : 0);
+    StartStep(edge_num + 1, swap_parity, step->flip_parity ^ ori, ep_corner_arrangements_index, op_corner_arrangements_index);
+    ++edge_num;
+    return true;
+}
+
+
+// Try the pieces and orientations at the top step from where it left off, until one fits. Returns false once they're all
+// tried, with the pieces back as they were.
+template <typename Criteria>
+bool SolutionStream::AdvanceStep()
+{
+    Step* step = &steps[edge_num];
+    unsigned char* pieces = state.pieces;
+    while (step->pos < CUBE_EDGES) {
+        if (step->ori == 2) {
+            if (step->pos != edge_num) {
+                SWAP(pieces[edge_num], pieces[step->pos]);
+            }
+            ++step->pos;
+            step->ori = 0;
+            if (step->pos == CUBE_EDGES) {
+                break;
             }
+            SWAP(pieces[edge_num], pieces[step->pos]);
+        }
 
-            if (indices_ok) {
-                edge_progress[2 * edge_num] = edge_ids[pieces[edge_num]];
-                edge_progress[2 * edge_num + 1] = ori ? '-' : '_';
+        if (PlaceStep<Criteria>(step->ori++)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-                // Recursive call to place the next edge piece.
-                PlaceEdgePiece(edge_num + 1, pieces, cube, swap_parity, flip_parity, face_ids, next_ep_corner_arrangements_index, next_op_corner_arrangements_index);
 
-                edge_progress[2 * edge_num] = ' ';
-                edge_progress[2 * edge_num + 1] = ' ';
+// Check the solution at a corner arrangement the last step's join found, and give it if it meets the rest of the criteria.
+// An expanding stream gives the solutions symmetric to it on the following calls.
+template <typename Criteria>
+bool SolutionStream::EvaluateJoined(int index, StreamSolution* solution)
+{
+    unsigned char swap_parity = steps[CUBE_EDGES - 1].swap_parity;
+    const CornerArrangementTable* table = (swap_parity == 0) ? &ep_corner_table : &op_corner_table;
+    unsigned char solution_cube[CUBE_SURFACES];
+    solution_class = EvaluateSolution<Criteria>(&state, table, index, solution_cube, orbit, &orbit_size);
+    if (solution_class < 0) {
+        return false;
+    }
+    if (state.symmetry_mode == SYMMETRY_NONE) {
+        memcpy(orbit[0], solution_cube, CUBE_SURFACES);
+    }
+
+    solution_index = index;
+    orbit_next = 0;
+    GiveOrbitCube(solution, (state.symmetry_mode == SYMMETRY_EXPAND) ? orbit_size : 1);
+    return true;
+}
+
+
+// Give the next of the cubes in orbit[] for the last solution found, out of count.
+void SolutionStream::GiveOrbitCube(StreamSolution* solution, int count)
+{
+    memcpy(solution->cube, orbit[orbit_next], CUBE_SURFACES);
+    solution->solution_class = solution_class;
+    solution->orbit_size = orbit_size;
+    ++solutions;
+    if (++orbit_next == count) {
+        solution_index = -1;
+    }
+}
+
+
+// Carry on with the last step's corner join until it finds a solution. Returns false once it has found them all.
+template <typename Criteria>
+bool SolutionStream::JoinNext(StreamSolution* solution)
+{
+    unsigned char swap_parity = steps[CUBE_EDGES - 1].swap_parity;
+    const unsigned long long* edge_colors = Criteria::ADJACENT_FACES_MAY_TOUCH ? NULL : state.edge_colors[CUBE_EDGES];
+    int face_id_count = edge_face_id_checks_end[CUBE_EDGES - 1] + 1;
+    while (true) {
+        int index = JoinCornerArrangements(&state, corner_index, swap_parity, face_id_count, edge_colors);
+        if (index == -1) {
+            return false;
+        }
+        corner_index = index + 1;
+        ++state.solutions;
+        if (EvaluateJoined<Criteria>(index, solution)) {
+            return true;
+        }
+    }
+}
+
+
+// The search loop of PlaceEdgePiece() and PlaceLastEdgePiece(), picking up where the last call left off and stopping at the
+// next solution.
+template <typename Criteria>
+bool SolutionStream::NextFor(StreamSolution* solution)
+{
+    static_assert(CheckSearchCriteria<Criteria>(), "");
+
+    if (!loaded) {
+        LoadEdgeTask<Criteria>(&state, task);
+        loaded = true;
+    }
+
+    while (!finished) {
+        if (solution_index != -1) {
+            GiveOrbitCube(solution, orbit_size);
+            return true;
+        }
+
+        if (joining) {
+            if (JoinNext<Criteria>(solution)) {
+                return true;
+            }
+            joining = false;
+            PopStep();
+        }
+        else if (edge_num == CUBE_EDGES - 1) {
+            // The last piece and its orientation are already determined, so there is nothing left to select.
+            const Step* step = &steps[edge_num];
+            joining = PlaceLastEdge<Criteria>(&state, (unsigned char)edge_num, step->swap_parity, step->flip_parity);
+            if (joining) {
+                corner_index = (step->swap_parity == 0) ? step->ep_corner_arrangements_index : step->op_corner_arrangements_index;
+            }
+            else {
+                PopStep();
             }
+        }
+        else if (!AdvanceStep<Criteria>()) {
+            PopStep();
+        }
+    }
+    return false;
+}
 
-            // Undo rotation parity.
-            flip_parity ^= ori;
+
+// Start over from the task, and make the choices the position records again.
+template <typename Criteria>
+bool SolutionStream::SetPositionFor(const SolutionStreamPosition& position)
+{
+    int symmetry_mode = state.symmetry_mode;
+    InitEdgeSearchState(&state);
+    state.symmetry_mode = symmetry_mode;
+    state.record_solutions = false;
+    state.print_progress = false;
+    LoadEdgeTask<Criteria>(&state, task);
+    loaded = true;
+    edge_num = task.edge_num;
+    StartStep(edge_num, task.swap_parity, task.flip_parity, task.ep_corner_arrangements_index, task.op_corner_arrangements_index);
+    joining = false;
+    solution_index = -1;
+
+    bool valid = EdgeOrderCompletesFacesInOrder() && (position.start_edge == task.edge_num) && (position.edge_num >= task.edge_num) &&
+                 (position.edge_num < CUBE_EDGES);
+    for (int step_num = task.edge_num; valid && (step_num < CUBE_EDGES - 1) && (step_num <= position.edge_num); ++step_num) {
+        // Every step below the top one has a piece in place, so it has tried an orientation. The top one may not have yet.
+        Step* step = &steps[step_num];
+        int lowest_ori = (step_num < position.edge_num) ? 1 : 0;
+        valid = (position.positions[step_num] >= step_num) && (position.positions[step_num] < CUBE_EDGES) && (position.oris[step_num] >= lowest_ori) &&
+                (position.oris[step_num] <= 2);
+        if (valid) {
+            step->pos = position.positions[step_num];
+            step->ori = position.oris[step_num];
+            if (step->pos != step_num) {
+                SWAP(state.pieces[step_num], state.pieces[step->pos]);
+            }
+            valid = (step_num == position.edge_num) || PlaceStep<Criteria>(step->ori - 1);
         }
+    }
 
-        // Undo piece swap and swap parity.
-        if (pos != edge_num) {
-            temp = pieces[edge_num];
-            pieces[edge_num] = pieces[pos];
-            pieces[pos] = temp;
+    if (valid && (position.corner_index != -1)) {
+        const Step* step = &steps[CUBE_EDGES - 1];
+        valid = (edge_num == CUBE_EDGES - 1) && PlaceLastEdge<Criteria>(&state, (unsigned char)edge_num, step->swap_parity, step->flip_parity);
+        joining = valid;
+        corner_index = position.corner_index;
+    }
+    if (valid && (position.solution_index != -1)) {
+        // Find the symmetric cubes of the solution they're being given for again.
+        StreamSolution solution;
+        valid = joining && (position.solution_index >= 0) && (position.solution_index < position.corner_index) &&
+                (state.symmetry_mode == SYMMETRY_EXPAND) && EvaluateJoined<Criteria>(position.solution_index, &solution) && (position.orbit_next > 0) && (position.orbit_next < orbit_size);
+        solution_index = valid ? position.solution_index : -1;
+        orbit_next = position.orbit_next;
+    }
 
-            swap_parity ^= 1;
+    finished = !valid || (position.finished != 0);
+    solutions = position.solutions;
+    return valid;
+}
+
+
+// Walk the edge search down to depth edges the way PlaceEdgePiece() does, and count the partial edge arrangements that get
+// there. If units isn't NULL, each checkpoint unit on the way is listed with the count below it.
+template <typename Criteria>
+unsigned long long CountEdgeNodes(EdgeSearchState* state, unsigned char edge_num, unsigned char depth, int ep_corner_arrangements_index, int op_corner_arrangements_index, std::vector<UnitEstimate>* units)
+{
+    if (edge_num == depth) {
+        return 1;
+    }
+    if ((edge_num == CHECKPOINT_DEPTH) && (units != NULL)) {
+        UnitEstimate unit;
+        memcpy(unit.prefix, state->edge_progress, CHECKPOINT_PREFIX_LENGTH);
+        unit.prefix[CHECKPOINT_PREFIX_LENGTH] = '\0';
+        unit.nodes = CountEdgeNodes<Criteria>(state, edge_num, depth, ep_corner_arrangements_index, op_corner_arrangements_index, NULL);
+        units->push_back(unit);
+        return unit.nodes;
+    }
+
+    unsigned char* pieces = state->pieces;
+    unsigned long long count = 0;
+    for (int pos = edge_num; pos < CUBE_EDGES; ++pos) {
+        SWAP(pieces[edge_num], pieces[pos]);
+        for (int ori = 0; ori < 2; ++ori) {
+            int next_ep_corner_arrangements_index = ep_corner_arrangements_index;
+            int next_op_corner_arrangements_index = op_corner_arrangements_index;
+            if (PlaceEdge<Criteria>(state, edge_num, ori, &next_ep_corner_arrangements_index, &next_op_corner_arrangements_index)) {
+                state->edge_progress[2 * edge_num] = edge_ids[pieces[edge_num]];
+                state->edge_progress[2 * edge_num + 1] = ori ? '-' : '_';
+                count += CountEdgeNodes<Criteria>(state, edge_num + 1, depth, next_ep_corner_arrangements_index, next_op_corner_arrangements_index, units);
+            }
         }
+        SWAP(pieces[edge_num], pieces[pos]);
     }
+    return count;
 }
 
 
-void TryEdgeArrangements()
+void EstimateCheckpointUnits(EdgeSearchState* state, int estimate_depth, std::vector<UnitEstimate>* units)
 {
-    // The position of the edge pieces. pieces[3] = 5 meains that edge piece 5 is in edge piece 3's position.
-    unsigned char pieces[CUBE_EDGES] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    EdgeTask root;
+    InitEdgeTask(&root);
+    memcpy(state->pieces, root.pieces, sizeof(state->pieces));
+    memcpy(state->cube, root.cube, sizeof(state->cube));
+    memcpy(state->edge_face_codes, root.edge_face_codes, sizeof(state->edge_face_codes));
+    memcpy(state->edge_progress, root.edge_progress, sizeof(state->edge_progress));
+    state->symmetry_masks[0] = (state->symmetry_mode != SYMMETRY_NONE) ? ALL_SYMMETRIES : 0;
+
+    // The last edge is never placed by PlaceEdge().
+    int depth = std::min(CHECKPOINT_DEPTH + estimate_depth, CUBE_EDGES - 1);
+    units->clear();
+    typedef unsigned long long (*CountEdgeNodesFunction)(EdgeSearchState*, unsigned char, unsigned char, int, int, std::vector<UnitEstimate>*);
+    static const CountEdgeNodesFunction count_edge_nodes[SEARCH_CRITERIA_COUNT] = SEARCH_CRITERIA_INSTANCES(CountEdgeNodes);
+    count_edge_nodes[search_criteria](state, 0, (unsigned char)depth, root.ep_corner_arrangements_index, root.op_corner_arrangements_index, units);
+}
 
-    // The cube. Edges will be overwritten in PlaceEdgePiece().
-    // Set edge surfaces to 99 for safety checks.
-    // Set corner surfaces as 0 so they can be OR'ed in later.
-    // Set centers to actual values so they can be compared to the corner colors.
-    unsigned char cube[CUBE_SURFACES] = { 0, 99, 0, 99,  4, 99, 0, 99, 0, 0, 99, 0, 99, 13, 99, 0, 99, 0, 0, 99, 0, 99, 22, 99, 0, 99, 0,
-                                          0, 99, 0, 99, 31, 99, 0, 99, 0, 0, 99, 0, 99, 40, 99, 0, 99, 0, 0, 99, 0, 99, 49, 99, 0, 99, 0 };
 
-    int corner_arrangements_index = 0;
-    unsigned int face_ids[CUBE_FACES] = { 0, 0, 0, 0, 0, 0 };
+// Search every edge arrangement using thread_count threads, skipping the units the checkpoint says are finished, and those
+// that aren't in shard_units if it isn't NULL. The totals start from the checkpoint's. corner_join is CORNER_JOIN_WALK or
+// CORNER_JOIN_BITSET, and edge_engine EDGE_ENGINE_RECURSIVE or EDGE_ENGINE_HALVES.
+void TryEdgeArrangements(int thread_count, const SearchCheckpoint& checkpoint, const std::set<std::string>* shard_units, int corner_join, int edge_engine)
+{
+    // The starting point of every search thread.
+    EdgeTask root;
+    InitEdgeTask(&root);
+
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+
+    WorkStealingPool<EdgeTask> pool(thread_count);
+    std::vector<EdgeSearchState> states(thread_count);
+    std::vector<CornerBitsetState> corner_bitsets((corner_join == CORNER_JOIN_BITSET) ? thread_count : 0);
+    for (int worker = 0; worker < thread_count; ++worker) {
+        InitEdgeSearchState(&states[worker]);
+        states[worker].pool = (thread_count > 1) ? &pool : NULL;
+        states[worker].worker = worker;
+        states[worker].finished_units = &checkpoint.finished;
+        states[worker].shard_units = shard_units;
+        states[worker].symmetry_mode = checkpoint.symmetry_mode;
+        states[worker].count_only = checkpoint.solution_format == SOLUTION_FORMAT_COUNT;
+        states[worker].corner_bitsets = corner_bitsets.empty() ? NULL : &corner_bitsets[worker];
+        states[worker].edge_halves = (edge_engine == EDGE_ENGINE_HALVES) ? &edge_half_table : NULL;
+    }
 
-    PlaceEdgePiece(0,        // Start with edge number 0.
-                   pieces,   // The pieces and positions.
-                   cube,     // The resulting cube.
-                   0,        // Start with even swap parity, 0.
-                   0,        // Start with even flip parity, 0.
-                   face_ids, // Face ids.
-                   0,        // Start with 0 index into even parity corner arrangements.
-                   0);       // Start with 0 index into odd parity corner arrangements.
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        solution_counts[i] = (long int)checkpoint.totals.solution_counts[i];
+        all_solution_counts[i] = (long int)checkpoint.totals.all_solution_counts[i];
+        total_solutions += solution_counts[i];
+    }
+    edge_arrangements = (unsigned long int)checkpoint.totals.edge_arrangements;
+    even_edge_arrangements = (unsigned long int)checkpoint.totals.even_edge_arrangements;
+    odd_edge_arrangements = (unsigned long int)checkpoint.totals.odd_edge_arrangements;
+
+    pool.Push(0, root);
+    auto run_task = [&states](int worker, const EdgeTask& task) { RunEdgeTask(&states[worker], task); };
+    pool.Run(run_task);
+
+    for (int worker = 0; worker < thread_count; ++worker) {
+        FlushEdgeSearchStats(&states[worker].stats);
+        FlushSolutionCounts(&states[worker]);
+        edge_arrangements += states[worker].edge_arrangements;
+        even_edge_arrangements += states[worker].even_edge_arrangements;
+        odd_edge_arrangements += states[worker].odd_edge_arrangements;
+    }
 }
 
 #pragma endregion edges
 
+// Command line options.
+typedef struct {
+    int thread_count;          // Number of edge search threads.
+    int solution_format;       // SOLUTION_FORMAT_TEXT, SOLUTION_FORMAT_BINARY or SOLUTION_FORMAT_COUNT.
+    const char* decode_file;   // If set, expand this binary solution file to text on stdout instead of searching.
+    const char* dedupe_file;   // If set, dedupe this solution file into dedupe_out instead of searching.
+    const char* dedupe_out;
+    const char* benchmark;     // If set, run this benchmark instead of searching.
+    bool resume;               // Pick up the search from CHECKPOINT_FILE.
+    int symmetry_mode;         // SYMMETRY_NONE, SYMMETRY_REDUCE or SYMMETRY_EXPAND.
+    int corner_join;           // CORNER_JOIN_WALK or CORNER_JOIN_BITSET.
+    int edge_engine;           // EDGE_ENGINE_RECURSIVE or EDGE_ENGINE_HALVES.
+    const char* report_file;   // If set, write a JSON report of the search's counters and phase times here.
+    bool auto_edge_order;      // Pick the edge order with PickEdgeOrder() instead of using edge_order.
+    int criteria;              // The SEARCH_CRITERIA_* policy to search with.
+    int shard;                 // Search shard number shard of shard_count, counting from 1. shard_count is 1 if not sharding.
+    int shard_count;
+    int merge_count;           // If not 0, merge the shards in these directories instead of searching.
+    char** merge_directories;
+    unsigned char edge_order[CUBE_EDGES];
+    unsigned char corner_order[CUBE_CORNERS];
+} SearchOptions;
+
+
+void PrintUsage()
+{
+    fprintf(stderr, "Usage: ScrambleSearcher [--threads N] [--binary|--count-only] [--symmetry reduce|expand] [--join walk|bitset] [--engine recursive|halves]\n");
+    fprintf(stderr, "                        [--edge-order ORDER|auto] [--corner-order ORDER] [--criteria NAME] [--shard I/N] [--report FILE] [--resume]\n");
+    fprintf(stderr, "       ScrambleSearcher --merge DIR...\n");
+    fprintf(stderr, "       ScrambleSearcher --decode FILE\n");
+    fprintf(stderr, "       ScrambleSearcher --dedupe FILE OUT\n");
+    fprintf(stderr, "       ScrambleSearcher --benchmark NAME\n");
+    fprintf(stderr, "  --threads N    Search edge arrangements on N threads. Defaults to the number of hardware threads.\n");
+    fprintf(stderr, "  --binary       Write solutions to compact binary .bin files instead of .txt files.\n");
+    fprintf(stderr, "  --count-only   Only count the solutions in each solution file's class, without writing any solution files.\n");
+    fprintf(stderr, "  --symmetry reduce  Only search for one of each set of solutions that are the same apart from turning, mirroring and\n");
+    fprintf(stderr, "                     recoloring the cube, and only write that one.\n");
+    fprintf(stderr, "  --symmetry expand  Search the same way, but write every solution in each set.\n");
+    fprintf(stderr, "  --join bitset  Join the corners to the edges by ANDing bitsets of the corner arrangements that fit each face, instead of\n");
+    fprintf(stderr, "                 walking the sorted corner tables. Takes about 350 MB more memory. --join walk is the default.\n");
+    fprintf(stderr, "  --engine halves  Only search the first %i edges, and join each partial arrangement to every way of placing the other\n", EDGE_HALF_DEPTH);
+    fprintf(stderr, "                   %i that was worked out beforehand. --engine recursive, searching all of them, is the default.\n", EDGE_HALF_EDGES);
+    fprintf(stderr, "  --edge-order ORDER  Fill the edge positions in this order, e.g. 0123456789AB (the default). Orders that don't complete\n");
+    fprintf(stderr, "                      face 0 first, then face 1 and so on need --join bitset.\n");
+    fprintf(stderr, "  --edge-order auto   Pick the order that a sample of partial edge arrangements says leaves the fewest to search.\n");
+    fprintf(stderr, "  --corner-order ORDER  Fill the corner positions in this order when creating Corners.dat, e.g. 01234567 (the default).\n");
+    fprintf(stderr, "  --criteria NAME  Search with other criteria than the six in the README. NAME is one of:\n");
+    fprintf(stderr, "                    default - the six criteria.\n");
+    fprintf(stderr, "                    five-patterns - only solutions with 5 or 6 different face patterns.\n");
+    fprintf(stderr, "                    five-colors - faces may be missing a color, so they only need 5 of the 6.\n");
+    fprintf(stderr, "                    perfect - only _Perfect solutions, with the corners joined to every edge color so the rest are never found.\n");
+    fprintf(stderr, "  --shard I/N    Only search shard I of N, counting from 1. The shards each get about the same share of the search, and\n");
+    fprintf(stderr, "                 are run the same way apart from I, each in its own directory.\n");
+    fprintf(stderr, "  --report FILE  Write the time taken by each phase, and where the search cuts the tree at each depth and why, to\n");
+    fprintf(stderr, "                 FILE as JSON every %i seconds and at the end.\n", REPORT_INTERVAL_SECONDS);
+    fprintf(stderr, "  --resume       Pick up an interrupted search from %s. The solution format, symmetry mode, edge order,\n", CHECKPOINT_FILE);
+    fprintf(stderr, "                 criteria and shard are taken from the checkpoint.\n");
+    fprintf(stderr, "  --merge DIR... Merge the solution files and checkpoints of every shard of a finished search, one directory per shard,\n");
+    fprintf(stderr, "                 into the current directory.\n");
+    fprintf(stderr, "  --decode FILE  Write the solutions in a binary or canonical solution file to stdout in the text format.\n");
+    fprintf(stderr, "  --dedupe FILE OUT  Write one of each set of symmetric solutions in a text or binary solution file to OUT, in the\n");
+    fprintf(stderr, "                     same format, with how many solutions it stands for.\n");
+    fprintf(stderr, "  --benchmark NAME  Run a benchmark and print the results as JSON. NAME is one of:\n");
+    fprintf(stderr, "                    faces - building the perfect face patterns and the full face table, and reading FaceTable.dat.\n");
+    fprintf(stderr, "                    corners - creating the corner arrangements.\n");
+    fprintf(stderr, "                    join - corner joins recorded from the edge search, against the old and new corner table layouts.\n");
+    fprintf(stderr, "                    connectedness - scoring random cubes with each version of GetColorConnectedness(), checked against the scalar one.\n");
+    fprintf(stderr, "                    subtrees - searching below fixed edge prefixes with each corner join, checked against known counts.\n");
+    fprintf(stderr, "                    record - searching below the same prefixes and writing the solutions in each format, then counting them and resuming from a checkpoint.\n");
+    fprintf(stderr, "                    bitset - searching random parts of the edge search with the walk and with the bitset join on each set of instructions.\n");
+    fprintf(stderr, "                    criteria - searching below the subtree prefixes with each built-in --criteria, checked against each other.\n");
+    fprintf(stderr, "                    dedupe - deduping every cube symmetric to some random cubes, from text and binary files.\n");
+    fprintf(stderr, "                    halves - searching below the subtree prefixes with each --engine and corner join, checked against known counts.\n");
+    fprintf(stderr, "                    stream - pulling the solutions below the subtree prefixes from solution streams, whole, resumed and in turn.\n");
+    fprintf(stderr, "                    all - all of the above.\n");
+}
+
+
+bool ParseOptions(int argc, char* argv[], SearchOptions* options)
+{
+    options->thread_count = (int)std::thread::hardware_concurrency();
+    if (options->thread_count < 1) {
+        options->thread_count = 1;
+    }
+    options->solution_format = SOLUTION_FORMAT_TEXT;
+    options->decode_file = NULL;
+    options->dedupe_file = NULL;
+    options->dedupe_out = NULL;
+    options->benchmark = NULL;
+    options->resume = false;
+    options->symmetry_mode = SYMMETRY_NONE;
+    options->corner_join = CORNER_JOIN_WALK;
+    options->edge_engine = EDGE_ENGINE_RECURSIVE;
+    options->report_file = NULL;
+    options->auto_edge_order = false;
+    options->criteria = SEARCH_CRITERIA_DEFAULT;
+    options->shard = 1;
+    options->shard_count = 1;
+    options->merge_count = 0;
+    options->merge_directories = NULL;
+    memcpy(options->edge_order, default_edge_order, sizeof(options->edge_order));
+    memcpy(options->corner_order, default_corner_order, sizeof(options->corner_order));
+
+    for (int i = 1; i < argc; ++i) {
+        if ((strcmp(argv[i], "--threads") == 0) && (i + 1 < argc)) {
+            options->thread_count = atoi(argv[++i]);
+            if (options->thread_count < 1) {
+                fprintf(stderr, "--threads must be at least 1.\n");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--binary") == 0) {
+            options->solution_format = SOLUTION_FORMAT_BINARY;
+        }
+        else if (strcmp(argv[i], "--count-only") == 0) {
+            options->solution_format = SOLUTION_FORMAT_COUNT;
+        }
+        else if ((strcmp(argv[i], "--symmetry") == 0) && (i + 1 < argc)) {
+            ++i;
+            if (strcmp(argv[i], "reduce") == 0) {
+                options->symmetry_mode = SYMMETRY_REDUCE;
+            }
+            else if (strcmp(argv[i], "expand") == 0) {
+                options->symmetry_mode = SYMMETRY_EXPAND;
+            }
+            else {
+                fprintf(stderr, "--symmetry must be reduce or expand.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--join") == 0) && (i + 1 < argc)) {
+            ++i;
+            if (strcmp(argv[i], "walk") == 0) {
+                options->corner_join = CORNER_JOIN_WALK;
+            }
+            else if (strcmp(argv[i], "bitset") == 0) {
+                options->corner_join = CORNER_JOIN_BITSET;
+            }
+            else {
+                fprintf(stderr, "--join must be walk or bitset.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--engine") == 0) && (i + 1 < argc)) {
+            ++i;
+            if (strcmp(argv[i], "recursive") == 0) {
+                options->edge_engine = EDGE_ENGINE_RECURSIVE;
+            }
+            else if (strcmp(argv[i], "halves") == 0) {
+                options->edge_engine = EDGE_ENGINE_HALVES;
+            }
+            else {
+                fprintf(stderr, "--engine must be recursive or halves.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--edge-order") == 0) && (i + 1 < argc)) {
+            ++i;
+            options->auto_edge_order = strcmp(argv[i], "auto") == 0;
+            if (!options->auto_edge_order && !ParsePlacementOrder(argv[i], CUBE_EDGES, options->edge_order)) {
+                fprintf(stderr, "--edge-order must be auto or each of the edge ids 0123456789AB once.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--corner-order") == 0) && (i + 1 < argc)) {
+            if (!ParsePlacementOrder(argv[++i], CUBE_CORNERS, options->corner_order)) {
+                fprintf(stderr, "--corner-order must be each of the corner ids 01234567 once.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--criteria") == 0) && (i + 1 < argc)) {
+            if (!ParseSearchCriteria(argv[++i], &options->criteria)) {
+                fprintf(stderr, "--criteria must be default, five-patterns, five-colors or perfect.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--shard") == 0) && (i + 1 < argc)) {
+            if (!ParseShard(argv[++i], &options->shard, &options->shard_count)) {
+                fprintf(stderr, "--shard must be I/N, with N at least 2 and I from 1 to N.\n");
+                return false;
+            }
+        }
+        else if ((strcmp(argv[i], "--merge") == 0) && (i + 1 < argc)) {
+            options->merge_count = argc - i - 1;
+            options->merge_directories = &argv[i + 1];
+            break;
+        }
+        else if ((strcmp(argv[i], "--report") == 0) && (i + 1 < argc)) {
+            options->report_file = argv[++i];
+        }
+        else if (strcmp(argv[i], "--resume") == 0) {
+            options->resume = true;
+        }
+        else if ((strcmp(argv[i], "--decode") == 0) && (i + 1 < argc)) {
+            options->decode_file = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--dedupe") == 0) && (i + 2 < argc)) {
+            options->dedupe_file = argv[++i];
+            options->dedupe_out = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--benchmark") == 0) && (i + 1 < argc)) {
+            options->benchmark = argv[++i];
+        }
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 int main(int argc, char* argv[])
 {
-    printf("Building face table.\n");
-    BuildFaceTable();
+    SearchOptions options;
+    if (!ParseOptions(argc, argv, &options)) {
+        PrintUsage();
+        exit(1);
+    }
+
+    if (options.decode_file != NULL) {
+        return DecodeSolutionFile(options.decode_file, stdout) ? 0 : 1;
+    }
+    if (options.merge_count > 0) {
+        return MergeShards(options.merge_count, options.merge_directories) ? 0 : 1;
+    }
+    if (options.dedupe_file != NULL) {
+        // The canonical solutions are the representatives with the default edge order.
+        SetEdgeOrder(default_edge_order);
+        InitCubeSymmetries();
+        DedupeTotals totals;
+        if (!DedupeSolutionFile(options.dedupe_file, options.dedupe_out, DEDUPE_RUN_SOLUTIONS, &totals)) {
+            return 1;
+        }
+        printf("Read %llu solutions.\n", totals.solutions);
+        printf("Wrote %llu canonical solutions, standing for %llu solutions.\n", totals.canonical_solutions, totals.represented_solutions);
+        return 0;
+    }
+
+    if ((options.report_file != NULL) && (options.benchmark == NULL) && !StartSearchReport(options.report_file)) {
+        exit(1);
+    }
+
+    // The benchmarks always use the default edge order and criteria. The search's are picked once the checkpoint has been read.
+    SetEdgeOrder(default_edge_order);
+    SetCornerOrder(options.corner_order);
 
+    printf("Finding perfect face patterns.\n");
+    StartSearchPhase(PHASE_PERFECT_FACES);
+    SetSearchCriteria(SEARCH_CRITERIA_DEFAULT);
+    EndSearchPhase(PHASE_PERFECT_FACES);
+
+    StartSearchPhase(PHASE_CORNERS);
     if (!ReadCornerArrangements()) {
         printf("Creating corner arrangements.\n");
-        CreateCornerArrangements();
+        CreateCornerArrangements(options.thread_count, true);
         printf("Created %i even-parity corner arrangements.\n", ep_corner_arrangement_count);
         printf("Created %i  odd-parity corner arrangements.\n", op_corner_arrangement_count);
 
@@ -732,10 +2711,132 @@ int main(int argc, char* argv[])
             exit(1);
         }
     }
+    EndSearchPhase(PHASE_CORNERS);
+
+    if (options.benchmark != NULL) {
+        if (!RunBenchmark(options.benchmark, options.thread_count)) {
+            fprintf(stderr, "Unknown benchmark: %s\n", options.benchmark);
+            PrintUsage();
+            exit(1);
+        }
+        return 0;
+    }
+
+    SearchCheckpoint checkpoint;
+    if (options.resume) {
+        if (!ReadCheckpoint(CHECKPOINT_FILE, &checkpoint)) {
+            fprintf(stderr, "Failed to read %s.\n", CHECKPOINT_FILE);
+            exit(1);
+        }
+        options.solution_format = checkpoint.solution_format;
+        options.symmetry_mode = checkpoint.symmetry_mode;
+        options.auto_edge_order = false;
+        memcpy(options.edge_order, checkpoint.edge_order, sizeof(options.edge_order));
+        options.criteria = checkpoint.criteria;
+        options.shard = checkpoint.shard;
+        options.shard_count = checkpoint.shard_count;
+        printf("Resuming with %i finished units.\n", (int)checkpoint.finished.size());
+    }
+    else {
+        InitSearchCheckpoint(&checkpoint, options.solution_format, options.symmetry_mode);
+        checkpoint.criteria = options.criteria;
+        checkpoint.shard = options.shard;
+        checkpoint.shard_count = options.shard_count;
+    }
+
+    // Everything from here on, the corner bitsets included, is worked out from the criteria's perfect faces.
+    if (options.criteria != SEARCH_CRITERIA_DEFAULT) {
+        printf("Searching with the %s criteria.\n", search_criteria_names[options.criteria]);
+        StartSearchPhase(PHASE_PERFECT_FACES);
+        SetSearchCriteria(options.criteria);
+        EndSearchPhase(PHASE_PERFECT_FACES);
+    }
+
+    char order_text[CUBE_EDGES + 1];
+    if (options.auto_edge_order) {
+        printf("Picking an edge order.\n");
+        if (!PickEdgeOrder(options.corner_join == CORNER_JOIN_WALK, options.edge_order)) {
+            printf("No edge order the walk join can use was found, so using the default.\n");
+            memcpy(options.edge_order, default_edge_order, sizeof(options.edge_order));
+        }
+        FormatPlacementOrder(default_edge_order, CUBE_EDGES, order_text);
+        printf("Edge order %s leaves about %.4g partial edge arrangements to search.\n", order_text, EstimateEdgeSearchNodes(default_edge_order));
+        FormatPlacementOrder(options.edge_order, CUBE_EDGES, order_text);
+        printf("Edge order %s leaves about %.4g.\n", order_text, EstimateEdgeSearchNodes(options.edge_order));
+    }
+    SetEdgeOrder(options.edge_order);
+    memcpy(checkpoint.edge_order, options.edge_order, sizeof(checkpoint.edge_order));
+    FormatPlacementOrder(edge_order, CUBE_EDGES, order_text);
+    if ((options.corner_join == CORNER_JOIN_WALK) && !EdgeOrderCompletesFacesInOrder()) {
+        fprintf(stderr, "Edge order %s doesn't complete the faces in order, so it needs --join bitset.\n", order_text);
+        exit(1);
+    }
+    printf("Filling edge positions in the order %s.\n", order_text);
+
+    InitCubeSymmetries();
+
+    if (options.edge_engine == EDGE_ENGINE_HALVES) {
+        BuildEdgeHalves();
+        printf("Joining the last %i edges from %i second halves.\n", EDGE_HALF_EDGES, (int)edge_half_table.halves.size());
+    }
+
+    if (options.corner_join == CORNER_JOIN_BITSET) {
+        printf("Building corner bitsets.\n");
+        StartSearchPhase(PHASE_BITSETS);
+        if (!BuildCornerBitsets(options.thread_count)) {
+            exit(1);
+        }
+        EndSearchPhase(PHASE_BITSETS);
+        printf("Joining corners with %s bitset instructions.\n", GetCornerBitsetInstructions());
+    }
+
+    // Every shard works out the same split, so a resumed shard has to come up with the one it started with.
+    std::set<std::string> shard_units;
+    if (options.shard_count > 1) {
+        unsigned int total_units = GetShardUnits(options.shard, options.shard_count, options.symmetry_mode, &shard_units);
+        if (options.resume && ((total_units != checkpoint.total_units) || (shard_units.size() != checkpoint.shard_units))) {
+            fprintf(stderr, "Shard %i/%i now has %i of %u units, but the checkpoint says %u of %u.\n", options.shard, options.shard_count,
+                    (int)shard_units.size(), total_units, checkpoint.shard_units, checkpoint.total_units);
+            exit(1);
+        }
+        checkpoint.shard_units = (unsigned int)shard_units.size();
+        checkpoint.total_units = total_units;
+        printf("Searching shard %i/%i: %i of %u checkpoint units.\n", options.shard, options.shard_count, (int)shard_units.size(), total_units);
+    }
+
+    if (!OpenSolutionSink(options.solution_format, &checkpoint, options.resume)) {
+        exit(1);
+    }
 
-    printf("Trying edge arrangements\n");
-    TryEdgeArrangements();
+    printf("Trying edge arrangements on %i thread%s\n", options.thread_count, (options.thread_count == 1) ? "" : "s");
+    StartSearchPhase(PHASE_EDGE_SEARCH);
+    TryEdgeArrangements(options.thread_count, checkpoint, (options.shard_count > 1) ? &shard_units : NULL, options.corner_join, options.edge_engine);
+    EndSearchPhase(PHASE_EDGE_SEARCH);
+    StartSearchPhase(PHASE_WRITE);
+    bool written = CloseSolutionSink();
+    EndSearchPhase(PHASE_WRITE);
+    StopSearchReport();
+    if (!written) {
+        fprintf(stderr, "The search failed because its solutions couldn't all be written. Fix the problem, then --resume from %s if there is one.\n",
+                CHECKPOINT_FILE);
+        exit(1);
+    }
     printf("%i edge arrangements.\n", edge_arrangements);
     printf("%i even edge arrangements.\n", even_edge_arrangements);
     printf("%i odd edge arrangements.\n", odd_edge_arrangements);
+
+    if (options.solution_format == SOLUTION_FORMAT_COUNT) {
+        printf("Solutions:");
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            printf(" %li", solution_counts[i]);
+        }
+        printf("\n");
+    }
+    if (options.symmetry_mode != SYMMETRY_NONE) {
+        printf("Solutions counting symmetric ones:");
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            printf(" %li", all_solution_counts[i]);
+        }
+        printf("\n");
+    }
 }
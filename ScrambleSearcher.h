@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+#include "Checkpoint.h"
+#include "ScrambleEvaluation.h"
+#include "SearchStats.h"
+#include "Symmetry.h"
+#include "WorkStealing.h"
+
+constexpr auto CUBE_COLORS_SQ = CUBE_COLORS * CUBE_COLORS;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Corner Arrangements
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Hard-coded because I worked it out once and now I can be lazy with array sizes.
+const int EP_CORNER_ARRANGEMENT_COUNT = 375336;
+const int OP_CORNER_ARRANGEMENT_COUNT = 375304;
+
+// A corner arrangement's contribution to a face is the colors of the center and the four corner surfaces. As part of a face id
+// those are every other digit of a 9 digit base 6 number, with the edges filling in the digits between them. A corner face
+// code is the same five colors packed into a 5 digit base 6 number, so it fits in 16 bits. corner_face_ids[] expands it.
+constexpr auto CORNER_FACE_CODES = 7776; // CUBE_COLORS^5
+extern unsigned int corner_face_ids[CORNER_FACE_CODES];
+
+// The edges' contribution to a face is the colors of the four edge surfaces, the digits of the face id in between the corner
+// digits. An edge face code packs those into a 4 digit base 6 number, and edge_face_ids[] expands it.
+constexpr auto EDGE_FACE_CODES = 1296; // CUBE_COLORS^4
+extern unsigned int edge_face_ids[EDGE_FACE_CODES];
+
+// corner_face_matches[edge code] has a bit for each corner face code that makes a perfect face with that edge face code.
+// A few corner face codes match any given edge face code, so the join uses this to skip straight to the next one that does.
+constexpr auto CORNER_FACE_MATCH_WORDS = (CORNER_FACE_CODES + 63) / 64;
+extern unsigned long long corner_face_matches[EDGE_FACE_CODES][CORNER_FACE_MATCH_WORDS];
+
+// The part of a corner arrangement that GetCornerArrangementsIndex() reads.
+typedef struct {
+    unsigned short faceIds[CUBE_FACES]; // The corners' contribution to each face arrangement, as corner face codes. Includes the center piece.
+    unsigned int nextIndex[CUBE_FACES]; // The index of the first entry that contains a different value.
+} CornerArrangementKey;
+
+// A perfect-only search also joins the corners to the colors of the edge surfaces placed so far, because a corner surface
+// can't be the color of an edge surface it touches across two faces (criterion 5). A set of colors on the edge surfaces has
+// 8 bits for each of the 24 edge surfaces, one per color, at edge_color_bits[surface] + color.
+constexpr auto EDGE_COLOR_WORDS = 3;
+extern unsigned char edge_color_bits[CUBE_SURFACES];
+
+// Does a set of edge surface colors have any in common with another?
+inline bool EdgeColorsOverlap(const unsigned long long* a, const unsigned long long* b)
+{
+    return ((a[0] & b[0]) | (a[1] & b[1]) | (a[2] & b[2])) != 0;
+}
+
+// All the acceptable ways to arrange the corner pieces with one swap parity, sorted by faceIds. The keys are kept apart
+// from the arrangements, which only RecordSolution() reads, so walking the keys doesn't drag the arrangements into the cache.
+typedef struct {
+    const CornerArrangementKey* keys;
+    const unsigned char (*arrangements)[CUBE_SURFACES]; // The positions of the corner pieces. To be OR'ed together with edge arrangements.
+    int count;
+    const int* first_indexes; // first_indexes[code] is the first key whose faceIds[0] is code or more. CORNER_FACE_CODES + 1 entries.
+    const unsigned long long (*adjacent_colors)[EDGE_COLOR_WORDS]; // For each arrangement, the colors each edge surface can't be
+                                                                   // without touching a corner surface of its color across two faces.
+                                                                   // Only filled out for criteria that join the edge colors.
+} CornerArrangementTable;
+
+extern CornerArrangementTable ep_corner_table;
+extern CornerArrangementTable op_corner_table;
+
+bool ReadCornerArrangements();
+bool WriteCornerArrangements();
+// Prints how far it has got as it goes if print_progress is set.
+void CreateCornerArrangements(int thread_count, bool print_progress);
+
+// Find the first corner arrangement at or after index that makes a perfect pattern on faces 0 through face_id_count - 1
+// together with the edges' contribution in edge_face_codes. If edge_colors isn't NULL, the arrangement also mustn't touch
+// any of those edge colors across two faces. Returns -1 if there is none.
+int GetCornerArrangementsIndex(int index, const CornerArrangementTable* table, const unsigned short* edge_face_codes, int face_id_count,
+                               const unsigned long long* edge_colors);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Edge Arrangements
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// The edge search keeps the colors of the edge surfaces placed so far packed into a nibble each, a 16-bit group per face,
+// so it can check every face for an edge surface the color of its center or two touching at a diagonal with a few word
+// operations. See AddEdgeLanes() in ScrambleSearcher.cpp.
+constexpr auto EDGE_LANE_WORDS = 2;
+
+// The halves engine (--engine halves) only searches the first EDGE_HALF_DEPTH steps of the edge order. Every way of filling
+// the rest that passes the checks among its own edges is built once, and each partial arrangement that gets EDGE_HALF_DEPTH
+// deep is joined to the ones that use the pieces it has left, instead of searching below it.
+constexpr auto EDGE_HALF_DEPTH = 6;
+constexpr auto EDGE_HALF_EDGES = CUBE_EDGES - EDGE_HALF_DEPTH;
+
+// The second half of an edge arrangement: the pieces placed from step EDGE_HALF_DEPTH on.
+typedef struct {
+    unsigned long long lanes[EDGE_LANE_WORDS]; // XOR'ed into the first half's edge lanes, fills in this half's colors.
+    unsigned short face_codes[CUBE_FACES];     // This half's part of each face's edge face code, added to the first half's.
+    unsigned char pieces[EDGE_HALF_EDGES];
+    unsigned char oris;                        // Bit k is the orientation of pieces[k].
+    unsigned char swap_parity;                 // The parity of pieces[] against the order they start out in.
+} EdgeHalf;
+
+// Every second half for the edge order, grouped by the pieces it uses and its flip parity. Within a group the halves are
+// sorted by their part of the first face the second half completes, so the join only joins that face once for each run of
+// halves with the same part.
+typedef struct {
+    std::vector<EdgeHalf> halves;
+    std::vector<int> first_halves;  // first_halves[pieces * 2 + flip parity] is the first half in the group, where pieces has
+                                    // a bit for each piece. The group ends where the next one starts.
+    int key_rank;                   // The first face the second half completes, as a rank in face_completion_order.
+    unsigned char steps[CUBE_EDGES]; // The step each piece starts out at, which swap parities are measured against.
+} EdgeHalfTable;
+
+// Built by BuildEdgeHalves().
+extern EdgeHalfTable edge_half_table;
+
+// Build edge_half_table for the edge order. It has to be built again after SetEdgeOrder(), but not after SetSearchCriteria(),
+// since every criteria policy makes the same checks on the edges.
+void BuildEdgeHalves();
+
+// A checkpoint unit that is being searched. Tasks split off from it carry a pointer to it, and it is finished once the
+// task that started it and every task split off from it are done.
+typedef struct {
+    char prefix[CHECKPOINT_PREFIX_LENGTH + 1];
+    std::atomic<int> pending_tasks;          // Tasks for this unit that haven't finished.
+    std::mutex mutex;                        // Guards everything below.
+    std::string solutions[SOLUTION_CLASSES]; // Formatted by FormatSinkSolution(), and held until the unit is finished.
+    SearchTotals totals;
+} CheckpointUnit;
+
+// A subtree of the edge search: everything needed to call PlaceEdgePiece() for edge_num on some other thread.
+typedef struct {
+    CheckpointUnit* unit; // The unit this subtree is part of. NULL if it starts above CHECKPOINT_DEPTH.
+    unsigned char edge_num;
+    unsigned char pieces[CUBE_EDGES];
+    unsigned char cube[CUBE_SURFACES];
+    unsigned short edge_face_codes[CUBE_FACES];
+    char edge_progress[25];
+    unsigned char swap_parity;
+    unsigned char flip_parity;
+    int ep_corner_arrangements_index;
+    int op_corner_arrangements_index;
+} EdgeTask;
+
+// The arguments of one GetCornerArrangementsIndex() call, recorded for the join benchmark.
+typedef struct {
+    int index;
+    unsigned short edge_face_codes[CUBE_FACES];
+    unsigned char face_id_count;
+    unsigned char swap_parity;
+} JoinProbe;
+
+// The state of one edge search thread. Nothing in here is shared with other threads.
+typedef struct {
+    unsigned char pieces[CUBE_EDGES];           // The position of the edge pieces. pieces[3] = 5 means that edge piece 5 is in the position filled at step 3.
+    unsigned char cube[CUBE_SURFACES];          // The cube. Corner surfaces are 0 so they can be OR'ed in later.
+    unsigned short edge_face_codes[CUBE_FACES]; // The edges' contribution to each face, as edge face codes.
+    char edge_progress[25];                     // The pieces placed so far, for progress output.
+
+    unsigned long int edge_arrangements;
+    unsigned long int odd_edge_arrangements;
+    unsigned long int even_edge_arrangements;
+    unsigned long int solutions;
+    EdgeSearchStats stats; // Where this thread cut the tree since it last flushed them with FlushEdgeSearchStats().
+
+    WorkStealingPool<EdgeTask>* pool;  // NULL when searching on a single thread.
+    int worker;                        // This thread's worker number in the pool.
+
+    std::vector<JoinProbe>* join_probes; // If set, every corner join is logged here.
+    bool record_solutions;               // False to find solutions without writing them anywhere.
+    bool count_only;                     // Count each solution in counts instead of recording it. See CountSolution().
+    SearchTotals counts;                 // Solutions count_only has counted and not yet added to the unit and the totals.
+    bool print_progress;                 // False to keep the progress lines RecordSolution() prints off stdout.
+
+    const std::set<std::string>* finished_units; // If set, the search is split into checkpoint units and these units are skipped.
+    const std::set<std::string>* shard_units;    // If set, only these units are searched.
+    CheckpointUnit* unit;                        // The unit being searched, if any.
+
+    int symmetry_mode;                                   // SYMMETRY_NONE, SYMMETRY_REDUCE or SYMMETRY_EXPAND.
+    unsigned long long symmetry_masks[CUBE_EDGES + 1];   // symmetry_masks[N] has a bit for each symmetry that might still make
+                                                         // the cube come before itself once edge N is placed. 0 if not reducing.
+    unsigned long long edge_colors[CUBE_EDGES + 1][EDGE_COLOR_WORDS]; // edge_colors[N] is the colors of the first N edges placed, in
+                                                                      // a perfect-only search.
+    unsigned long long edge_lanes[CUBE_EDGES + 1][EDGE_LANE_WORDS];   // edge_lanes[N] is the packed colors of the first N edges placed.
+
+    struct CornerBitsetState* corner_bitsets; // If set, corners are joined with the bitset join instead of GetCornerArrangementsIndex().
+    const EdgeHalfTable* edge_halves;         // If set, the search stops EDGE_HALF_DEPTH edges deep and joins these second halves.
+} EdgeSearchState;
+
+// Ways to join the corner arrangements to the edges.
+constexpr auto CORNER_JOIN_WALK = 0;   // Walk the sorted corner tables with GetCornerArrangementsIndex().
+constexpr auto CORNER_JOIN_BITSET = 1; // AND together bitsets from CornerBitsets.h.
+
+// Ways to search the edge arrangements.
+constexpr auto EDGE_ENGINE_RECURSIVE = 0; // Place every edge with PlaceEdgePiece().
+constexpr auto EDGE_ENGINE_HALVES = 1;    // Place the first EDGE_HALF_DEPTH, then join the second halves from edge_half_table.
+
+// Set up a task for the whole edge search.
+void InitEdgeTask(EdgeTask* task);
+// Place the first edges as given by a prefix of the progress string, e.g. "3_0-A_" places piece 3 unflipped in the first
+// position in edge_order, piece 0 flipped in the second and piece A unflipped in the third. Returns false if the prefix is
+// malformed or can't lead to a solution with the default criteria.
+bool ApplyEdgePrefix(EdgeTask* task, const char* prefix);
+// Set up a search state for a single thread.
+void InitEdgeSearchState(EdgeSearchState* state);
+// Search the subtree of a task on this thread, with the search criteria.
+void RunEdgeTask(EdgeSearchState* state, const EdgeTask& task);
+
+// The SEARCH_CRITERIA_* policy from SearchCriteria.h the edge search runs with. The default until SetSearchCriteria().
+extern int search_criteria;
+// Search with another policy: build its perfect faces, and the edge face tables from them, and the corner tables'
+// adjacent_colors if it joins the edge colors and they aren't built yet. The corner bitsets have to be built again afterwards.
+void SetSearchCriteria(int criteria);
+
+// A checkpoint unit, with an estimate of how much of the edge search is below it.
+typedef struct {
+    char prefix[CHECKPOINT_PREFIX_LENGTH + 1];
+    unsigned long long nodes; // Partial edge arrangements some way below the unit's prefix that pass every check.
+} UnitEstimate;
+
+// List every checkpoint unit a search with the state's symmetry mode and corner join would start, in the order it would
+// start them, each with the partial edge arrangements estimate_depth edges below it that pass every check. The state is
+// only used for scratch space.
+void EstimateCheckpointUnits(EdgeSearchState* state, int estimate_depth, std::vector<UnitEstimate>* units);
@@ -0,0 +1,16 @@
+#include "SearchCriteria.h"
+#include <string.h>
+
+const char* const search_criteria_names[SEARCH_CRITERIA_COUNT] = { "default", "five-patterns", "five-colors", "perfect" };
+
+
+bool ParseSearchCriteria(const char* name, int* criteria)
+{
+    for (int i = 0; i < SEARCH_CRITERIA_COUNT; ++i) {
+        if (strcmp(name, search_criteria_names[i]) == 0) {
+            *criteria = i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+// The criteria a scramble has to meet, numbered as in the README, as policies for the search templates. Every check the
+// search makes for a criterion is compiled in or left out by the policy, so a search with relaxed criteria runs the same
+// code as any other, without testing its configuration at each node.
+//
+//   ALL_COLORS               - 1. Every color is on every face. Otherwise a face can be missing colors.
+//   MAX_COLOR_COUNT          - 2. The most surfaces of one color on a face.
+//   SIDES_MAY_TOUCH          - Not 3. Surfaces of the same color may touch on a side on a face.
+//   CORNERS_MAY_TOUCH        - Not 4. Surfaces of the same color may touch at a corner on a face.
+//   ADJACENT_FACES_MAY_TOUCH - Not 5. Solutions with surfaces of the same color touching at a corner on adjacent faces are
+//                              kept, in the solution files without _Perfect in their names. Otherwise the corner join rules
+//                              them out.
+//   MIN_UNIQUE_PATTERNS      - 6, loosened. Only keep solutions with at least this many different face patterns.
+//   FACE_PATTERNS            - How many face patterns meet criteria 1-4, which BuildPerfectFaces() checks it finds.
+//
+// Every policy joins against the same Corners.dat, which only holds corner arrangements that meet criteria 2 and 4, and the
+// solution classes tell criterion 5 apart from nothing touching at all, which takes criterion 3. So the search only takes
+// policies that keep criteria 2-4; see CheckSearchCriteria(). Relaxing criterion 2 or 4 would need a corner table of its own,
+// with 1.3 million or 62 million arrangements instead of 750,000.
+struct DefaultCriteria {
+    static constexpr bool ALL_COLORS = true;
+    static constexpr int MAX_COLOR_COUNT = 2;
+    static constexpr bool SIDES_MAY_TOUCH = false;
+    static constexpr bool CORNERS_MAY_TOUCH = false;
+    static constexpr bool ADJACENT_FACES_MAY_TOUCH = true;
+    static constexpr int MIN_UNIQUE_PATTERNS = 1;
+    static constexpr int FACE_PATTERNS = 16;
+};
+
+// Only solutions with five or six different face patterns.
+struct FivePatternsCriteria : DefaultCriteria {
+    static constexpr int MIN_UNIQUE_PATTERNS = 5;
+};
+
+// Faces may be missing a color. With no more than two of each, a face still has at least five.
+struct FiveColorsCriteria : DefaultCriteria {
+    static constexpr bool ALL_COLORS = false;
+    static constexpr int FACE_PATTERNS = 21;
+};
+
+// Only the _Perfect solutions. The edge search joins the corners to the colors of every edge placed so far, so it gives up on
+// edges that can only lead to adjacent faces touching instead of finding those solutions and throwing them away.
+struct PerfectCriteria : DefaultCriteria {
+    static constexpr bool ADJACENT_FACES_MAY_TOUCH = false;
+};
+
+// The search can only take policies that agree with Corners.dat and the solution classes.
+template <typename Criteria>
+constexpr bool CheckSearchCriteria()
+{
+    static_assert(Criteria::MAX_COLOR_COUNT == 2, "Corners.dat only holds corner arrangements with no more than two surfaces of a color on a face.");
+    static_assert(!Criteria::CORNERS_MAY_TOUCH, "Corners.dat only holds corner arrangements with no corner touching its center's color.");
+    static_assert(!Criteria::SIDES_MAY_TOUCH, "The solution classes can't tell adjacent faces touching apart from sides touching.");
+    static_assert((Criteria::MIN_UNIQUE_PATTERNS >= 1) && (Criteria::MIN_UNIQUE_PATTERNS <= 6), "A cube has 1 to 6 different face patterns.");
+    static_assert(Criteria::FACE_PATTERNS <= 256, "Face pattern ids must fit in a byte.");
+    return true;
+}
+
+// The built-in policies, which the search picks between at run time with SetSearchCriteria().
+constexpr auto SEARCH_CRITERIA_DEFAULT = 0;       // DefaultCriteria
+constexpr auto SEARCH_CRITERIA_FIVE_PATTERNS = 1; // FivePatternsCriteria
+constexpr auto SEARCH_CRITERIA_FIVE_COLORS = 2;   // FiveColorsCriteria
+constexpr auto SEARCH_CRITERIA_PERFECT = 3;       // PerfectCriteria
+constexpr auto SEARCH_CRITERIA_COUNT = 4;
+
+// Their names on the command line and in checkpoints: "default", "five-patterns", "five-colors" and "perfect".
+extern const char* const search_criteria_names[SEARCH_CRITERIA_COUNT];
+
+// Look up a built-in policy by name. Returns false if there isn't one called that.
+bool ParseSearchCriteria(const char* name, int* criteria);
+
+// An initializer for a table of function, instanced for each built-in policy, in the order of their numbers. Code that isn't a
+// template itself picks the instance for a policy out of the table, once, and calls that.
+#define SEARCH_CRITERIA_INSTANCES(function) { function<DefaultCriteria>, function<FivePatternsCriteria>, function<FiveColorsCriteria>, function<PerfectCriteria> }
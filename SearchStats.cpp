@@ -0,0 +1,161 @@
+#include "SearchStats.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+CornerSearchStats corner_search_stats;
+
+// Everything below is guarded by report_mutex.
+std::mutex report_mutex;
+EdgeSearchStats report_edge_stats;
+std::chrono::steady_clock::time_point report_start = std::chrono::steady_clock::now();
+std::chrono::steady_clock::time_point phase_starts[SEARCH_PHASES];
+double phase_seconds[SEARCH_PHASES];
+bool phase_running[SEARCH_PHASES];
+
+std::string report_filename;
+std::thread report_writer;
+std::condition_variable report_stop_needed;
+bool report_stopping = false;
+
+const char* phase_names[SEARCH_PHASES] = { "perfect_faces", "corners", "bitsets", "edge_search", "write" };
+const char* prune_names[PRUNE_REASONS] = { "center_color", "edge_diagonal", "symmetry", "face_join" };
+const char* corner_prune_names[CORNER_PRUNE_REASONS] = { "center_color", "three_of_a_color" };
+
+
+void FlushEdgeSearchStats(EdgeSearchStats* stats)
+{
+    std::lock_guard<std::mutex> lock(report_mutex);
+    for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+        report_edge_stats.nodes[edge_num] += stats->nodes[edge_num];
+        for (int reason = 0; reason < PRUNE_REASONS; ++reason) {
+            report_edge_stats.pruned[edge_num][reason] += stats->pruned[edge_num][reason];
+        }
+    }
+    report_edge_stats.joins += stats->joins;
+    report_edge_stats.join_skipped_keys += stats->join_skipped_keys;
+
+    memset(stats, 0, sizeof(EdgeSearchStats));
+}
+
+
+void StartSearchPhase(int phase)
+{
+    std::lock_guard<std::mutex> lock(report_mutex);
+    phase_starts[phase] = std::chrono::steady_clock::now();
+    phase_running[phase] = true;
+}
+
+
+void EndSearchPhase(int phase)
+{
+    std::lock_guard<std::mutex> lock(report_mutex);
+    if (phase_running[phase]) {
+        phase_seconds[phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - phase_starts[phase]).count();
+        phase_running[phase] = false;
+    }
+}
+
+
+// Write the report to a temporary file and rename it over the old one, like the checkpoint. Call with report_mutex held.
+bool WriteSearchReport()
+{
+    std::string temp_filename = report_filename + ".tmp";
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, temp_filename.c_str(), "w");
+    if ((result != 0) || (fp == NULL)) {
+        fprintf(stderr, "Unable to open report file: %s\n", temp_filename.c_str());
+        return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    fprintf(fp, "{\n  \"elapsed_seconds\": %.3f,\n  \"phases\": {", std::chrono::duration<double>(now - report_start).count());
+    for (int phase = 0; phase < SEARCH_PHASES; ++phase) {
+        double seconds = phase_seconds[phase];
+        if (phase_running[phase]) {
+            seconds += std::chrono::duration<double>(now - phase_starts[phase]).count();
+        }
+        fprintf(fp, "%s\"%s\": %.3f", (phase == 0) ? " " : ", ", phase_names[phase], seconds);
+    }
+
+    const EdgeSearchStats& edges = report_edge_stats;
+    fprintf(fp, " },\n  \"edge_search\": {\n    \"joins\": %llu,\n    \"join_skipped_keys\": %llu,\n    \"depths\": [\n",
+        edges.joins, edges.join_skipped_keys);
+    for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+        fprintf(fp, "      { \"edge\": %i, \"nodes\": %llu", edge_num, edges.nodes[edge_num]);
+        for (int reason = 0; reason < PRUNE_REASONS; ++reason) {
+            fprintf(fp, ", \"%s\": %llu", prune_names[reason], edges.pruned[edge_num][reason]);
+        }
+        fprintf(fp, " }%s\n", (edge_num + 1 < CUBE_EDGES) ? "," : "");
+    }
+
+    fprintf(fp, "    ]\n  },\n  \"corner_search\": {\n    \"depths\": [\n");
+    for (int corner_num = 0; corner_num < CUBE_CORNERS; ++corner_num) {
+        fprintf(fp, "      { \"corner\": %i, \"nodes\": %llu", corner_num, corner_search_stats.nodes[corner_num]);
+        for (int reason = 0; reason < CORNER_PRUNE_REASONS; ++reason) {
+            fprintf(fp, ", \"%s\": %llu", corner_prune_names[reason], corner_search_stats.pruned[corner_num][reason]);
+        }
+        fprintf(fp, " }%s\n", (corner_num + 1 < CUBE_CORNERS) ? "," : "");
+    }
+    fprintf(fp, "    ]\n  }\n}\n");
+
+    bool written = !ferror(fp);
+    fclose(fp);
+    if (!written) {
+        fprintf(stderr, "Writing %s failed.\n", temp_filename.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename() won't replace an existing file on Windows.
+    remove(report_filename.c_str());
+#endif
+    if (rename(temp_filename.c_str(), report_filename.c_str()) != 0) {
+        fprintf(stderr, "Unable to rename %s to %s.\n", temp_filename.c_str(), report_filename.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+void SearchReportWriter()
+{
+    std::unique_lock<std::mutex> lock(report_mutex);
+    while (!report_stopping) {
+        report_stop_needed.wait_for(lock, std::chrono::seconds(REPORT_INTERVAL_SECONDS));
+        WriteSearchReport();
+    }
+}
+
+
+bool StartSearchReport(const char* filename)
+{
+    std::lock_guard<std::mutex> lock(report_mutex);
+    report_filename = filename;
+    report_stopping = false;
+    if (!WriteSearchReport()) {
+        return false;
+    }
+
+    report_writer = std::thread(SearchReportWriter);
+    return true;
+}
+
+
+void StopSearchReport()
+{
+    if (!report_writer.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(report_mutex);
+        report_stopping = true;
+    }
+    report_stop_needed.notify_one();
+    report_writer.join();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ScrambleEvaluation.h"
+
+// Counters for where the search cuts the tree, and how long each phase takes. Each edge search thread counts into its own
+// EdgeSearchStats and adds them to the report's totals now and then, so counting never touches shared memory. The report
+// is written as JSON every REPORT_INTERVAL_SECONDS while searching, and once more at the end.
+constexpr auto REPORT_INTERVAL_SECONDS = 10;
+
+// Why the edge search gave up on a piece at a position.
+constexpr auto PRUNE_CENTER_COLOR = 0;  // An edge surface is the color of its face's center.
+constexpr auto PRUNE_EDGE_DIAGONAL = 1; // Two edge surfaces touching at a diagonal are the same color.
+constexpr auto PRUNE_SYMMETRY = 2;      // Some symmetry makes the cube come before itself, in a symmetry-reduced search.
+constexpr auto PRUNE_FACE_JOIN = 3;     // No corner arrangement makes perfect faces with the edges placed so far (and, in a
+                                        // perfect-only search, keeps clear of their colors on the adjacent faces).
+constexpr auto PRUNE_REASONS = 4;
+
+// Why creating the corner arrangements gave up on a piece at a position.
+constexpr auto CORNER_PRUNE_CENTER_COLOR = 0;     // A corner surface is the color of its face's center.
+constexpr auto CORNER_PRUNE_THREE_OF_A_COLOR = 1; // Three corner surfaces on a face are the same color.
+constexpr auto CORNER_PRUNE_REASONS = 2;
+
+// The timed phases of a run.
+constexpr auto PHASE_PERFECT_FACES = 0; // BuildPerfectFaces().
+constexpr auto PHASE_CORNERS = 1;       // Reading or creating the corner arrangements.
+constexpr auto PHASE_BITSETS = 2;       // BuildCornerBitsets(), for the bitset join.
+constexpr auto PHASE_EDGE_SEARCH = 3;   // TryEdgeArrangements().
+constexpr auto PHASE_WRITE = 4;         // Writing out what's left in the solution sink.
+constexpr auto SEARCH_PHASES = 5;
+
+typedef struct {
+    unsigned long long nodes[CUBE_EDGES];                 // Pieces and orientations tried at each edge position.
+    unsigned long long pruned[CUBE_EDGES][PRUNE_REASONS]; // The ones given up on, by reason.
+    unsigned long long joins;                             // GetCornerArrangementsIndex() calls. The bitset join doesn't make any.
+    unsigned long long join_skipped_keys;                 // Corner arrangement keys the ones that found a match skipped over.
+} EdgeSearchStats;
+
+typedef struct {
+    unsigned long long nodes[CUBE_CORNERS];
+    unsigned long long pruned[CUBE_CORNERS][CORNER_PRUNE_REASONS];
+} CornerSearchStats;
+
+// Filled in by CreateCornerArrangements(), which runs on a single thread.
+extern CornerSearchStats corner_search_stats;
+
+// Add a thread's counters to the report's totals and zero them. Safe to call from any number of threads.
+void FlushEdgeSearchStats(EdgeSearchStats* stats);
+
+void StartSearchPhase(int phase);
+void EndSearchPhase(int phase);
+
+// Write the report to filename every REPORT_INTERVAL_SECONDS on a background thread, until StopSearchReport(), which
+// writes it one last time. Returns false if the report can't be written.
+bool StartSearchReport(const char* filename);
+void StopSearchReport();
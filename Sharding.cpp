@@ -0,0 +1,253 @@
+#include "Sharding.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "Checkpoint.h"
+#include "CornerBitsets.h"
+#include "PlacementOrder.h"
+#include "ScrambleSearcher.h"
+#include "SolutionFormat.h"
+#include "Symmetry.h"
+
+
+bool ParseShard(const char* text, int* shard, int* shard_count)
+{
+    char extra;
+    return (sscanf(text, "%d/%d%c", shard, shard_count, &extra) == 2) && (*shard_count >= 2) && (*shard >= 1) && (*shard <= *shard_count);
+}
+
+
+// Biggest first, then by prefix so every shard sorts them the same way.
+bool CompareUnitEstimates(const UnitEstimate& a, const UnitEstimate& b)
+{
+    if (a.nodes != b.nodes) {
+        return a.nodes > b.nodes;
+    }
+    return strcmp(a.prefix, b.prefix) < 0;
+}
+
+
+unsigned int GetShardUnits(int shard, int shard_count, int symmetry_mode, std::set<std::string>* units)
+{
+    // The estimate is the same whichever join makes it, and the walk join is much quicker when the edge order allows it.
+    EdgeSearchState state;
+    InitEdgeSearchState(&state);
+    state.symmetry_mode = symmetry_mode;
+    CornerBitsetState* corner_bitsets = NULL;
+    if (!EdgeOrderCompletesFacesInOrder()) {
+        corner_bitsets = new CornerBitsetState;
+        state.corner_bitsets = corner_bitsets;
+    }
+
+    std::vector<UnitEstimate> estimates;
+    EstimateCheckpointUnits(&state, SHARD_ESTIMATE_DEPTH, &estimates);
+    delete corner_bitsets;
+
+    // Hand each unit, biggest first, to the shard with the least work so far.
+    std::sort(estimates.begin(), estimates.end(), CompareUnitEstimates);
+    std::vector<unsigned long long> shard_nodes(shard_count, 0);
+    units->clear();
+    for (size_t i = 0; i < estimates.size(); ++i) {
+        int lightest = (int)(std::min_element(shard_nodes.begin(), shard_nodes.end()) - shard_nodes.begin());
+        shard_nodes[lightest] += estimates[i].nodes;
+        if (lightest == shard - 1) {
+            units->insert(estimates[i].prefix);
+        }
+    }
+
+    return (unsigned int)estimates.size();
+}
+
+
+// Copy size bytes from fp to out.
+bool CopySolutions(FILE* fp, unsigned long long size, FILE* out)
+{
+    const size_t COPY_BYTES = 1 << 20;
+    static char buffer[COPY_BYTES];
+
+    while (size > 0) {
+        size_t part = (size_t)std::min<unsigned long long>(size, COPY_BYTES);
+        if ((fread(buffer, 1, part, fp) != part) || (fwrite(buffer, 1, part, out) != part)) {
+            return false;
+        }
+        size -= part;
+    }
+    return true;
+}
+
+
+// Add the solutions a shard's checkpoint counts in one of its solution files to the end of out. The file has to be exactly
+// the size the checkpoint says, or the two disagree on what the shard found.
+bool MergeShardFile(const char* directory, const SearchCheckpoint& checkpoint, int solution_class, FILE* out)
+{
+    char base_name[50];
+    SolutionFileBaseName(solution_class, checkpoint.solution_format, base_name);
+    char filename[400];
+    sprintf_s(filename, sizeof(filename), "%s/%s", directory, base_name);
+
+    unsigned long long size = checkpoint.file_sizes[solution_class];
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, filename, "rb");
+    if ((result != 0) || (fp == NULL)) {
+        if (size == 0) {
+            return true;
+        }
+        fprintf(stderr, "Unable to open solution file: %s\n", filename);
+        return false;
+    }
+
+    bool binary = checkpoint.solution_format == SOLUTION_FORMAT_BINARY;
+    unsigned long long expected_end = binary ? SOLUTION_HEADER_SIZE + size * SOLUTION_RECORD_SIZE : size;
+    unsigned long long end = SolutionFileEnd(fp);
+    rewind(fp);
+    if (end != expected_end) {
+        fprintf(stderr, "%s is %llu bytes, but its checkpoint says it should be %llu.\n", filename, end, expected_end);
+        fclose(fp);
+        return false;
+    }
+
+    bool valid = true;
+    if (binary) {
+        SolutionFileHeader header;
+        valid = ReadSolutionFileHeader(fp, &header) && (header.count == size) && (header.criteria == (unsigned int)checkpoint.criteria);
+        size *= SOLUTION_RECORD_SIZE;
+    }
+    valid = valid && CopySolutions(fp, size, out);
+    fclose(fp);
+
+    if (!valid) {
+        fprintf(stderr, "%s doesn't match its checkpoint, or isn't a solution file.\n", filename);
+    }
+    return valid;
+}
+
+
+bool MergeShards(int directory_count, char* const directories[])
+{
+    // Merging into a shard's own directory would overwrite its solution files while they are being read.
+    FILE* fp = NULL;
+    if ((fopen_s(&fp, CHECKPOINT_FILE, "r") == 0) && (fp != NULL)) {
+        fclose(fp);
+        fprintf(stderr, "There is already a %s here. Merge the shards into an empty directory.\n", CHECKPOINT_FILE);
+        return false;
+    }
+
+    std::vector<SearchCheckpoint> shards(directory_count);
+    for (int i = 0; i < directory_count; ++i) {
+        char filename[400];
+        sprintf_s(filename, sizeof(filename), "%s/%s", directories[i], CHECKPOINT_FILE);
+        if (!ReadCheckpoint(filename, &shards[i])) {
+            return false;
+        }
+    }
+
+    // Every shard has to be from the same search, there has to be exactly one of each, and each has to be finished.
+    const SearchCheckpoint& first = shards[0];
+    if (first.shard_count < 2) {
+        fprintf(stderr, "%s isn't a shard of a sharded search.\n", directories[0]);
+        return false;
+    }
+    if (directory_count != first.shard_count) {
+        fprintf(stderr, "The search was split into %i shards, but %i were given.\n", first.shard_count, directory_count);
+        return false;
+    }
+    std::vector<bool> seen(first.shard_count + 1, false);
+    for (int i = 0; i < directory_count; ++i) {
+        const SearchCheckpoint& shard = shards[i];
+        if ((shard.shard_count != first.shard_count) || (shard.solution_format != first.solution_format) || (shard.symmetry_mode != first.symmetry_mode) ||
+            (memcmp(shard.edge_order, first.edge_order, sizeof(shard.edge_order)) != 0) || (shard.criteria != first.criteria) ||
+            (shard.total_units != first.total_units)) {
+            fprintf(stderr, "%s is a shard of a different search than %s.\n", directories[i], directories[0]);
+            return false;
+        }
+        if (seen[shard.shard]) {
+            fprintf(stderr, "Shard %i/%i was given twice.\n", shard.shard, shard.shard_count);
+            return false;
+        }
+        seen[shard.shard] = true;
+        if (shard.finished.size() != shard.shard_units) {
+            fprintf(stderr, "Shard %i/%i in %s has only finished %i of its %u units.\n", shard.shard, shard.shard_count, directories[i],
+                    (int)shard.finished.size(), shard.shard_units);
+            return false;
+        }
+    }
+
+    SearchCheckpoint merged;
+    InitSearchCheckpoint(&merged, first.solution_format, first.symmetry_mode);
+    memcpy(merged.edge_order, first.edge_order, sizeof(merged.edge_order));
+    merged.criteria = first.criteria;
+    for (int i = 0; i < directory_count; ++i) {
+        merged.finished.insert(shards[i].finished.begin(), shards[i].finished.end());
+        AddSearchTotals(&merged.totals, shards[i].totals);
+        for (int j = 0; j < SOLUTION_CLASSES; ++j) {
+            merged.file_sizes[j] += shards[i].file_sizes[j];
+        }
+    }
+    if (merged.finished.size() != first.total_units) {
+        fprintf(stderr, "The shards searched %i units between them, not %u. They were split differently.\n", (int)merged.finished.size(), first.total_units);
+        return false;
+    }
+
+    // Like the search, only make solution files that have solutions in them.
+    if (merged.solution_format != SOLUTION_FORMAT_COUNT) {
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            if (merged.file_sizes[i] == 0) {
+                continue;
+            }
+            char filename[50];
+            SolutionFileBaseName(i, merged.solution_format, filename);
+            FILE* out = NULL;
+            errno_t result = fopen_s(&out, filename, "wb");
+            if ((result != 0) || (out == NULL)) {
+                fprintf(stderr, "Unable to open solution file: %s\n", filename);
+                return false;
+            }
+
+            bool valid = true;
+            if (merged.solution_format == SOLUTION_FORMAT_BINARY) {
+                SolutionFileHeader header;
+                InitSolutionFileHeader(&header, (i % 6) + 1, i >= 6, merged.criteria);
+                header.count = merged.file_sizes[i];
+                valid = WriteSolutionFileHeader(out, header);
+            }
+            for (int j = 1; valid && (j <= first.shard_count); ++j) {
+                // The shards go in order, whatever order the directories were given in.
+                int k = 0;
+                while (shards[k].shard != j) {
+                    ++k;
+                }
+                valid = MergeShardFile(directories[k], shards[k], i, out);
+            }
+            valid = (fclose(out) == 0) && valid;
+            if (!valid) {
+                fprintf(stderr, "Failed to write %s.\n", filename);
+                return false;
+            }
+        }
+    }
+
+    // The checkpoint goes last, so it only says the search is finished once every solution file is complete.
+    if (!WriteCheckpoint(CHECKPOINT_FILE, merged)) {
+        return false;
+    }
+
+    printf("Merged %i shards with %i units.\n", first.shard_count, (int)merged.finished.size());
+    printf("%llu edge arrangements.\n", merged.totals.edge_arrangements);
+    printf("%llu even edge arrangements.\n", merged.totals.even_edge_arrangements);
+    printf("%llu odd edge arrangements.\n", merged.totals.odd_edge_arrangements);
+    printf("Solutions:");
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        printf(" %llu", merged.totals.solution_counts[i]);
+    }
+    printf("\n");
+    if (merged.symmetry_mode != SYMMETRY_NONE) {
+        printf("Solutions counting symmetric ones:");
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            printf(" %llu", merged.totals.all_solution_counts[i]);
+        }
+        printf("\n");
+    }
+    return true;
+}
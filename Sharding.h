@@ -0,0 +1,27 @@
+#pragma once
+
+#include <set>
+#include <string>
+
+// A search can be split into shards that run as separate processes, on one machine or on many, sharing nothing but the
+// program and Corners.dat. Each shard searches its own share of the checkpoint units, in its own directory, and the
+// finished shards are merged back together with MergeShards().
+//
+// The units are shared out by an estimate of the edge search below each one, worked out the same way by every shard, so the
+// shards agree on who searches what without talking to each other, and each gets about the same amount of work.
+
+// How far below CHECKPOINT_DEPTH the estimate walks the edge search.
+constexpr auto SHARD_ESTIMATE_DEPTH = 2;
+
+// Parse "i/N" for shard i of N, counting from 1. N must be at least 2.
+bool ParseShard(const char* text, int* shard, int* shard_count);
+
+// Work out the checkpoint units of shard of shard_count for a search with symmetry_mode. Needs the edge order, the corner
+// tables and InitCubeSymmetries(), and the corner bitsets if the edge order doesn't complete the faces in order.
+// Returns the number of units across all the shards.
+unsigned int GetShardUnits(int shard, int shard_count, int symmetry_mode, std::set<std::string>* units);
+
+// Merge the shards of a finished search, one directory per shard, into solution files and a checkpoint in the current
+// directory, as if a single search had found everything. Every shard has to be there and finished. The solution files
+// hold the shards' solutions one shard after another.
+bool MergeShards(int directory_count, char* const directories[]);
@@ -0,0 +1,328 @@
+#include "SolutionDedupe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "PlacementOrder.h"
+#include "SolutionFormat.h"
+#include "Symmetry.h"
+
+// A canonical solution's binary record, then how many solutions it stands for.
+typedef struct {
+    unsigned char bytes[CANONICAL_RECORD_SIZE];
+} CanonicalRecord;
+
+// Reads solutions one at a time from a text or binary solution file.
+typedef struct {
+    FILE* fp;
+    const char* filename;
+    bool binary;
+    SolutionFileHeader header;    // Binary files only.
+    unsigned long long remaining; // Binary files only. Records left to read.
+    unsigned long long line;      // Text files only. The line last read.
+} SolutionReader;
+
+
+// The last byte follows from the rest, so only the binary record counts.
+bool CompareCanonicalRecords(const CanonicalRecord& a, const CanonicalRecord& b)
+{
+    return memcmp(a.bytes, b.bytes, SOLUTION_RECORD_SIZE) < 0;
+}
+
+
+bool SameCanonicalRecords(const CanonicalRecord& a, const CanonicalRecord& b)
+{
+    return memcmp(a.bytes, b.bytes, SOLUTION_RECORD_SIZE) == 0;
+}
+
+
+int CanonicalizeSolution(const unsigned char cube[CUBE_SURFACES], unsigned char canonical[CUBE_SURFACES])
+{
+    // The surfaces CompareSymmetryKeys() looks at, in its order.
+    unsigned char key_surfaces[CUBE_EDGES + CUBE_CORNERS];
+    for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+        key_surfaces[edge_num] = edge_positions[edge_num][0];
+    }
+    for (int corner_num = 0; corner_num < CUBE_CORNERS; ++corner_num) {
+        key_surfaces[CUBE_EDGES + corner_num] = corners[corner_num][0];
+    }
+
+    // Compare each symmetric cube with the cube itself and with the first one so far, one key surface at a time, without
+    // building it. Most of them are settled by the first surface or two.
+    int first = 0;
+    int fixed = 1;
+    for (int symmetry = 1; symmetry < CUBE_SYMMETRIES; ++symmetry) {
+        const unsigned char* moves = symmetry_surfaces[symmetry];
+        const unsigned char* sources = symmetry_sources[symmetry];
+        const unsigned char* first_moves = symmetry_surfaces[first];
+        const unsigned char* first_sources = symmetry_sources[first];
+
+        int self_order = 0;
+        int first_order = 0;
+        for (int i = 0; (i < CUBE_EDGES + CUBE_CORNERS) && ((self_order == 0) || (first_order == 0)); ++i) {
+            int surface = key_surfaces[i];
+            int value = moves[cube[sources[surface]]];
+            if (self_order == 0) {
+                self_order = value - cube[surface];
+            }
+            if (first_order == 0) {
+                first_order = value - first_moves[cube[first_sources[surface]]];
+            }
+        }
+
+        if (self_order == 0) {
+            ++fixed;
+        }
+        if (first_order < 0) {
+            first = symmetry;
+        }
+    }
+
+    ApplySymmetry(first, cube, canonical);
+    return CUBE_SYMMETRIES / fixed;
+}
+
+
+// Open a solution file and work out which format it's in from its first bytes.
+bool OpenSolutionReader(const char* filename, SolutionReader* reader)
+{
+    reader->fp = NULL;
+    reader->filename = filename;
+    reader->line = 0;
+    memset(&reader->header, 0, sizeof(reader->header));
+    errno_t result = fopen_s(&reader->fp, filename, "rb");
+    if ((result != 0) || (reader->fp == NULL)) {
+        fprintf(stderr, "Unable to open solution file: %s\n", filename);
+        return false;
+    }
+
+    reader->binary = ReadSolutionFileHeader(reader->fp, &reader->header);
+    reader->remaining = reader->binary ? reader->header.count : 0;
+    if (!reader->binary && (fseek(reader->fp, 0, SEEK_SET) != 0)) {
+        fclose(reader->fp);
+        return false;
+    }
+    return true;
+}
+
+
+// Read the next solution. Returns false at the end of the file, or if the file is damaged, with *valid set to false.
+bool ReadNextSolution(SolutionReader* reader, unsigned char cube[CUBE_SURFACES], bool* valid)
+{
+    *valid = true;
+    if (reader->binary) {
+        unsigned char record[SOLUTION_RECORD_SIZE];
+        if (reader->remaining == 0) {
+            return false;
+        }
+        if (fread(record, SOLUTION_RECORD_SIZE, 1, reader->fp) != 1) {
+            fprintf(stderr, "%s is truncated - the header says %llu more solutions.\n", reader->filename, reader->remaining);
+            *valid = false;
+            return false;
+        }
+        --reader->remaining;
+        UnpackSolution(record, cube);
+        return true;
+    }
+
+    char line[CUBE_SURFACES * 4];
+    if (fgets(line, sizeof(line), reader->fp) == NULL) {
+        return false;
+    }
+    ++reader->line;
+
+    // 54 surface ids, each used once, separated by commas.
+    bool used[CUBE_SURFACES];
+    memset(used, 0, sizeof(used));
+    const char* text = line;
+    for (int i = 0; (i < CUBE_SURFACES) && *valid; ++i) {
+        char* end;
+        long surface = strtol(text, &end, 10);
+        *valid = (end != text) && (surface >= 0) && (surface < CUBE_SURFACES) && !used[surface] && (*end == ((i < CUBE_SURFACES - 1) ? ',' : *end));
+        if (*valid) {
+            used[surface] = true;
+            cube[i] = (unsigned char)surface;
+            text = end + ((i < CUBE_SURFACES - 1) ? 1 : 0);
+        }
+    }
+    *valid = *valid && ((*text == '\n') || (*text == '\r') || (*text == '\0'));
+    if (!*valid) {
+        fprintf(stderr, "Line %llu of %s isn't a solution.\n", reader->line, reader->filename);
+        return false;
+    }
+    return true;
+}
+
+
+// Write a canonical solution in the format of the file it came from.
+bool WriteCanonicalRecord(FILE* out, bool binary, const CanonicalRecord& record, DedupeTotals* totals)
+{
+    ++totals->canonical_solutions;
+    totals->represented_solutions += record.bytes[SOLUTION_RECORD_SIZE];
+    if (binary) {
+        return fwrite(record.bytes, CANONICAL_RECORD_SIZE, 1, out) == 1;
+    }
+
+    unsigned char cube[CUBE_SURFACES];
+    char line[CUBE_SURFACES * 3];
+    UnpackSolution(record.bytes, cube);
+    int length = FormatCanonicalSolution(line, cube, record.bytes[SOLUTION_RECORD_SIZE]);
+    return fwrite(line, 1, length, out) == (size_t)length;
+}
+
+
+// Sort a run and drop the solutions that are in it more than once.
+void SortCanonicalRun(std::vector<CanonicalRecord>* run)
+{
+    std::sort(run->begin(), run->end(), CompareCanonicalRecords);
+    run->erase(std::unique(run->begin(), run->end(), SameCanonicalRecords), run->end());
+}
+
+
+// Sort a run and write it to the next temporary file, then empty it.
+bool WriteCanonicalRun(const char* out_filename, std::vector<CanonicalRecord>* run, std::vector<std::string>* run_files)
+{
+    SortCanonicalRun(run);
+    char run_file[400];
+    sprintf_s(run_file, sizeof(run_file), "%s.run%i", out_filename, (int)run_files->size());
+    run_files->push_back(run_file);
+
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, run_file, "wb");
+    bool valid = (result == 0) && (fp != NULL) && (fwrite(run->data(), sizeof(CanonicalRecord), run->size(), fp) == run->size());
+    valid = (fp != NULL) && (fclose(fp) == 0) && valid;
+    if (!valid) {
+        fprintf(stderr, "Failed to write %s.\n", run_file);
+    }
+    run->clear();
+    return valid;
+}
+
+
+// Merge the sorted runs, writing each canonical solution once.
+bool MergeCanonicalRuns(const std::vector<std::string>& run_files, FILE* out, bool binary, DedupeTotals* totals)
+{
+    std::vector<FILE*> runs(run_files.size(), NULL);
+    std::vector<CanonicalRecord> heads(run_files.size());
+    std::vector<bool> live(run_files.size(), false);
+    bool valid = true;
+    for (size_t i = 0; i < run_files.size(); ++i) {
+        if ((fopen_s(&runs[i], run_files[i].c_str(), "rb") != 0) || (runs[i] == NULL)) {
+            fprintf(stderr, "Unable to open %s.\n", run_files[i].c_str());
+            runs[i] = NULL;
+            valid = false;
+            continue;
+        }
+        live[i] = fread(heads[i].bytes, CANONICAL_RECORD_SIZE, 1, runs[i]) == 1;
+    }
+
+    // There are only a few runs, so finding the smallest head each time is quick enough.
+    bool written = false;
+    CanonicalRecord last;
+    while (valid) {
+        int smallest = -1;
+        for (int i = 0; i < (int)runs.size(); ++i) {
+            if (live[i] && ((smallest == -1) || CompareCanonicalRecords(heads[i], heads[smallest]))) {
+                smallest = i;
+            }
+        }
+        if (smallest == -1) {
+            break;
+        }
+
+        if (!written || !SameCanonicalRecords(heads[smallest], last)) {
+            last = heads[smallest];
+            written = true;
+            valid = WriteCanonicalRecord(out, binary, last, totals);
+        }
+        live[smallest] = fread(heads[smallest].bytes, CANONICAL_RECORD_SIZE, 1, runs[smallest]) == 1;
+    }
+
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (runs[i] != NULL) {
+            fclose(runs[i]);
+        }
+    }
+    return valid;
+}
+
+
+bool DedupeSolutionFile(const char* filename, const char* out_filename, int run_solutions, DedupeTotals* totals)
+{
+    memset(totals, 0, sizeof(DedupeTotals));
+    SolutionReader reader;
+    if (!OpenSolutionReader(filename, &reader)) {
+        return false;
+    }
+
+    // Sort the solutions a run at a time. Every full run goes to a temporary file.
+    std::vector<CanonicalRecord> run;
+    run.reserve(run_solutions);
+    std::vector<std::string> run_files;
+    bool valid = true;
+    unsigned char cube[CUBE_SURFACES];
+    while (ReadNextSolution(&reader, cube, &valid)) {
+        unsigned char canonical[CUBE_SURFACES];
+        CanonicalRecord record;
+        record.bytes[SOLUTION_RECORD_SIZE] = (unsigned char)CanonicalizeSolution(cube, canonical);
+        PackSolution(canonical, record.bytes);
+        run.push_back(record);
+        ++totals->solutions;
+
+        if (((int)run.size() == run_solutions) && !WriteCanonicalRun(out_filename, &run, &run_files)) {
+            valid = false;
+            break;
+        }
+    }
+    fclose(reader.fp);
+    if (valid && !run_files.empty() && !run.empty()) {
+        valid = WriteCanonicalRun(out_filename, &run, &run_files);
+    }
+
+    FILE* out = NULL;
+    if (valid) {
+        errno_t result = fopen_s(&out, out_filename, "wb");
+        if ((result != 0) || (out == NULL)) {
+            fprintf(stderr, "Unable to open canonical solution file: %s\n", out_filename);
+            out = NULL;
+            valid = false;
+        }
+    }
+
+    // A binary file keeps the class and criteria from its header, and gets its count once the solutions are written.
+    SolutionFileHeader header = reader.header;
+    memcpy(header.magic, CANONICAL_FILE_MAGIC, sizeof(header.magic));
+    header.count = 0;
+    if (valid && reader.binary) {
+        valid = WriteSolutionFileHeader(out, header);
+    }
+
+    // With only the one run, it's still in memory.
+    if (valid && run_files.empty()) {
+        SortCanonicalRun(&run);
+        for (size_t i = 0; valid && (i < run.size()); ++i) {
+            valid = WriteCanonicalRecord(out, reader.binary, run[i], totals);
+        }
+    }
+    else if (valid) {
+        valid = MergeCanonicalRuns(run_files, out, reader.binary, totals);
+    }
+
+    if (valid && reader.binary) {
+        header.count = totals->canonical_solutions;
+        valid = (fseek(out, 0, SEEK_SET) == 0) && WriteSolutionFileHeader(out, header);
+    }
+    if (out != NULL) {
+        valid = (fclose(out) == 0) && valid;
+        if (!valid) {
+            fprintf(stderr, "Failed to write %s.\n", out_filename);
+        }
+    }
+
+    for (size_t i = 0; i < run_files.size(); ++i) {
+        remove(run_files[i].c_str());
+    }
+    return valid;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "ScrambleEvaluation.h"
+
+// A search without --symmetry reduce writes every solution in each set of symmetric solutions (up to 48 of them, see
+// Symmetry.h), so its solution files hold each pattern many times over. DedupeSolutionFile() puts every solution in a file
+// into canonical form, and writes each canonical solution once, with how many solutions it stands for. The canonical form
+// is the representative that a symmetry-reduced search with the default edge order finds, so deduping the files of a full
+// search gives the same solutions as that search, and deduping that search's files only adds the counts.
+//
+// A canonical solution file has the same format as the file it came from:
+//   Text   - One canonical solution per line as in a text solution file, then a space and how many solutions it stands for.
+//   Binary - See CANONICAL_RECORD_SIZE in SolutionFormat.h. --decode writes them out as canonical text files.
+// Either way, the solutions are in the order of their binary records.
+
+// The dedupe sorts this many solutions at a time in memory, about 180 MB, and merges the sorted runs from temporary files.
+constexpr auto DEDUPE_RUN_SOLUTIONS = 1 << 24;
+
+typedef struct {
+    unsigned long long solutions;             // Solutions read.
+    unsigned long long canonical_solutions;   // Different canonical solutions written.
+    unsigned long long represented_solutions; // Solutions the canonical ones stand for between them.
+} DedupeTotals;
+
+// Put a cube into canonical form. Returns how many different cubes are symmetric to it, itself included, which is 48 over
+// the number of symmetries that leave it as it is. InitCubeSymmetries() must have been called, with the default edge order.
+int CanonicalizeSolution(const unsigned char cube[CUBE_SURFACES], unsigned char canonical[CUBE_SURFACES]);
+
+// Dedupe a text or binary solution file into a canonical solution file of the same format, sorting run_solutions solutions
+// at a time. The sorted runs go in temporary files next to out_filename, which are deleted afterwards. Returns false if
+// filename isn't a solution file or a file can't be written.
+bool DedupeSolutionFile(const char* filename, const char* out_filename, int run_solutions, DedupeTotals* totals);
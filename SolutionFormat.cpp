@@ -0,0 +1,320 @@
+#include "SolutionFormat.h"
+#include <string.h>
+
+const char SOLUTION_FILE_MAGIC[4] = { 'P', 'S', 'S', 'B' };
+const char CANONICAL_FILE_MAGIC[4] = { 'P', 'S', 'S', 'C' };
+
+// The surface ids of the center pieces, which never move.
+const unsigned char centers[CUBE_FACES] = { 4, 13, 22, 31, 40, 49 };
+
+
+// Lehmer rank of a permutation of 0 .. count - 1.
+unsigned int RankPermutation(const unsigned char* permutation, int count)
+{
+    unsigned int rank = 0;
+    for (int i = 0; i < count; ++i) {
+        int smaller = 0;
+        for (int j = i + 1; j < count; ++j) {
+            if (permutation[j] < permutation[i]) {
+                ++smaller;
+            }
+        }
+        rank = rank * (count - i) + smaller;
+    }
+    return rank;
+}
+
+
+// The inverse of RankPermutation().
+void UnrankPermutation(unsigned int rank, unsigned char* permutation, int count)
+{
+    // Peel off the Lehmer digits, last one first.
+    unsigned char digits[CUBE_EDGES];
+    for (int i = count - 1; i >= 0; --i) {
+        digits[i] = rank % (count - i);
+        rank /= (count - i);
+    }
+
+    bool used[CUBE_EDGES] = { false, false, false, false, false, false, false, false, false, false, false, false };
+    for (int i = 0; i < count; ++i) {
+        int value = 0;
+        for (int skip = digits[i]; used[value] || (skip > 0); ++value) {
+            if (!used[value]) {
+                --skip;
+            }
+        }
+        used[value] = true;
+        permutation[i] = value;
+    }
+}
+
+
+// The corner or edge piece that owns each surface, and which of its surfaces it is.
+typedef struct {
+    unsigned char piece[CUBE_SURFACES];
+    unsigned char ori[CUBE_SURFACES];
+} SurfacePieces;
+
+
+SurfacePieces BuildSurfacePieces()
+{
+    SurfacePieces pieces;
+    for (int piece = 0; piece < CUBE_CORNERS; ++piece) {
+        for (int ori = 0; ori < 3; ++ori) {
+            pieces.piece[corners[piece][ori]] = (unsigned char)piece;
+            pieces.ori[corners[piece][ori]] = (unsigned char)ori;
+        }
+    }
+    for (int piece = 0; piece < CUBE_EDGES; ++piece) {
+        for (int ori = 0; ori < 2; ++ori) {
+            pieces.piece[edges[piece][ori]] = (unsigned char)piece;
+            pieces.ori[edges[piece][ori]] = (unsigned char)ori;
+        }
+    }
+    return pieces;
+}
+
+
+void PackSolution(const unsigned char cube[CUBE_SURFACES], unsigned char record[SOLUTION_RECORD_SIZE])
+{
+    static const SurfacePieces surface_pieces = BuildSurfacePieces();
+
+    unsigned char corner_pieces[CUBE_CORNERS];
+    unsigned int corner_orientation = 0;
+    for (int corner_num = CUBE_CORNERS - 1; corner_num >= 0; --corner_num) {
+        // The piece in this position is the one that owns the surface showing in the position's first surface.
+        unsigned char surface = cube[corners[corner_num][0]];
+        corner_pieces[corner_num] = surface_pieces.piece[surface];
+        corner_orientation = corner_orientation * 3 + surface_pieces.ori[surface];
+    }
+
+    unsigned char edge_pieces[CUBE_EDGES];
+    unsigned int edge_orientation = 0;
+    for (int edge_num = CUBE_EDGES - 1; edge_num >= 0; --edge_num) {
+        unsigned char surface = cube[edges[edge_num][0]];
+        edge_pieces[edge_num] = surface_pieces.piece[surface];
+        edge_orientation = (edge_orientation << 1) | surface_pieces.ori[surface];
+    }
+
+    unsigned int corner_permutation = RankPermutation(corner_pieces, CUBE_CORNERS);
+    unsigned int edge_permutation = RankPermutation(edge_pieces, CUBE_EDGES);
+
+    record[0] = corner_permutation & 0xFF;
+    record[1] = (corner_permutation >> 8) & 0xFF;
+    record[2] = corner_orientation & 0xFF;
+    record[3] = (corner_orientation >> 8) & 0xFF;
+    record[4] = edge_permutation & 0xFF;
+    record[5] = (edge_permutation >> 8) & 0xFF;
+    record[6] = (edge_permutation >> 16) & 0xFF;
+    record[7] = (edge_permutation >> 24) & 0xFF;
+    record[8] = edge_orientation & 0xFF;
+    record[9] = (edge_orientation >> 8) & 0xFF;
+}
+
+
+void UnpackSolution(const unsigned char record[SOLUTION_RECORD_SIZE], unsigned char cube[CUBE_SURFACES])
+{
+    unsigned int corner_permutation = record[0] | (record[1] << 8);
+    unsigned int corner_orientation = record[2] | (record[3] << 8);
+    unsigned int edge_permutation = record[4] | (record[5] << 8) | (record[6] << 16) | ((unsigned int)record[7] << 24);
+    unsigned int edge_orientation = record[8] | (record[9] << 8);
+
+    for (int face = 0; face < CUBE_FACES; ++face) {
+        cube[centers[face]] = centers[face];
+    }
+
+    // Place the pieces the same way PlaceCornerPiece() and PlaceEdgePiece() do.
+    unsigned char corner_pieces[CUBE_CORNERS];
+    UnrankPermutation(corner_permutation, corner_pieces, CUBE_CORNERS);
+    for (int corner_num = 0; corner_num < CUBE_CORNERS; ++corner_num) {
+        int ori = corner_orientation % 3;
+        corner_orientation /= 3;
+
+        cube[corners[corner_num][0]] = corners[corner_pieces[corner_num]][(0 + ori) % 3];
+        cube[corners[corner_num][1]] = corners[corner_pieces[corner_num]][(1 + ori) % 3];
+        cube[corners[corner_num][2]] = corners[corner_pieces[corner_num]][(2 + ori) % 3];
+    }
+
+    unsigned char edge_pieces[CUBE_EDGES];
+    UnrankPermutation(edge_permutation, edge_pieces, CUBE_EDGES);
+    for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+        int ori = (edge_orientation >> edge_num) & 1;
+
+        cube[edges[edge_num][0]] = edges[edge_pieces[edge_num]][ori];
+        cube[edges[edge_num][1]] = edges[edge_pieces[edge_num]][1 ^ ori];
+    }
+}
+
+
+void SolutionFileBaseName(int solution_class, int format, char filename[50])
+{
+    int unique_patterns = (solution_class % 6) + 1;
+    bool perfect = solution_class >= 6;
+    sprintf_s(filename, 50, "Solutions_%i_patterns%s.%s", unique_patterns, perfect ? "_Perfect" : "", (format == SOLUTION_FORMAT_BINARY) ? "bin" : "txt");
+}
+
+
+unsigned long long SolutionFileEnd(FILE* fp)
+{
+#ifdef _WIN32
+    _fseeki64(fp, 0, SEEK_END);
+    return (unsigned long long)_ftelli64(fp);
+#else
+    fseeko(fp, 0, SEEK_END);
+    return (unsigned long long)ftello(fp);
+#endif
+}
+
+
+int FormatSolution(char line[CUBE_SURFACES * 3], const unsigned char cube[CUBE_SURFACES])
+{
+    int length = 0;
+
+    for (int i = 0; i < CUBE_SURFACES; ++i) {
+        if (i > 0) {
+            line[length++] = ',';
+        }
+        if (cube[i] >= 10) {
+            line[length++] = (char)('0' + cube[i] / 10);
+        }
+        line[length++] = (char)('0' + cube[i] % 10);
+    }
+    line[length++] = '\n';
+
+    return length;
+}
+
+
+int FormatCanonicalSolution(char line[CUBE_SURFACES * 3], const unsigned char cube[CUBE_SURFACES], int represented)
+{
+    int length = FormatSolution(line, cube) - 1;
+    line[length++] = ' ';
+    if (represented >= 10) {
+        line[length++] = (char)('0' + represented / 10);
+    }
+    line[length++] = (char)('0' + represented % 10);
+    line[length++] = '\n';
+
+    return length;
+}
+
+
+void InitSolutionFileHeader(SolutionFileHeader* header, int unique_patterns, bool perfect, int criteria)
+{
+    memcpy(header->magic, SOLUTION_FILE_MAGIC, sizeof(header->magic));
+    header->version = SOLUTION_FORMAT_VERSION;
+    header->unique_patterns = unique_patterns;
+    header->perfect = perfect ? 1 : 0;
+    header->criteria = criteria;
+    header->count = 0;
+}
+
+
+// Header fields are little-endian, size bytes each.
+void PutHeaderField(unsigned char* bytes, unsigned long long value, int size)
+{
+    for (int i = 0; i < size; ++i) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+}
+
+unsigned long long GetHeaderField(const unsigned char* bytes, int size)
+{
+    unsigned long long value = 0;
+    for (int i = size - 1; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+
+bool WriteSolutionFileHeader(FILE* fp, const SolutionFileHeader& header)
+{
+    unsigned char bytes[SOLUTION_HEADER_SIZE];
+    memcpy(bytes, header.magic, sizeof(header.magic));
+    PutHeaderField(&bytes[4], header.version, 4);
+    PutHeaderField(&bytes[8], header.unique_patterns, 4);
+    PutHeaderField(&bytes[12], header.perfect, 4);
+    PutHeaderField(&bytes[16], header.criteria, 4);
+    PutHeaderField(&bytes[20], header.count, 8);
+    return fwrite(bytes, SOLUTION_HEADER_SIZE, 1, fp) == 1;
+}
+
+
+// Read a header and check it has magic.
+bool ReadFileHeader(FILE* fp, SolutionFileHeader* header, const char magic[4])
+{
+    unsigned char bytes[SOLUTION_HEADER_SIZE];
+    if (fread(bytes, SOLUTION_HEADER_SIZE, 1, fp) != 1) {
+        return false;
+    }
+
+    memcpy(header->magic, bytes, sizeof(header->magic));
+    header->version = (unsigned int)GetHeaderField(&bytes[4], 4);
+    header->unique_patterns = (unsigned int)GetHeaderField(&bytes[8], 4);
+    header->perfect = (unsigned int)GetHeaderField(&bytes[12], 4);
+    header->criteria = (unsigned int)GetHeaderField(&bytes[16], 4);
+    header->count = GetHeaderField(&bytes[20], 8);
+    return (memcmp(header->magic, magic, sizeof(header->magic)) == 0) && (header->version == SOLUTION_FORMAT_VERSION);
+}
+
+
+bool ReadSolutionFileHeader(FILE* fp, SolutionFileHeader* header)
+{
+    return ReadFileHeader(fp, header, SOLUTION_FILE_MAGIC);
+}
+
+
+bool ReadCanonicalFileHeader(FILE* fp, SolutionFileHeader* header)
+{
+    return ReadFileHeader(fp, header, CANONICAL_FILE_MAGIC);
+}
+
+
+bool DecodeSolutionFile(const char* filename, FILE* out)
+{
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, filename, "rb");
+    if ((result != 0) || (fp == NULL)) {
+        fprintf(stderr, "Unable to open solution file: %s\n", filename);
+        return false;
+    }
+
+    // Canonical files have the same header, and a byte more per record.
+    SolutionFileHeader header;
+    bool canonical = false;
+    if (!ReadSolutionFileHeader(fp, &header)) {
+        canonical = (fseek(fp, 0, SEEK_SET) == 0) && ReadCanonicalFileHeader(fp, &header);
+        if (!canonical) {
+            fprintf(stderr, "%s is not a version %i binary or canonical solution file.\n", filename, SOLUTION_FORMAT_VERSION);
+            fclose(fp);
+            return false;
+        }
+    }
+
+    const int RECORDS_PER_READ = 4096;
+    static unsigned char records[RECORDS_PER_READ * CANONICAL_RECORD_SIZE];
+    size_t record_size = canonical ? CANONICAL_RECORD_SIZE : SOLUTION_RECORD_SIZE;
+    unsigned long long decoded = 0;
+    size_t records_read;
+
+    while ((decoded < header.count) && ((records_read = fread(records, record_size, RECORDS_PER_READ, fp)) > 0)) {
+        for (size_t i = 0; (i < records_read) && (decoded < header.count); ++i, ++decoded) {
+            unsigned char cube[CUBE_SURFACES];
+            char line[CUBE_SURFACES * 3];
+            const unsigned char* record = &records[i * record_size];
+
+            UnpackSolution(record, cube);
+            fwrite(line, 1, canonical ? FormatCanonicalSolution(line, cube, record[SOLUTION_RECORD_SIZE]) : FormatSolution(line, cube), out);
+        }
+    }
+
+    fclose(fp);
+
+    if (decoded != header.count) {
+        fprintf(stderr, "%s is truncated - the header says %llu solutions, but only %llu were found.\n", filename, header.count, decoded);
+        return false;
+    }
+
+    return true;
+}
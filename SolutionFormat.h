@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdio.h>
+#include "ScrambleEvaluation.h"
+
+// Solution file formats.
+constexpr auto SOLUTION_FORMAT_TEXT = 0;   // One solution per line: 54 comma separated surface ids.
+constexpr auto SOLUTION_FORMAT_BINARY = 1; // A SolutionFileHeader followed by SOLUTION_RECORD_SIZE bytes per solution.
+constexpr auto SOLUTION_FORMAT_COUNT = 2;  // No solution files. The search only counts the solutions in each class.
+
+// Solutions are sorted into one output class per solution file:
+//   Classes 0-5  - Solutions_1_patterns.txt through Solutions_6_patterns.txt (adjacent faces touching at a corner).
+//   Classes 6-11 - Solutions_1_patterns_Perfect.txt through Solutions_6_patterns_Perfect.txt.
+// Binary solution files are named the same way, but end in .bin instead of .txt.
+constexpr auto SOLUTION_CLASSES = 12;
+
+// The output class for a solution with unique_patterns different face patterns and the given color connectedness.
+inline int SolutionClass(int unique_patterns, int connectedness)
+{
+    return unique_patterns - 1 + ((connectedness == ADJACENT_FACES_TOUCHING) ? 0 : 6);
+}
+
+// The name of the solution file for a solution class in a format, e.g. Solutions_3_patterns_Perfect.txt.
+void SolutionFileBaseName(int solution_class, int format, char filename[50]);
+
+// A binary solution record holds the piece permutations and orientations, which is all it takes to rebuild the cube.
+// Every field is little-endian.
+//   Bytes 0-1 - Rank of the corner permutation, 0 - 40319.
+//   Bytes 2-3 - Corner orientations, as 8 base 3 digits. Corner 0 is the lowest digit.
+//   Bytes 4-7 - Rank of the edge permutation, 0 - 479001599.
+//   Bytes 8-9 - Edge orientations, one bit per edge. Edge 0 is the lowest bit.
+constexpr auto SOLUTION_RECORD_SIZE = 10;
+
+constexpr auto SOLUTION_FORMAT_VERSION = 1;
+
+// A binary solution file starts with this header. On disk it is SOLUTION_HEADER_SIZE bytes: the fields in order, each
+// little-endian, with no padding.
+typedef struct {
+    char magic[4];                // "PSSB"
+    unsigned int version;         // SOLUTION_FORMAT_VERSION.
+    unsigned int unique_patterns; // The number of different face patterns in every solution in the file.
+    unsigned int perfect;         // 1 if no two surfaces of the same color touch where two faces meet, 0 if some do.
+    unsigned int criteria;        // The SEARCH_CRITERIA_* policy the solutions were found with.
+    unsigned long long count;     // The number of records that follow.
+} SolutionFileHeader;
+
+constexpr auto SOLUTION_HEADER_SIZE = 28;
+
+// A canonical solution file, written by DedupeSolutionFile(), has the same header with CANONICAL_FILE_MAGIC, and each record is
+// a binary solution record followed by one byte: how many solutions it stands for, 1 - 48. Its count is the number of records.
+constexpr auto CANONICAL_RECORD_SIZE = SOLUTION_RECORD_SIZE + 1;
+extern const char CANONICAL_FILE_MAGIC[4]; // "PSSC"
+
+// Pack a solution cube into a binary record.
+void PackSolution(const unsigned char cube[CUBE_SURFACES], unsigned char record[SOLUTION_RECORD_SIZE]);
+// Rebuild a solution cube from a binary record.
+void UnpackSolution(const unsigned char record[SOLUTION_RECORD_SIZE], unsigned char cube[CUBE_SURFACES]);
+
+// Format a solution cube as a line of a text solution file, including the newline. Returns the length of the line.
+int FormatSolution(char line[CUBE_SURFACES * 3], const unsigned char cube[CUBE_SURFACES]);
+// The same for a canonical text solution file: the line, then a space and how many solutions it stands for.
+int FormatCanonicalSolution(char line[CUBE_SURFACES * 3], const unsigned char cube[CUBE_SURFACES], int represented);
+
+// Fill out a header for a binary solution file.
+void InitSolutionFileHeader(SolutionFileHeader* header, int unique_patterns, bool perfect, int criteria);
+// Read the header at the start of a binary solution file. Returns false if it isn't a binary solution file this version understands.
+bool ReadSolutionFileHeader(FILE* fp, SolutionFileHeader* header);
+// Write a header of either kind where fp is.
+bool WriteSolutionFileHeader(FILE* fp, const SolutionFileHeader& header);
+// The same for a canonical solution file.
+bool ReadCanonicalFileHeader(FILE* fp, SolutionFileHeader* header);
+
+// Seek to the end of a solution file and return its size in bytes on disk, which may be past 2 GB. For a text file written
+// in text mode on Windows, that counts the \r each \n is written with. Returns (unsigned long long)-1 if it can't be found.
+unsigned long long SolutionFileEnd(FILE* fp);
+
+// Expand a binary or canonical solution file to the text format, one record at a time.
+bool DecodeSolutionFile(const char* filename, FILE* out);
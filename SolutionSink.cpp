@@ -0,0 +1,435 @@
+#include "SolutionSink.h"
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ScrambleSearcher.h"
+#include "SearchCriteria.h"
+#include "Symmetry.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// The writer wakes up once this much is queued, or once a second, whichever comes first.
+const size_t SOLUTION_FLUSH_BYTES = 1 << 20;
+// The search threads wait for the writer if this much is queued.
+const size_t SOLUTION_MAX_PENDING_BYTES = 64 << 20;
+
+int sink_format = SOLUTION_FORMAT_TEXT;
+char sink_file_prefix[50] = "";
+std::mutex sink_mutex;
+std::condition_variable sink_flush_needed; // Signaled when the writer has something to do.
+std::condition_variable sink_space_freed;  // Signaled when the writer has taken the queued solutions.
+std::string pending_solutions[SOLUTION_CLASSES];
+unsigned long long pending_counts[SOLUTION_CLASSES];
+size_t pending_bytes = 0;
+std::vector<std::string> pending_finished_units; // Units whose solutions are all queued.
+SearchTotals pending_totals;                     // Totals for pending_finished_units.
+bool sink_closing = false;
+std::thread sink_writer;
+
+// The writer's checkpoint. Only the writer thread touches it once the sink is open.
+bool sink_checkpointing = false;
+SearchCheckpoint sink_checkpoint;
+// Set by the writer once a solution file couldn't be opened or written. Nothing more goes into the files or the checkpoint
+// after that, so the last checkpoint written still matches the files.
+bool sink_failed = false;
+
+// An open solution file.
+typedef struct {
+    FILE* fp;
+    SolutionFileHeader header; // Binary files only. The header as it is on disk.
+} SolutionFile;
+
+
+// Seek to an offset that may be past 2 GB.
+int SeekSolutionFile(FILE* fp, unsigned long long offset)
+{
+#ifdef _WIN32
+    return _fseeki64(fp, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(fp, (off_t)offset, SEEK_SET);
+#endif
+}
+
+
+// Cut an open file down to size bytes.
+bool TruncateSolutionFile(FILE* fp, unsigned long long size)
+{
+    fflush(fp);
+#ifdef _WIN32
+    return _chsize_s(_fileno(fp), (__int64)size) == 0;
+#else
+    return ftruncate(fileno(fp), (off_t)size) == 0;
+#endif
+}
+
+
+void SetSolutionFilePrefix(const char* prefix)
+{
+    sprintf_s(sink_file_prefix, sizeof(sink_file_prefix), "%s", prefix);
+}
+
+
+void SolutionFileName(int solution_class, char filename[100])
+{
+    char base_name[50];
+    SolutionFileBaseName(solution_class, sink_format, base_name);
+    sprintf_s(filename, 100, "%s%s", sink_file_prefix, base_name);
+}
+
+
+void SinkCheckpointFileName(char filename[100])
+{
+    sprintf_s(filename, 100, "%s%s", sink_file_prefix, CHECKPOINT_FILE);
+}
+
+
+// The size of a solution file as a checkpoint records it: bytes for text files, solutions for binary files.
+// A file that doesn't exist has size 0.
+bool GetSolutionFileSize(int solution_class, unsigned long long* size)
+{
+    char filename[100];
+    SolutionFileName(solution_class, filename);
+
+    *size = 0;
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, filename, "rb");
+    if ((result != 0) || (fp == NULL)) {
+        return true;
+    }
+
+    bool valid = true;
+    if (sink_format == SOLUTION_FORMAT_TEXT) {
+        *size = SolutionFileEnd(fp);
+    }
+    else {
+        SolutionFileHeader header;
+        valid = ReadSolutionFileHeader(fp, &header);
+        *size = valid ? header.count : 0;
+        if (!valid) {
+            fprintf(stderr, "%s is not a version %i binary solution file.\n", filename, SOLUTION_FORMAT_VERSION);
+        }
+    }
+
+    fclose(fp);
+    return valid;
+}
+
+
+// Cut a solution file back to the size a checkpoint recorded for it.
+bool CutSolutionFile(int solution_class, unsigned long long size)
+{
+    char filename[100];
+    SolutionFileName(solution_class, filename);
+
+    unsigned long long current_size;
+    if (!GetSolutionFileSize(solution_class, &current_size)) {
+        return false;
+    }
+    if (current_size < size) {
+        fprintf(stderr, "%s is smaller than the checkpoint says it should be (%llu, not %llu).\n", filename, current_size, size);
+        return false;
+    }
+    if ((size == 0) && (current_size == 0)) {
+        return true;
+    }
+
+    FILE* fp = NULL;
+    errno_t result = fopen_s(&fp, filename, "r+b");
+    if ((result != 0) || (fp == NULL)) {
+        fprintf(stderr, "Unable to open solution file: %s\n", filename);
+        return false;
+    }
+
+    bool cut;
+    if (sink_format == SOLUTION_FORMAT_TEXT) {
+        cut = TruncateSolutionFile(fp, size);
+    }
+    else {
+        SolutionFileHeader header;
+        cut = ReadSolutionFileHeader(fp, &header);
+        header.count = size;
+        cut = cut && (SeekSolutionFile(fp, 0) == 0) && WriteSolutionFileHeader(fp, header) &&
+              TruncateSolutionFile(fp, SOLUTION_HEADER_SIZE + size * SOLUTION_RECORD_SIZE);
+    }
+
+    fclose(fp);
+    if (!cut) {
+        fprintf(stderr, "Unable to cut %s back to the checkpoint.\n", filename);
+    }
+    return cut;
+}
+
+
+// Open the solution file for a solution class, creating it if needed.
+bool OpenSolutionFile(int solution_class, SolutionFile* file)
+{
+    int unique_patterns = (solution_class % 6) + 1;
+    bool perfect = solution_class >= 6;
+
+    char filename[100];
+    SolutionFileName(solution_class, filename);
+
+    if (sink_format == SOLUTION_FORMAT_TEXT) {
+        errno_t result = fopen_s(&file->fp, filename, "a");
+        if ((result != 0) || (file->fp == NULL)) {
+            fprintf(stderr, "Unable to open solution file: %s\n", filename);
+            file->fp = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    // Add to an existing binary file if there is one, as long as its solutions were found with the same criteria.
+    errno_t result = fopen_s(&file->fp, filename, "r+b");
+    if ((result == 0) && (file->fp != NULL)) {
+        if (!ReadSolutionFileHeader(file->fp, &file->header) ||
+            (file->header.unique_patterns != (unsigned int)unique_patterns) || (file->header.perfect != (perfect ? 1u : 0u))) {
+            fprintf(stderr, "%s exists, but is not a version %i solution file for this class of solutions.\n", filename, SOLUTION_FORMAT_VERSION);
+            fclose(file->fp);
+            file->fp = NULL;
+            return false;
+        }
+        if (file->header.criteria != (unsigned int)search_criteria) {
+            fprintf(stderr, "%s holds solutions found with other criteria than %s.\n", filename, search_criteria_names[search_criteria]);
+            fclose(file->fp);
+            file->fp = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    result = fopen_s(&file->fp, filename, "w+b");
+    if ((result != 0) || (file->fp == NULL)) {
+        fprintf(stderr, "Unable to open solution file: %s\n", filename);
+        file->fp = NULL;
+        return false;
+    }
+
+    InitSolutionFileHeader(&file->header, unique_patterns, perfect, search_criteria);
+    if (!WriteSolutionFileHeader(file->fp, file->header)) {
+        fprintf(stderr, "Unable to write solution file: %s\n", filename);
+        fclose(file->fp);
+        file->fp = NULL;
+        return false;
+    }
+    return true;
+}
+
+
+// Add solutions to an open solution file, and set size to its size as a checkpoint records it. Returns false if they couldn't
+// all be written.
+bool AppendToSolutionFile(SolutionFile* file, const std::string& solutions, unsigned long long count, unsigned long long* size)
+{
+    if (sink_format == SOLUTION_FORMAT_TEXT) {
+        // The file is opened in text mode, so on Windows it grows by more than solutions.size(). Only its end says by how much.
+        if ((fwrite(solutions.data(), 1, solutions.size(), file->fp) != solutions.size()) || (fflush(file->fp) != 0)) {
+            return false;
+        }
+        *size = SolutionFileEnd(file->fp);
+        return *size != (unsigned long long)-1;
+    }
+
+    // Records go right after the last one the header counts, so anything left over from an interrupted write is overwritten.
+    // The header is only updated once the records are on disk.
+    if ((SeekSolutionFile(file->fp, SOLUTION_HEADER_SIZE + file->header.count * SOLUTION_RECORD_SIZE) != 0) ||
+        (fwrite(solutions.data(), 1, solutions.size(), file->fp) != solutions.size()) || (fflush(file->fp) != 0)) {
+        return false;
+    }
+
+    file->header.count += count;
+    *size = file->header.count;
+    return (SeekSolutionFile(file->fp, 0) == 0) && WriteSolutionFileHeader(file->fp, file->header) && (fflush(file->fp) == 0);
+}
+
+
+// The writer thread. Takes whatever is queued and appends it to the solution files.
+void SolutionWriter()
+{
+    SolutionFile files[SOLUTION_CLASSES];
+    std::string writing[SOLUTION_CLASSES];
+    unsigned long long writing_counts[SOLUTION_CLASSES];
+    std::vector<std::string> writing_finished_units;
+    SearchTotals writing_totals;
+    bool closing = false;
+    auto last_checkpoint = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        files[i].fp = NULL;
+    }
+
+    while (!closing) {
+        {
+            std::unique_lock<std::mutex> lock(sink_mutex);
+            sink_flush_needed.wait_for(lock, std::chrono::seconds(1), []() { return sink_closing || (pending_bytes >= SOLUTION_FLUSH_BYTES); });
+
+            for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+                writing[i].swap(pending_solutions[i]);
+                writing_counts[i] = pending_counts[i];
+                pending_counts[i] = 0;
+            }
+            pending_bytes = 0;
+            writing_finished_units.swap(pending_finished_units);
+            writing_totals = pending_totals;
+            InitSearchTotals(&pending_totals);
+            closing = sink_closing;
+        }
+        sink_space_freed.notify_all();
+
+        for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+            if (writing[i].empty() || sink_failed) {
+                writing[i].clear();
+                continue;
+            }
+
+            // Files are only created once there is a solution to put in them.
+            if (((files[i].fp == NULL) && !OpenSolutionFile(i, &files[i])) ||
+                !AppendToSolutionFile(&files[i], writing[i], writing_counts[i], &sink_checkpoint.file_sizes[i])) {
+                char filename[100];
+                SolutionFileName(i, filename);
+                fprintf(stderr, "Unable to write solutions to %s. Nothing more will be written or checkpointed, and the search will fail.\n", filename);
+                sink_failed = true;
+            }
+            writing[i].clear();
+        }
+
+        // After a failure the queue is still emptied, so the search threads don't wait on it, but nothing is recorded.
+        if (!sink_checkpointing || sink_failed) {
+            writing_finished_units.clear();
+            continue;
+        }
+
+        // Everything the finished units found is in the files now.
+        sink_checkpoint.finished.insert(writing_finished_units.begin(), writing_finished_units.end());
+        AddSearchTotals(&sink_checkpoint.totals, writing_totals);
+        writing_finished_units.clear();
+
+        if (closing || (std::chrono::steady_clock::now() - last_checkpoint >= std::chrono::seconds(CHECKPOINT_INTERVAL_SECONDS))) {
+            // The solution files have to be on disk before a checkpoint that counts them is.
+            bool synced = true;
+            for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+                if (files[i].fp != NULL) {
+                    synced = SyncFile(files[i].fp) && synced;
+                }
+            }
+            if (synced) {
+                char filename[100];
+                SinkCheckpointFileName(filename);
+                WriteCheckpoint(filename, sink_checkpoint);
+            }
+            else {
+                fprintf(stderr, "Unable to flush the solution files to disk. Skipping this checkpoint.\n");
+            }
+            last_checkpoint = std::chrono::steady_clock::now();
+        }
+    }
+
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        if (files[i].fp != NULL) {
+            fclose(files[i].fp);
+            files[i].fp = NULL;
+        }
+    }
+}
+
+
+bool OpenSolutionSink(int format, const SearchCheckpoint* checkpoint, bool resume)
+{
+    sink_format = format;
+    sink_closing = false;
+    sink_failed = false;
+    pending_bytes = 0;
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        pending_counts[i] = 0;
+    }
+    pending_finished_units.clear();
+    InitSearchTotals(&pending_totals);
+
+    sink_checkpointing = checkpoint != NULL;
+    InitSearchCheckpoint(&sink_checkpoint, format, SYMMETRY_NONE);
+    if (sink_checkpointing) {
+        sink_checkpoint = *checkpoint;
+        sink_checkpoint.solution_format = format;
+        // A count-only search has no solution files to keep track of.
+        for (int i = 0; (i < SOLUTION_CLASSES) && (format != SOLUTION_FORMAT_COUNT); ++i) {
+            if (resume ? !CutSolutionFile(i, checkpoint->file_sizes[i]) : !GetSolutionFileSize(i, &sink_checkpoint.file_sizes[i])) {
+                return false;
+            }
+        }
+    }
+
+    sink_writer = std::thread(SolutionWriter);
+    return true;
+}
+
+
+int FormatSinkSolution(char record[CUBE_SURFACES * 3], const unsigned char cube[CUBE_SURFACES])
+{
+    if (sink_format == SOLUTION_FORMAT_BINARY) {
+        PackSolution(cube, (unsigned char*)record);
+        return SOLUTION_RECORD_SIZE;
+    }
+
+    return FormatSolution(record, cube);
+}
+
+
+void WriteSolution(int solution_class, const unsigned char cube[CUBE_SURFACES])
+{
+    char line[CUBE_SURFACES * 3];
+    int length = FormatSinkSolution(line, cube);
+
+    std::unique_lock<std::mutex> lock(sink_mutex);
+    sink_space_freed.wait(lock, []() { return pending_bytes < SOLUTION_MAX_PENDING_BYTES; });
+
+    pending_solutions[solution_class].append(line, length);
+    ++pending_counts[solution_class];
+    pending_bytes += length;
+
+    if (pending_bytes >= SOLUTION_FLUSH_BYTES) {
+        sink_flush_needed.notify_one();
+    }
+}
+
+
+void WriteFinishedUnit(const char* prefix, const std::string solutions[SOLUTION_CLASSES], const SearchTotals& totals)
+{
+    size_t length = 0;
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        length += solutions[i].size();
+    }
+
+    std::unique_lock<std::mutex> lock(sink_mutex);
+    sink_space_freed.wait(lock, []() { return pending_bytes < SOLUTION_MAX_PENDING_BYTES; });
+
+    for (int i = 0; i < SOLUTION_CLASSES; ++i) {
+        pending_solutions[i].append(solutions[i]);
+        pending_counts[i] += totals.solution_counts[i];
+    }
+    pending_finished_units.push_back(prefix);
+    AddSearchTotals(&pending_totals, totals);
+    pending_bytes += length;
+
+    if (pending_bytes >= SOLUTION_FLUSH_BYTES) {
+        sink_flush_needed.notify_one();
+    }
+}
+
+
+bool CloseSolutionSink()
+{
+    {
+        std::lock_guard<std::mutex> lock(sink_mutex);
+        sink_closing = true;
+    }
+    sink_flush_needed.notify_one();
+    sink_writer.join();
+    return !sink_failed;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Checkpoint.h"
+#include "ScrambleEvaluation.h"
+#include "SolutionFormat.h"
+
+// The solution sink keeps every solution file open for the whole search and collects solutions in memory.
+// A background thread appends them to the files, so the search threads never wait on file I/O unless the
+// writer falls far behind. Text files end up with exactly the lines that writing each solution directly would give.
+// format is SOLUTION_FORMAT_TEXT or SOLUTION_FORMAT_BINARY. With SOLUTION_FORMAT_COUNT, only finished units and their totals
+// are queued, so the sink just keeps the checkpoint.
+//
+// If checkpoint isn't NULL, the writer keeps a copy of it up to date as finished units are written, and saves it to
+// SinkCheckpointFileName() every CHECKPOINT_INTERVAL_SECONDS and when the sink is closed. Text file sizes are taken from
+// the files after each write, so they are the sizes on disk even where text mode writes \n as \r\n. When resuming, the solution files are
+// first cut back to the sizes in the checkpoint, which drops anything written after it was saved. Otherwise the sizes
+// the files already have are recorded. Returns false if the solution files don't match the checkpoint.
+bool OpenSolutionSink(int format, const SearchCheckpoint* checkpoint, bool resume);
+// Put this in front of the solution file names and the checkpoint's, e.g. so a benchmark doesn't touch the real solution
+// files. Call it before OpenSolutionSink(). Defaults to "".
+void SetSolutionFilePrefix(const char* prefix);
+// The name of a solution file, for the format the sink was last opened with.
+void SolutionFileName(int solution_class, char filename[100]);
+// The name of the checkpoint file the sink saves to: CHECKPOINT_FILE with the prefix in front.
+void SinkCheckpointFileName(char filename[100]);
+// Queue a solution for its solution file. Safe to call from any number of threads.
+void WriteSolution(int solution_class, const unsigned char cube[CUBE_SURFACES]);
+// Format a solution the way WriteSolution() would write it. Returns its length.
+int FormatSinkSolution(char record[CUBE_SURFACES * 3], const unsigned char cube[CUBE_SURFACES]);
+// Queue everything a finished unit found: its solutions for each solution file, formatted by FormatSinkSolution(), and
+// its totals. The unit goes into the checkpoint once they are all written. Safe to call from any number of threads.
+void WriteFinishedUnit(const char* prefix, const std::string solutions[SOLUTION_CLASSES], const SearchTotals& totals);
+// Write everything that is still queued, close the files and stop the writer thread. Returns false if a solution file
+// couldn't be opened or written at any point. The checkpoint stops at the last one saved before that, so --resume redoes
+// everything after it.
+bool CloseSolutionSink();
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ScrambleSearcher.h"
+
+// The edge search as a stream of solutions that the caller pulls one at a time with Next(), instead of the search pushing
+// them into the solution files. The stream keeps the search's place on a stack of its own instead of in recursive calls, so
+// it can stop after any solution, carry on whenever Next() is called again, and hand over its place as a plain
+// SolutionStreamPosition for another stream to pick up from, in this process or another one.
+//
+// Every stream has all of its search state to itself, so any number of them can run in one process, on one thread or on
+// several. They only share the tables that stay as they are once they're built: the corner tables, the perfect faces and
+// edge face tables for the search criteria (see SetSearchCriteria()), the edge order and the symmetries, which have to be
+// set up with InitCubeSymmetries() before a stream starts. Streams join the corners with the walk join, so the edge order
+// has to complete the faces in order, and they don't write checkpoints or solution files or add to the search's totals.
+
+// A solution from a stream.
+typedef struct {
+    unsigned char cube[CUBE_SURFACES];
+    int solution_class; // The solution file the search would write it to. See SOLUTION_CLASSES.
+    int orbit_size;     // How many solutions are symmetric to it, itself included. 1 without --symmetry.
+} StreamSolution;
+
+// Where a stream has got to: the piece and orientation tried at each step on its stack, and how far the last step's corner
+// join has got. Plain data, so it can be written out and read back as it is.
+typedef struct {
+    unsigned char start_edge;            // The edges the stream's task started with.
+    unsigned char edge_num;              // The step at the top of the stack. CUBE_EDGES - 1 while joining the corners.
+    unsigned char positions[CUBE_EDGES]; // positions[k] is the place in the pieces left that step k took its piece from,
+    unsigned char oris[CUBE_EDGES];      // and oris[k] the next orientation step k tries.
+    unsigned char finished;              // 1 once the stream has run out of solutions.
+    unsigned char orbit_next;            // The next of the symmetric cubes to give, when expanding.
+    int corner_index;                    // The corner arrangement the last step's join carries on from.
+    int solution_index;                  // The corner arrangement of the solution whose symmetric cubes are being given, or -1.
+    unsigned long long solutions;        // Solutions given so far.
+} SolutionStreamPosition;
+
+class SolutionStream
+{
+public:
+    // Stream the solutions below a task, e.g. the one InitEdgeTask() sets up for the whole search, with the criteria set by
+    // SetSearchCriteria(). symmetry_mode is SYMMETRY_NONE, SYMMETRY_REDUCE or SYMMETRY_EXPAND, as for the search: a reducing
+    // stream gives each representative once, and an expanding one gives every solution symmetric to it as well.
+    SolutionStream(const EdgeTask& task, int symmetry_mode);
+
+    // Get the next solution. Returns false once there are no more.
+    bool Next(StreamSolution* solution);
+
+    // Solutions Next() has given so far.
+    unsigned long long Count() const { return solutions; }
+
+    void GetPosition(SolutionStreamPosition* position) const;
+    // Carry on from a position a stream over the same task and criteria got to. Returns false, and finishes the stream, if
+    // the position isn't one this stream can get to.
+    bool SetPosition(const SolutionStreamPosition& position);
+
+private:
+    // One step on the stack: the choices PlaceEdgePiece() keeps in its loop variables and arguments.
+    typedef struct {
+        unsigned char pos; // The place in pieces[] the piece being tried comes from. CUBE_EDGES once every piece is tried.
+        unsigned char ori; // The next orientation to try.
+        unsigned char swap_parity;
+        unsigned char flip_parity;
+        int ep_corner_arrangements_index;
+        int op_corner_arrangements_index;
+    } Step;
+
+    EdgeTask task;
+    EdgeSearchState state;
+    bool loaded;                      // The task's edges are in state.
+    Step steps[CUBE_EDGES];
+    int edge_num;                     // The step at the top of the stack.
+    bool finished;
+    bool joining;                     // The last step is in place and its corner join is under way, from corner_index.
+    int corner_index;
+    int solution_index;               // The corner arrangement of the last solution given, while its symmetric cubes are.
+    int solution_class;
+    int orbit_size;
+    int orbit_next;
+    unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES];
+    unsigned long long solutions;
+
+    // NextFor() and SetPositionFor() for the search criteria.
+    bool (SolutionStream::*next)(StreamSolution* solution);
+    bool (SolutionStream::*set_position)(const SolutionStreamPosition& position);
+
+    void StartStep(int step_num, unsigned char swap_parity, unsigned char flip_parity, int ep_corner_arrangements_index, int op_corner_arrangements_index);
+    void PopStep();
+    template <typename Criteria> bool NextFor(StreamSolution* solution);
+    template <typename Criteria> bool SetPositionFor(const SolutionStreamPosition& position);
+    template <typename Criteria> bool PlaceStep(int ori);
+    template <typename Criteria> bool AdvanceStep();
+    template <typename Criteria> bool JoinNext(StreamSolution* solution);
+    template <typename Criteria> bool EvaluateJoined(int index, StreamSolution* solution);
+    void GiveOrbitCube(StreamSolution* solution, int count);
+};
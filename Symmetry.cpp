@@ -0,0 +1,160 @@
+#include "Symmetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "PlacementOrder.h"
+
+unsigned char symmetry_surfaces[CUBE_SYMMETRIES][CUBE_SURFACES];
+unsigned char symmetry_sources[CUBE_SYMMETRIES][CUBE_SURFACES];
+unsigned char symmetry_edge_sources[CUBE_SYMMETRIES][CUBE_EDGES];
+unsigned char symmetry_edge_source_surfaces[CUBE_SYMMETRIES][CUBE_EDGES];
+
+
+// Where a surface sits, in half-surface steps from the middle of the cube: x to the right, y to the back, z up.
+// Follows the layout diagram in ScrambleSearcher.cpp, folded up around the Up face.
+void GetSurfacePosition(int surface, int position[3])
+{
+    int row = (surface % 9) / 3;
+    int column = surface % 3;
+
+    switch (surface / 9) {
+    case 0: // Back
+        position[0] = 2 * (column - 1); position[1] = 3;                position[2] = 2 * (row - 1);
+        break;
+    case 1: // Left
+        position[0] = -3;               position[1] = 2 * (1 - row);    position[2] = 2 * (column - 1);
+        break;
+    case 2: // Up
+        position[0] = 2 * (column - 1); position[1] = 2 * (1 - row);    position[2] = 3;
+        break;
+    case 3: // Right
+        position[0] = 3;                position[1] = 2 * (1 - row);    position[2] = 2 * (1 - column);
+        break;
+    case 4: // Front
+        position[0] = 2 * (column - 1); position[1] = -3;               position[2] = 2 * (1 - row);
+        break;
+    default: // Down
+        position[0] = 2 * (column - 1); position[1] = 2 * (row - 1);    position[2] = -3;
+        break;
+    }
+}
+
+
+// The edge position that has a surface, and which of its two surfaces it is.
+int FindEdgePosition(int surface)
+{
+    for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+        if ((edges[edge_num][0] == surface) || (edges[edge_num][1] == surface)) {
+            return edge_num;
+        }
+    }
+    return -1;
+}
+
+
+void InitCubeSymmetries()
+{
+    int positions[CUBE_SURFACES][3];
+    for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+        GetSurfacePosition(surface, positions[surface]);
+    }
+
+    // Every symmetry swaps the axes around and then flips some of them. The first one found is the identity.
+    int axes[3] = { 0, 1, 2 };
+    int symmetry = 0;
+    do {
+        for (int flips = 0; flips < 8; ++flips, ++symmetry) {
+            for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+                int moved[3];
+                for (int i = 0; i < 3; ++i) {
+                    moved[i] = ((flips >> i) & 1) ? -positions[surface][axes[i]] : positions[surface][axes[i]];
+                }
+
+                int target = 0;
+                while ((target < CUBE_SURFACES) && ((positions[target][0] != moved[0]) || (positions[target][1] != moved[1]) || (positions[target][2] != moved[2]))) {
+                    ++target;
+                }
+                if (target == CUBE_SURFACES) {
+                    fprintf(stderr, "Cube symmetry %i moves surface %i off the cube.\n", symmetry, surface);
+                    exit(1);
+                }
+                symmetry_surfaces[symmetry][surface] = (unsigned char)target;
+            }
+        }
+    } while (std::next_permutation(axes, axes + 3));
+
+    for (symmetry = 0; symmetry < CUBE_SYMMETRIES; ++symmetry) {
+        unsigned char* inverse = symmetry_sources[symmetry];
+        for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+            inverse[symmetry_surfaces[symmetry][surface]] = (unsigned char)surface;
+        }
+
+        // By step in the edge order, not by position.
+        for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+            unsigned char source = inverse[edge_positions[edge_num][0]];
+            int position = FindEdgePosition(source);
+            int step = 0;
+            while (edge_order[step] != position) {
+                ++step;
+            }
+            symmetry_edge_sources[symmetry][edge_num] = (unsigned char)step;
+            symmetry_edge_source_surfaces[symmetry][edge_num] = source;
+        }
+    }
+}
+
+
+void ApplySymmetry(int symmetry, const unsigned char cube[CUBE_SURFACES], unsigned char result[CUBE_SURFACES])
+{
+    const unsigned char* moves = symmetry_surfaces[symmetry];
+    for (int surface = 0; surface < CUBE_SURFACES; ++surface) {
+        result[moves[surface]] = moves[cube[surface]];
+    }
+}
+
+
+int CompareSymmetryKeys(const unsigned char a[CUBE_SURFACES], const unsigned char b[CUBE_SURFACES])
+{
+    // One surface is enough to tell which piece is in a position, and which way round it is.
+    for (int edge_num = 0; edge_num < CUBE_EDGES; ++edge_num) {
+        int difference = a[edge_positions[edge_num][0]] - b[edge_positions[edge_num][0]];
+        if (difference != 0) {
+            return difference;
+        }
+    }
+    for (int corner_num = 0; corner_num < CUBE_CORNERS; ++corner_num) {
+        int difference = a[corners[corner_num][0]] - b[corners[corner_num][0]];
+        if (difference != 0) {
+            return difference;
+        }
+    }
+
+    return 0;
+}
+
+
+int GetSymmetricCubes(const unsigned char cube[CUBE_SURFACES], unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES])
+{
+    memcpy(orbit[0], cube, CUBE_SURFACES);
+    int count = 1;
+
+    for (int symmetry = 1; symmetry < CUBE_SYMMETRIES; ++symmetry) {
+        ApplySymmetry(symmetry, cube, orbit[count]);
+
+        int order = CompareSymmetryKeys(orbit[count], cube);
+        if (order < 0) {
+            return 0;
+        }
+
+        bool seen = order == 0;
+        for (int i = 1; (i < count) && !seen; ++i) {
+            seen = CompareSymmetryKeys(orbit[count], orbit[i]) == 0;
+        }
+        if (!seen) {
+            ++count;
+        }
+    }
+
+    return count;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ScrambleEvaluation.h"
+
+// A cube has 48 symmetries: the 24 ways to turn it, each with or without a mirror. Applying a symmetry to a whole scramble
+// moves every surface and renames it the same way, so the centers stay where they are. That gives another scramble with the
+// same face patterns (turned, mirrored and recolored) and the same color connectedness, so both are solutions of the same
+// class or neither is. A symmetry-reduced search only looks for one representative of each set of symmetric solutions.
+constexpr auto CUBE_SYMMETRIES = 48;
+
+// Symmetry search modes.
+constexpr auto SYMMETRY_NONE = 0;   // Search for every solution.
+constexpr auto SYMMETRY_REDUCE = 1; // Search for representatives, and only write the representatives.
+constexpr auto SYMMETRY_EXPAND = 2; // Search for representatives, and write every solution symmetric to each one.
+
+// Where each symmetry moves each surface to. Symmetry 0 does nothing.
+extern unsigned char symmetry_surfaces[CUBE_SYMMETRIES][CUBE_SURFACES];
+// The other way round: the surface each symmetry moves to each surface.
+extern unsigned char symmetry_sources[CUBE_SYMMETRIES][CUBE_SURFACES];
+
+// For the edge search: symmetry s moves the edge piece in the position filled at step symmetry_edge_sources[s][k] into the
+// position filled at step k, and the surface that ends up showing in edge_positions[k][0] is the one showing in
+// symmetry_edge_source_surfaces[s][k] before.
+extern unsigned char symmetry_edge_sources[CUBE_SYMMETRIES][CUBE_EDGES];
+extern unsigned char symmetry_edge_source_surfaces[CUBE_SYMMETRIES][CUBE_EDGES];
+
+// Work out the symmetries. The edge order must already be set, and not change afterwards.
+void InitCubeSymmetries();
+
+// Apply a symmetry to a whole cube.
+void ApplySymmetry(int symmetry, const unsigned char cube[CUBE_SURFACES], unsigned char result[CUBE_SURFACES]);
+
+// The representative of a set of symmetric cubes is the one that comes first comparing the surface showing in each edge
+// position's first surface, in edge_order, then the same for the corner positions, corner 0 first. That is the order the edge
+// search places pieces in, so it can rule out a partial edge arrangement as soon as some symmetry makes it come later.
+int CompareSymmetryKeys(const unsigned char a[CUBE_SURFACES], const unsigned char b[CUBE_SURFACES]);
+
+// Fill orbit[] with every different cube the symmetries turn this one into, starting with the cube itself, and return how
+// many there are. Returns 0 without filling all of orbit[] if the cube isn't the representative.
+int GetSymmetricCubes(const unsigned char cube[CUBE_SURFACES], unsigned char orbit[CUBE_SYMMETRIES][CUBE_SURFACES]);
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small work-stealing task pool.
+//
+// Every worker owns a deque of tasks. A worker pushes and pops at the back of its own deque, so it keeps
+// working depth-first on the subtree it split off most recently. An idle worker steals from the front of
+// another worker's deque, which is where the oldest (and usually biggest) subtrees are.
+//
+// The tasks this is used for are whole search subtrees, so a mutex per deque is cheap enough. A worker that finds
+// nothing to steal sleeps until a task is pushed or everything is done, so it doesn't burn a core, or keep taking the
+// other workers' mutexes, while the last subtrees finish.
+template <typename Task>
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int worker_count) : queues(worker_count), hungry_workers(0), pending_tasks(0), pushed_tasks(0), sleeping_workers(0) {}
+
+    int WorkerCount() const { return (int)queues.size(); }
+
+    // True when at least one worker is looking for something to do, or sleeping until there is. Tasks use this to
+    // decide whether to split off part of their subtree instead of walking it themselves.
+    bool WantsWork() const { return hungry_workers.load(std::memory_order_relaxed) > 0; }
+
+    // Add a task to a worker's deque. May be called from inside a running task.
+    void Push(int worker, const Task& task)
+    {
+        pending_tasks.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(queues[worker].mutex);
+            queues[worker].tasks.push_back(task);
+        }
+        pushed_tasks.fetch_add(1);
+        if (sleeping_workers.load() > 0) {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            work_pushed.notify_one();
+        }
+    }
+
+    // Run every task, including the ones pushed by running tasks, on WorkerCount() threads.
+    // run_task(worker, task) is called for each task. The calling thread is worker 0.
+    template <typename RunTask>
+    void Run(RunTask& run_task)
+    {
+        std::vector<std::thread> threads;
+        for (int worker = 1; worker < WorkerCount(); ++worker) {
+            threads.emplace_back([this, worker, &run_task]() { WorkerLoop(worker, run_task); });
+        }
+        WorkerLoop(0, run_task);
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+    }
+
+private:
+    typedef struct {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    } TaskQueue;
+
+    std::vector<TaskQueue> queues;
+    std::atomic<int> hungry_workers; // Workers that have run out of tasks.
+    std::atomic<int> pending_tasks;  // Tasks that have been pushed but have not finished running.
+
+    // Hungry workers sleep on work_pushed. pushed_tasks tells a worker whether anything was pushed between its last
+    // look through the deques and going to sleep, so it can't miss a task.
+    std::atomic<unsigned int> pushed_tasks;
+    std::atomic<int> sleeping_workers;
+    std::mutex sleep_mutex;
+    std::condition_variable work_pushed;
+
+    // Take the newest task from a worker's own deque.
+    bool Pop(int worker, Task* task)
+    {
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        if (queues[worker].tasks.empty()) {
+            return false;
+        }
+        *task = queues[worker].tasks.back();
+        queues[worker].tasks.pop_back();
+        return true;
+    }
+
+    // Take the oldest task from some other worker's deque.
+    bool Steal(int thief, Task* task)
+    {
+        for (int i = 1; i < WorkerCount(); ++i) {
+            TaskQueue& victim = queues[(thief + i) % WorkerCount()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                *task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <typename RunTask>
+    void WorkerLoop(int worker, RunTask& run_task)
+    {
+        Task task;
+        bool hungry = false;
+
+        while (true) {
+            unsigned int pushed = pushed_tasks.load();
+            if (Pop(worker, &task) || Steal(worker, &task)) {
+                if (hungry) {
+                    hungry_workers.fetch_sub(1);
+                    hungry = false;
+                }
+                run_task(worker, task);
+                // Any tasks this one pushed were counted before this, so pending_tasks only reaches 0 when everything is done.
+                if (pending_tasks.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(sleep_mutex);
+                    work_pushed.notify_all();
+                }
+                continue;
+            }
+
+            if (pending_tasks.load() == 0) {
+                break;
+            }
+
+            if (!hungry) {
+                hungry_workers.fetch_add(1);
+                hungry = true;
+            }
+
+            // Sleep until a task is pushed, unless one already has been since looking.
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleeping_workers.fetch_add(1);
+            work_pushed.wait(lock, [this, pushed]() { return (pushed_tasks.load() != pushed) || (pending_tasks.load() == 0); });
+            sleeping_workers.fetch_sub(1);
+        }
+
+        if (hungry) {
+            hungry_workers.fetch_sub(1);
+        }
+    }
+};